@@ -0,0 +1,107 @@
+/*!
+ * @file    construction.cpp
+ * @brief   DSLによるタスク木の構築コストを測る
+ * @detail  約5000ノードの木を1つの式で組み立て、
+ *          1ノード当たりのヒープ確保回数と関数オブジェクトのコピー回数を表示する。
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include "task_includes.hpp"
+
+// operator newを置き換えて確保回数を数える
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+namespace
+{
+std::size_t g_allocations{0};
+std::size_t g_copies{0};
+
+struct Leaf {
+    Leaf() noexcept {}
+    Leaf(const Leaf&) noexcept { ++g_copies; }
+    Leaf(Leaf&&) noexcept {}
+    void operator()() const noexcept {}
+};
+
+bool cond() { return true; }
+
+std::size_t g_nodes{0};
+
+auto leaf()
+{
+    ++g_nodes;
+    return Leaf{};
+}
+
+auto block()
+{
+    using namespace TaskManager;
+    g_nodes += 5;
+    return TaskSet(
+        If[cond](
+            leaf(), leaf())
+            ->ElseIf[cond](
+                leaf(), leaf())
+            ->Else(
+                leaf()),
+        While[cond](
+            leaf(), leaf()),
+        Do(
+            leaf())
+            ->Until[cond],
+        During(
+            leaf(), leaf())
+            ->JumpIf[1][cond](
+                leaf())
+            ->JumpBackIf[cond](
+                leaf()));
+}
+}  // namespace
+
+void* operator new(std::size_t _size)
+{
+    ++g_allocations;
+    if (auto ptr = std::malloc(_size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+void operator delete(void* _ptr) noexcept { std::free(_ptr); }
+void operator delete(void* _ptr, std::size_t) noexcept { std::free(_ptr); }
+
+int main()
+{
+    using namespace TaskManager;
+
+    constexpr int repeat = 20;
+    std::size_t nodes = 0, allocations = 0, copies = 0;
+    std::chrono::nanoseconds elapsed{0};
+
+    for (int i = 0; i < repeat; ++i) {
+        g_nodes = g_allocations = g_copies = 0;
+        auto begin = std::chrono::steady_clock::now();
+
+        // 約5000ノード
+        auto tree = TaskSet();
+        while (g_nodes < 5000) {
+            tree = TaskSet(std::move(tree), block());
+            ++g_nodes;
+        }
+
+        elapsed += std::chrono::steady_clock::now() - begin;
+        nodes += g_nodes;
+        allocations += g_allocations;
+        copies += g_copies;
+    }
+
+    std::printf("nodes/tree        : %zu\n", nodes / repeat);
+    std::printf("time/tree     [us]: %.1f\n", static_cast<double>(elapsed.count()) / repeat / 1000.0);
+    std::printf("allocations/node  : %.2f\n", static_cast<double>(allocations) / static_cast<double>(nodes));
+    std::printf("leaf copies/node  : %.2f\n", static_cast<double>(copies) / static_cast<double>(nodes));
+
+    return 0;
+}
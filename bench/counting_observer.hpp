@@ -0,0 +1,29 @@
+/*!
+ * @file    counting_observer.hpp
+ * @brief   出来事の回数を数えるだけの観測者の例
+ * @detail  TASK_MANAGER_OBSERVER_HEADERにこのファイルを与えてビルドする(observer_exampleターゲット)。
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "task_observer.hpp"
+
+struct CountingObserver : TaskManager::Observer::Null {
+    static inline std::uint64_t inits{0};
+    static inline std::uint64_t evals{0};
+    static inline std::uint64_t quits{0};
+    static inline std::uint64_t interrupts{0};
+    static inline std::uint64_t jumps{0};
+    static inline std::uint64_t scenes{0};
+
+    static void on_init(const TaskManager::Expr::AbstTask&) noexcept { ++inits; }
+    static void on_eval(const TaskManager::Expr::AbstTask&) noexcept { ++evals; }
+    static void on_quit(const TaskManager::Expr::AbstTask&) noexcept { ++quits; }
+    static void on_interrupt(const TaskManager::Expr::AbstTask&) noexcept { ++interrupts; }
+    static void on_jump(const TaskManager::Expr::AbstTask&, const TaskManager::Expr::AbstTask&, int, bool) noexcept { ++jumps; }
+    static void on_scene(const TaskManager::Expr::AbstTask&, const TaskManager::Expr::AbstTask&, const TaskManager::Expr::AbstTask&) noexcept { ++scenes; }
+};
+
+#define TASK_MANAGER_OBSERVER CountingObserver
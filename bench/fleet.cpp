@@ -0,0 +1,299 @@
+/*!
+ * @file    fleet.cpp
+ * @brief   同じ木を百万個並べて周期を揃えて実行し、規模を見積もる
+ * @detail  機器1台分の木(条件分岐・ループ・Switch・多重レート・待機を含む)をFleet::Programに写し、
+ *          N個の実体(既定は1000000)をMサイクル(既定は100)回す。
+ *          実体を1つずつ評価するPopulation、まとめて評価するLockstep、条件をBatchにしたLockstepを比べ、
+ *          1秒当たりの周期の数、実体1つ・1周期当たりの時間、実体1つ当たりの大きさを表示する。
+ *          大きさはAbstTaskの木を丸ごとコピーした場合とも比べる。機器のデータが3通りで食い違えば0以外で終了する。
+ *          続けて、機能ごとの手間を表示する。葉の位置に置く節点(Task, Delay)は子が何もしない根との差、
+ *          子を持つ節点は8段重ねた木と葉1つだけの木との差を段数で割ったもの。揺らぎに収まる差はnoiseと表示する。
+ *          引数は「実体の数 周期の数」。
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "task_includes.hpp"
+
+// operator newを置き換えて確保した大きさを数える
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+
+namespace
+{
+std::size_t g_bytes{0};
+
+// 実体ごとの機器のデータ。関数オブジェクトはFleet::current()で引く
+struct Device {
+    std::int32_t temperature;
+    std::int32_t count;
+    std::uint8_t mode;
+};
+std::vector<Device> g_device;
+
+Device& device() noexcept { return g_device[TaskManager::Fleet::current()]; }
+
+// 機器のデータを実体の番号でまとめて判定する
+void hot(const TaskManager::Fleet::instance_id* _ids, std::size_t _count, bool* _results)
+{
+    for (std::size_t i = 0; i < _count; ++i) {
+        _results[i] = g_device[_ids[i]].temperature > 60;
+    }
+}
+void every_third(const TaskManager::Fleet::instance_id* _ids, std::size_t _count, bool* _results)
+{
+    for (std::size_t i = 0; i < _count; ++i) {
+        _results[i] = ++g_device[_ids[i]].count % 3 == 0;
+    }
+}
+
+//! @brief _batchなら、一部の条件をFleet::Batchで書く(振る舞いは同じ)
+TaskManager::TaskSet device_tree(bool _batch = false)
+{
+    using namespace TaskManager;
+    auto is_hot = _batch ? std::function<bool()>{Fleet::Batch{&hot}} : std::function<bool()>{[] { return device().temperature > 60; }};
+    auto is_third = _batch ? std::function<bool()>{Fleet::Batch{&every_third}} : std::function<bool()>{[] { return ++device().count % 3 == 0; }};
+    return TaskSet(
+        [] { device().count = 0; },
+        While[([] { return true; })](
+            If[(is_hot)](
+                [] { device().mode = 2; },
+                Delay{5})
+                ->ElseIf[([] { return device().temperature < 20; })](
+                    [] { device().mode = 1; })
+                ->Else(
+                    [] { device().mode = 0; }),
+            Switch[([] { return static_cast<int>(device().mode); })](
+                Case<0>(
+                    Every{10}(
+                        [] { ++device().temperature; })),
+                Case<1>(
+                    Do(
+                        [] { device().temperature += 3; })
+                        ->Until[([] { return device().temperature >= 30; })]
+                        ->PerCycle(4)),
+                Default(
+                    [] { device().temperature -= 7; })),
+            Wait[(is_third)]));
+}
+
+void reset_devices(std::size_t _size)
+{
+    g_device.assign(_size, Device{});
+    for (std::size_t i = 0; i < _size; ++i) {
+        g_device[i].temperature = static_cast<std::int32_t>(i % 80);
+    }
+}
+
+double elapsed_ns(std::chrono::steady_clock::time_point _begin)
+{
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _begin).count());
+}
+
+//! @brief _treeを_size個並べて_cycles周期回し、実体1つ・1周期当たりの時間[ns]を返す
+template <typename Population>
+double measure(TaskManager::Expr::AbstTask& _tree, std::size_t _size, int _cycles)
+{
+    using namespace TaskManager;
+
+    auto program = Fleet::Program::compile(_tree);
+    Population population{program, _size};
+    population.start();
+    population.step();  // 1周期目はinitが重なるので除く
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < _cycles; ++i) {
+        population.step();
+    }
+    return elapsed_ns(begin) / static_cast<double>(_size) / _cycles;
+}
+
+struct Run {
+    double total_ns;
+    std::size_t bytes_per_instance;
+    std::size_t running;
+    std::vector<Device> devices;
+};
+
+//! @brief 機器の木を_size個並べて_cycles周期回す。Everyの位相を揃えるため、周期の番号を100の倍数から始める
+template <typename Population>
+Run run(bool _batch, std::size_t _size, int _cycles)
+{
+    using namespace TaskManager;
+
+    auto tree = device_tree(_batch);
+    auto program = Fleet::Program::compile(tree);
+    reset_devices(_size);
+    Population population{program, _size};
+    Cycle::advance(100 - Cycle::epoch() % 100);
+    population.start();
+
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < _cycles; ++i) {
+        population.step();
+    }
+    auto total_ns = elapsed_ns(begin);
+    return {total_ns, population.bytes_per_instance(), population.running_count(), std::move(g_device)};
+}
+
+bool same(const std::vector<Device>& _lhs, const std::vector<Device>& _rhs)
+{
+    if (_lhs.size() != _rhs.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < _lhs.size(); ++i) {
+        if (_lhs[i].temperature != _rhs[i].temperature || _lhs[i].count != _rhs[i].count || _lhs[i].mode != _rhs[i].mode) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool never() noexcept { return false; }
+void never_batch(const TaskManager::Fleet::instance_id*, std::size_t _count, bool* _results) { std::fill(_results, _results + _count, false); }
+int zero() noexcept { return 0; }
+
+//! @brief 葉(never)を_wrapでDepth段包んだ木を作る
+template <int Depth, typename Wrap>
+auto nest(Wrap _wrap)
+{
+    if constexpr (Depth == 0) {
+        return &never;
+    } else {
+        return _wrap(nest<Depth - 1>(_wrap));
+    }
+}
+}  // namespace
+
+void* operator new(std::size_t _size)
+{
+    g_bytes += _size;
+    if (auto ptr = std::malloc(_size)) {
+        return ptr;
+    }
+    throw std::bad_alloc{};
+}
+void operator delete(void* _ptr) noexcept { std::free(_ptr); }
+void operator delete(void* _ptr, std::size_t) noexcept { std::free(_ptr); }
+
+int main(int argc, char** argv)
+{
+    using namespace TaskManager;
+
+    std::size_t size = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    int cycles = argc > 2 ? std::stoi(argv[2]) : 100;
+
+    // 木を丸ごとコピーした場合の、1つ当たりの大きさ
+    constexpr std::size_t object_samples = 1000;
+    auto prototype = device_tree();
+    std::vector<std::unique_ptr<TaskSet>> objects;
+    objects.reserve(object_samples);
+    auto bytes_before = g_bytes;
+    for (std::size_t i = 0; i < object_samples; ++i) {
+        objects.emplace_back(new TaskSet{prototype});
+    }
+    auto object_bytes = (g_bytes - bytes_before) / object_samples;
+    objects.clear();
+
+    auto program = Fleet::Program::compile(prototype);
+    std::printf("instances             : %zu\n", size);
+    std::printf("cycles                : %d\n", cycles);
+    std::printf("nodes / state words   : %zu / %u\n", program->size(), program->slot_count());
+    std::printf("shared program        : %zu bytes\n", program->shared_bytes());
+    std::printf("object tree           : %zu bytes per instance\n", object_bytes);
+
+    auto scalar = run<Fleet::Population>(false, size, cycles);
+    auto lockstep = run<Fleet::Lockstep>(false, size, cycles);
+    auto batch = run<Fleet::Lockstep>(true, size, cycles);
+
+    std::printf("\n%-18s %8s %12s %10s %8s\n", "", "bytes", "cycles/s", "ns/inst", "running");
+    for (auto& [name, result] : {std::pair<const char*, const Run*>{"population", &scalar}, {"lockstep", &lockstep}, {"lockstep + batch", &batch}}) {
+        std::printf("%-18s %8zu %12.1f %10.2f %8zu\n", name, result->bytes_per_instance,
+            cycles / result->total_ns * 1e9, result->total_ns / static_cast<double>(size) / cycles, result->running);
+    }
+
+    // 機能ごとの手間。葉の位置に置く節点(Task, Delay)は、子が何もしない根(番の来ないEvery)との差を見る。
+    // 子を持つ節点は1段では差が揺らぎに埋もれるので、feature_depth段重ねた木と葉1つだけの木(TaskSet+Task)との差を段数で割る。
+    // どちらも基準の木には測る節点が含まれない。各木はfeature_repeats回測って最小を採り、基準の揺らぎの幅に収まる差はnoiseと表示する
+    constexpr int feature_depth = 8;
+    constexpr int feature_repeats = 3;
+    struct Feature {
+        const char* name;
+        int depth;
+        std::function<TaskSet()> tree;
+    };
+    auto always = [] { return true; };
+    std::vector<Feature> features{
+        {"Task", 1, [] { return TaskSet(&never); }},
+        {"Delay", 1, [] { return TaskSet(Delay{1 << 30}); }},
+        {"TaskSet", feature_depth, [] { return TaskSet(nest<feature_depth>([](auto&& _child) { return TaskSet(std::move(_child)); })); }},
+        {"While", feature_depth, [=] { return TaskSet(nest<feature_depth>([=](auto&& _child) { return While[always](std::move(_child)); })); }},
+        {"DoWhile", feature_depth, [=] { return TaskSet(nest<feature_depth>([=](auto&& _child) { return Do(std::move(_child))->While[always]; })); }},
+        {"If", feature_depth, [=] { return TaskSet(nest<feature_depth>([=](auto&& _child) { return If[always](std::move(_child)); })); }},
+        {"Switch", feature_depth, [] { return TaskSet(nest<feature_depth>([](auto&& _child) { return Switch[&zero](Case<0>(std::move(_child))); })); }},
+        {"Every", feature_depth, [] { return TaskSet(nest<feature_depth>([](auto&& _child) { return Every{1}(std::move(_child)); })); }},
+    };
+
+    struct Baseline {
+        double population;
+        double lockstep;
+        double population_noise;  //!< 繰り返した測定の最大と最小の差
+        double lockstep_noise;
+    };
+    auto baseline = [size, cycles](TaskSet _tree) {
+        Baseline result{std::numeric_limits<double>::max(), std::numeric_limits<double>::max(), 0.0, 0.0};
+        double population_max = 0.0, lockstep_max = 0.0;
+        for (int i = 0; i < feature_repeats; ++i) {
+            auto population = measure<Fleet::Population>(_tree, size, cycles);
+            auto lockstep = measure<Fleet::Lockstep>(_tree, size, cycles);
+            result.population = std::min(result.population, population);
+            result.lockstep = std::min(result.lockstep, lockstep);
+            population_max = std::max(population_max, population);
+            lockstep_max = std::max(lockstep_max, lockstep);
+        }
+        result.population_noise = population_max - result.population;
+        result.lockstep_noise = lockstep_max - result.lockstep;
+        return result;
+    };
+    auto idle = baseline(TaskSet(Every{1 << 30, (1 << 30) - 1}(&never)));
+    auto leaf = baseline(TaskSet(&never));
+    auto batch_leaf = baseline(TaskSet(Fleet::Batch{&never_batch}));
+
+    // 差が基準の揺らぎの幅(段数で割ったもの)以下ならnoiseと表示する
+    auto print_cost = [](double _cost, double _base, double _noise, int _depth) {
+        auto difference = (_cost - _base) / _depth;
+        if (difference <= _noise / _depth) {
+            std::printf("  %8s", "noise");
+        } else {
+            std::printf("  %+8.2f", difference);
+        }
+    };
+
+    std::printf("\nfeature cost [ns per node and cycle]  population  lockstep\n");
+    std::printf("  %-8s (TaskSet+idle Every)      %8.2f  %8.2f\n", "baseline", idle.population, idle.lockstep);
+    std::printf("  %-8s (TaskSet+Task)            %8.2f  %8.2f\n", "baseline", leaf.population, leaf.lockstep);
+    std::printf("  %-8s (TaskSet+Batch)           %8.2f  %8.2f\n", "baseline", batch_leaf.population, batch_leaf.lockstep);
+    for (auto& feature : features) {
+        auto leaf_feature = feature.depth == 1;
+        auto& base = leaf_feature ? idle : leaf;
+        auto cost = baseline(feature.tree());
+        std::printf("  %-8s %-24s", feature.name, leaf_feature ? "(vs idle)" : "(vs TaskSet+Task)");
+        print_cost(cost.population, base.population, base.population_noise, feature.depth);
+        print_cost(cost.lockstep, base.lockstep, base.lockstep_noise, feature.depth);
+        std::printf("\n");
+    }
+
+    if (!same(scalar.devices, lockstep.devices) || !same(scalar.devices, batch.devices)) {
+        std::printf("\nresults differ\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
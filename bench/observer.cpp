@@ -0,0 +1,44 @@
+/*!
+ * @file    observer.cpp
+ * @brief   ビルド時に選んだ観測者に出来事が届くことを確かめる
+ * @detail  counting_observer.hppを観測者としてビルドし、ジャンプとシーンの切り替えを含む木を回して回数を表示する。
+ *          届かなかった出来事が有れば0以外で終了する。
+ */
+
+#include <cstdio>
+
+#include "task_includes.hpp"
+
+#ifndef TASK_MANAGER_OBSERVER
+#error "build with TASK_MANAGER_OBSERVER_HEADER=counting_observer.hpp"
+#endif
+
+int main()
+{
+    using namespace TaskManager;
+
+    int count = 0;
+    auto root = TaskSet(
+        During(
+            While[([&count] { return count < 100; })](
+                [&count] { ++count; }))
+            ->JumpBackIf[1][([&count] { return count == 50; })](
+                [&count] { count += 10; }),
+        Delay{3});
+
+    root.start();
+    while (root.running()) {
+        root.resume();
+    }
+
+    std::printf("init      : %llu\n", static_cast<unsigned long long>(CountingObserver::inits));
+    std::printf("eval      : %llu\n", static_cast<unsigned long long>(CountingObserver::evals));
+    std::printf("quit      : %llu\n", static_cast<unsigned long long>(CountingObserver::quits));
+    std::printf("interrupt : %llu\n", static_cast<unsigned long long>(CountingObserver::interrupts));
+    std::printf("jump      : %llu\n", static_cast<unsigned long long>(CountingObserver::jumps));
+    std::printf("scene     : %llu\n", static_cast<unsigned long long>(CountingObserver::scenes));
+
+    auto ok = CountingObserver::inits > 0 && CountingObserver::evals > 0 && CountingObserver::quits > 0
+              && CountingObserver::interrupts > 0 && CountingObserver::jumps == 1 && CountingObserver::scenes == 1;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,114 @@
+/*!
+ * @file    realtime.cpp
+ * @brief   warm_up()後の定常状態でresume()がヒープ確保をしないことを確かめる
+ * @detail  条件分岐・ループ・ジャンプ(シーンの行き来を含む)・Switch・多重レート・Memoを含む木を組み、
+ *          ジャンプ先の予備を使い回す設定でwarm_up()してから数周期回した後、続くN周期の間の確保回数を数える。
+ *          確保が有れば0以外で終了する。TASK_MANAGER_RT_CHECKを定義してビルドする。
+ *          スレッドの実時間設定は、権限が無ければできなかった旨を表示するだけで、結果には影響しない。
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "task_includes.hpp"
+
+#ifndef TASK_MANAGER_RT_CHECK
+#error "build with TASK_MANAGER_RT_CHECK"
+#endif
+
+namespace
+{
+int g_tick{0};
+int g_count{0};
+double g_pressure{0.0};
+
+double read_pressure() noexcept { return g_pressure; }
+int mode() noexcept { return g_tick % 3; }
+
+auto body()
+{
+    using namespace TaskManager;
+    return TaskSet(
+        If[Cond(g_tick) % 2 == 0](
+            [] { ++g_count; })
+            ->ElseIf[Memo(Cond(&read_pressure) * 0.5) > 10.0](
+                [] { --g_count; })
+            ->Else(
+                [] {}),
+        ExclusiveIf[Cond(&mode) == 0](
+            [] { ++g_count; })
+            ->ElseIf[Cond(&mode) == 1](
+                [] { --g_count; }),
+        Switch[&mode](
+            Case<0>(
+                Delay{2}),
+            Case<1>(
+                [] { ++g_count; }),
+            Default(
+                Wait[Cond(g_tick) % 4 == 0])),
+        Every{4}(
+            [] { ++g_count; }),
+        Do(
+            [] { ++g_count; })
+            ->Until[Cond(g_count) % 5 == 0]
+            ->PerCycle(3),
+        During(
+            While[Cond(g_tick) >= 0](
+                [] {}))
+            ->JumpBackIf[Cond(g_tick) % 7 == 0](
+                [] { ++g_count; },
+                Delay{2}));
+}
+}  // namespace
+
+int main()
+{
+    using namespace TaskManager;
+
+    constexpr int settle = 200;
+    constexpr int measure = 10000;
+
+    // 2つのシーンを行き来する(JumpIfのジャンプ先は予めwarm_up()でコピーしておかれる)
+    auto jump1 = During(
+        While[Cond(g_tick) >= 0](
+            body()));
+    auto scene1 = TaskSet(jump1);
+    auto scene2 = TaskSet(
+        During(
+            While[Cond(g_tick) >= 0](
+                body()))
+            ->JumpIf[Cond(g_tick) % 13 == 0](
+                scene1));
+    jump1->JumpIf[Cond(g_tick) % 11 == 0](
+        scene2);
+
+    auto tree = TaskSet(scene1);
+    auto setup = RealTime::setup_thread();
+    for (auto& failure : setup.failures) {
+        std::printf("setup skipped     : %s\n", failure.c_str());
+    }
+
+    // シーンの行き来でも確保しないよう、ジャンプ先の予備を使い回す(葉の関数オブジェクトはどれも状態を持たない)
+    RealTime::set_reuse_jump_targets(true);
+    tree.start();
+    RealTime::pre_touch(tree);
+
+    for (int i = 0; i < settle; ++i, ++g_tick) {
+        tree.resume();
+    }
+
+    RealTime::reset_allocations();
+    RealTime::set_check(RealTime::Check::Count);
+    for (int i = 0; i < measure; ++i, ++g_tick) {
+        g_pressure = static_cast<double>(i % 40);
+        tree.resume();
+    }
+    RealTime::set_check(RealTime::Check::Off);
+
+    auto allocations = RealTime::allocations();
+    std::printf("cycles            : %d\n", measure);
+    std::printf("allocations       : %zu\n", allocations);
+    std::printf("running           : %s\n", tree.running() ? "yes" : "no");
+
+    return allocations == 0 && tree.running() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,99 @@
+/*!
+ * @file    replay.cpp
+ * @brief   記録した条件式・葉の結果を再生し、ライブラリ自身の手間だけを測る
+ * @detail  条件分岐・ループ・Switch・多重レート・シーンの行き来を含む木をN周期記録してから、
+ *          同じ形の新しい木で再生する。再生中は関数オブジェクトを呼ばないので、1周期当たりの時間はほぼ木を辿る手間になる。
+ *          再生が記録と食い違えば0以外で終了する。
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "task_includes.hpp"
+
+namespace
+{
+int g_tick{0};
+int g_count{0};
+
+int mode() noexcept { return g_tick % 3; }
+
+auto body()
+{
+    using namespace TaskManager;
+    return TaskSet(
+        If[Cond(g_tick) % 2 == 0](
+            [] { ++g_count; })
+            ->Else(
+                [] { --g_count; }),
+        Switch[&mode](
+            Case<0>(
+                Delay{2}),
+            Case<1>(
+                [] { ++g_count; }),
+            Default(
+                Wait[Cond(g_tick) % 4 == 0])),
+        Every{4}(
+            [] { ++g_count; }),
+        Do(
+            [] { ++g_count; })
+            ->Until[Cond(g_count) % 5 == 0]
+            ->PerCycle(3));
+}
+
+TaskManager::TaskSet tree()
+{
+    using namespace TaskManager;
+
+    auto jump1 = During(
+        While[Cond(g_tick) >= 0](
+            body()));
+    auto scene1 = TaskSet(jump1);
+    auto scene2 = TaskSet(
+        During(
+            While[Cond(g_tick) >= 0](
+                body()))
+            ->JumpIf[Cond(g_tick) % 13 == 0](
+                scene1));
+    jump1->JumpIf[Cond(g_tick) % 11 == 0](
+        scene2);
+    return TaskSet(scene1);
+}
+
+double per_cycle_ns(std::chrono::steady_clock::duration _elapsed, int _cycles)
+{
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(_elapsed).count()) / _cycles;
+}
+}  // namespace
+
+int main()
+{
+    using namespace TaskManager;
+
+    constexpr int cycles = 100000;
+
+    auto recorded = tree();
+    recorded.start();
+    Replay::Recorder recorder{std::size_t{cycles} * 8};
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < cycles; ++i, ++g_tick) {
+        recorder.resume(recorded);
+    }
+    auto live = std::chrono::steady_clock::now() - begin;
+
+    auto replayed = tree();
+    replayed.start();
+    auto player = Replay::Player{recorder.data()};
+    begin = std::chrono::steady_clock::now();
+    while (player.resume(replayed)) {
+    }
+    auto replay = std::chrono::steady_clock::now() - begin;
+
+    std::printf("cycles            : %d\n", cycles);
+    std::printf("log size          : %zu bytes\n", recorder.data().size());
+    std::printf("record [ns/cycle] : %.1f\n", per_cycle_ns(live, cycles));
+    std::printf("replay [ns/cycle] : %.1f\n", per_cycle_ns(replay, cycles));
+
+    return player.played() == static_cast<std::size_t>(cycles) && replayed.running() == recorded.running() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,164 @@
+/*!
+ * @file    simulation.cpp
+ * @brief   仮想の時刻で、1時間近くの制御を実際の時間より速く実行する
+ * @detail  1kHzの制御周期で、加熱・冷却・待機を60回繰り返す木を実行する。
+ *          待機中(Delay、Everyの番でない周期、Limitの上限まで)の周期をまとめて飛ばした場合と、
+ *          全ての周期を評価した場合を比べ、結果(温度の履歴と周期の番号)が同じであることを確かめる。
+ *          続けて、時間で区切るループ(PerCycle(500us))が仮想の時刻の下でも1周期で打ち切られること、
+ *          入れ子にしたRunnerを破棄すると外側の時刻に戻ること、
+ *          Schedulerの予算を使い切った後のDeferrableが仮想の時刻の下でも後回しにされることを確かめる。
+ *          どれかが食い違えば0以外で終了する。
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "task_includes.hpp"
+
+namespace
+{
+struct Plant {
+    double temperature{20.0};
+    bool heater{false};
+    std::vector<double> history;  //!< 毎分の温度
+
+    //! @brief 経過時間_elapsedの分だけ、加熱・放熱する(厳密解なので、まとめて進めても刻んで進めても同じ)
+    void step(TaskManager::Clock::duration _elapsed)
+    {
+        auto seconds = std::chrono::duration<double>{_elapsed}.count();
+        auto target = 20.0 + (heater ? 2.0 : 0.0) / 0.01;
+        temperature = target + (temperature - target) * std::exp(-0.01 * seconds);
+    }
+};
+
+TaskManager::TaskSet tree(Plant& _plant)
+{
+    using namespace TaskManager;
+
+    return TaskSet(
+        While[([&_plant] { return _plant.history.size() < 60; })](
+            [&_plant] { _plant.heater = true; },
+            Limit{std::chrono::seconds{20}}(
+                Wait[([&_plant] { return _plant.temperature >= 60.0; })]),
+            [&_plant] { _plant.heater = false; },
+            Limit{std::chrono::seconds{30}}(
+                Every{100}(
+                    Wait[([&_plant] { return _plant.temperature < 40.0; })])),
+            Delay{60000 - 50000},
+            [&_plant] { _plant.history.push_back(_plant.temperature); }));
+}
+
+struct Result {
+    std::vector<double> history;
+    TaskManager::Cycle::epoch_type cycles;
+    TaskManager::Simulation::Statistics statistics;
+    double wall_ms;
+};
+
+Result simulate(bool _skip_idle)
+{
+    using namespace TaskManager;
+
+    Plant plant;
+    Simulation::Runner runner{std::chrono::milliseconds{1}};
+    runner.set_skip_idle(_skip_idle);
+    runner.set_environment([&plant](Clock::duration _elapsed) { plant.step(_elapsed); });
+    runner.add(tree(plant));
+
+    auto epoch = Cycle::epoch();
+    auto begin = std::chrono::steady_clock::now();
+    runner.run_until_done(std::chrono::hours{2});
+    auto wall = std::chrono::steady_clock::now() - begin;
+
+    return {plant.history, Cycle::epoch() - epoch, runner.statistics(), std::chrono::duration<double, std::milli>{wall}.count()};
+}
+
+//! @brief 仮想の時刻は周期の中で進まないので、ループの時間の上限は実際の時間で打ち切られる。1周期目の周回数を返す
+std::uint64_t budgeted_loop_iterations()
+{
+    using namespace TaskManager;
+
+    constexpr std::uint64_t limit = 5000000000;
+    std::uint64_t count = 0;
+    Simulation::Runner runner{std::chrono::milliseconds{1}};
+    runner.add(TaskSet(
+        While[([&count] { return count < limit; })]([&count] { ++count; })->PerCycle(std::chrono::microseconds{500})));
+    runner.step();
+    auto first = count;
+    runner.step();
+    return runner.running() && count > first ? first : limit;
+}
+
+//! @brief 外側のVirtualTimeの中でRunnerを使っても、破棄した後は外側の時刻が続くか
+bool nested_time_restored()
+{
+    using namespace TaskManager;
+
+    VirtualTime outer{Clock::time_point{std::chrono::hours{1}}};
+    Clock::advance(std::chrono::seconds{5});
+    auto before = Clock::now();
+    {
+        Simulation::Runner runner{std::chrono::milliseconds{1}};
+        runner.add(TaskSet(Delay{10}));
+        runner.run_until_done(std::chrono::seconds{1});
+    }
+    return Clock::is_virtual() && Clock::now() == before;
+}
+
+//! @brief 仮想の時刻の下でも、Schedulerの予算は実際の時間で測られ、予算を使い切った後のDeferrableは後回しにされるか
+bool deferred_under_virtual_time()
+{
+    using namespace TaskManager;
+
+    VirtualTime time;
+    Scheduler scheduler{std::chrono::microseconds{100}};
+    scheduler.add(TaskSet(
+        [] {
+            auto end = std::chrono::steady_clock::now() + std::chrono::microseconds{300};
+            while (std::chrono::steady_clock::now() < end) {
+            }
+        },
+        Deferrable[0]([] {})));
+    scheduler.cycle();
+    return scheduler.report().deferred_subtrees > 0;
+}
+}  // namespace
+
+int main()
+{
+    // Everyの位相が周期の番号で決まるので、両方を同じ位相から始める
+    TaskManager::Cycle::advance(100 - TaskManager::Cycle::epoch() % 100);
+    auto full = simulate(false);
+    TaskManager::Cycle::advance(100 - TaskManager::Cycle::epoch() % 100);
+    auto fast = simulate(true);
+
+    std::printf("simulated cycles  : %llu\n", static_cast<unsigned long long>(fast.cycles));
+    std::printf("every cycle       : %.1f ms (%llu evaluated)\n", full.wall_ms, static_cast<unsigned long long>(full.statistics.executed));
+    std::printf("skipping idle     : %.1f ms (%llu evaluated, %llu skipped in %llu jumps)\n", fast.wall_ms,
+        static_cast<unsigned long long>(fast.statistics.executed), static_cast<unsigned long long>(fast.statistics.skipped),
+        static_cast<unsigned long long>(fast.statistics.skips));
+    std::printf("final temperature : %.2f\n", fast.history.empty() ? 0.0 : fast.history.back());
+
+    auto iterations = budgeted_loop_iterations();
+    auto restored = nested_time_restored();
+    auto deferred = deferred_under_virtual_time();
+    std::printf("loop budget       : %llu iterations in the first 500us cycle\n", static_cast<unsigned long long>(iterations));
+    std::printf("nested time       : %s\n", restored ? "restored" : "NOT restored");
+    std::printf("scheduler budget  : %s\n", deferred ? "deferred over budget" : "NOT deferred");
+    if (iterations == 0 || iterations >= 5000000000 || !restored || !deferred || TaskManager::Clock::is_virtual()) {
+        return EXIT_FAILURE;
+    }
+
+    if (full.cycles != fast.cycles || full.history.size() != fast.history.size()) {
+        return EXIT_FAILURE;
+    }
+    for (std::size_t i = 0; i < full.history.size(); ++i) {
+        if (std::abs(full.history[i] - fast.history[i]) > 1e-6) {
+            return EXIT_FAILURE;
+        }
+    }
+    return EXIT_SUCCESS;
+}
@@ -3,20 +3,41 @@
  * @brief   タスクを扱う全クラスの親となる抽象クラスを定義する
  */
 
-// TODO: abst_task.cpp 参照
-
 #pragma once
 
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <optional>
 #include <type_traits>
 
+#include "./task_introspection.hpp"
+
 namespace TaskManager
 {
 
+namespace Expr
+{
+    class AbstTask;
+}
+namespace Metrics
+{
+    struct RootMetrics;
+}
+namespace Fleet
+{
+    class Builder;
+}
+namespace Analysis
+{
+    struct CostModel;
+    struct WorstCase;
+    std::size_t interrupt_cascade(Expr::AbstTask&);
+}
+
 namespace Expr
 {
 
@@ -50,6 +71,25 @@ namespace Expr
     using for_copy_t = typename for_copy_recursive<T>::type;
 
 
+    /*!
+     * @brief 関数オブジェクトが呼び出せない(nullptrを指す)かを調べる
+     * @detail std::functionや関数ポインタのように、boolへ明示的に変換できる型についてのみ調べる。
+     * ラムダ式など、それ以外の型は常に呼び出せるとみなす。
+     * std::functionに包んでから調べると余計なヒープ確保が起こるので、こちらを使う。
+     */
+    template <typename T>
+    bool is_null_callable(const T& _func)
+    {
+        if constexpr (std::is_function<T>::value) {
+            return false;
+        } else if constexpr (std::is_constructible<bool, const T&>::value) {
+            return !static_cast<bool>(_func);
+        } else {
+            return false;
+        }
+    }
+
+
     class AbstTask;
     /*!
      * AbstTask::eval()、AbstTask::evaluate_task()の返り値の型
@@ -100,8 +140,12 @@ namespace Expr
      */
     class AbstTask
     {
+        friend std::size_t Analysis::interrupt_cascade(AbstTask&);
+        friend class Fleet::Builder;
+
     private:
         bool m_me_on_eval{false};                                                               //!< このタスクが実行中かを示すフラグ
+        Introspection::node_id m_node_id{Introspection::issue_node_id()};                       //!< 節点の番号。コピーしたものは別の番号を持つ(フラグの後の隙間に置く)
         std::shared_ptr<AbstTask> m_manager{nullptr};                                           //!< このタスクを管理しているマネージャーのポインタ
         std::shared_ptr<AbstTask> m_task_on_eval{std::shared_ptr<AbstTask>{nullptr}, this};     //!< このマシンが実行しているタスクのポインタ
         std::atomic<bool> m_running{false};                                                     //!< このマネージャーがタスク処理を呼び出す状態かを示すフラグ
@@ -111,6 +155,13 @@ namespace Expr
 
         std::mutex m_machine_mutex;  //!< タスクの実行と中断処理が同時に行われないようにするmutex
 
+        //! @brief 根としてだけ使う情報(実行中の経路、統計などの書き込み先)
+        struct RootState;
+        std::atomic<RootState*> m_root_state{nullptr};  //!< 根として使われた時に初めて作る。コピー・ムーブでは移動しない
+
+        //! @brief m_root_stateを得る。無ければ作る
+        RootState& root_state();
+
     public:
         std::function<void()> interrupt_func{nullptr};  //!< このタスクのinterruptの直後に呼ばれる
 
@@ -178,6 +229,15 @@ namespace Expr
          */
         void force_quit(AbstTask&) noexcept;
 
+        /*!
+         * @brief _taskが次から何周期の間、待つだけかを調べる
+         * @detail 子の分を調べる時にはwaiting_cycles()を直接ではなくこれを呼ぶ。
+         * マシンが実行するタスクを見て、まだ実行を始めていなければ0を返す。
+         */
+        std::uint64_t waiting_cycles_of(AbstTask&);
+        //! @brief _taskの_cycles周期分(waiting_cycles_of(_task)以下)を評価せずに済ませる
+        void skip_waiting_of(AbstTask&, std::uint64_t _cycles);
+
     private:
         /*!
          * @fn
@@ -204,6 +264,63 @@ namespace Expr
 
         bool running() noexcept;
 
+        /*!
+         * @brief 実行中にヒープ確保が起きないよう、木の全ての節点で必要なものを作っておく
+         * @detail Switchの全caseの実行用タスク、ジャンプ先の予備、多重レートの位相などを用意する。
+         * 実行を始める前に根で1度呼べばよい。周期の合間に呼び直すと、使い終わったジャンプ先の予備を作り直す。
+         */
+        void warm_up();
+
+        /*!
+         * @brief 自分と木の中の全ての子孫を、親から順に訪れる
+         * @detail まだ実行用に作られていない子(Switchのcaseなど)は、その雛形を訪れる。
+         * 雛形を書き換えてはいけない。
+         */
+        void visit(const std::function<void(AbstTask&)>&);
+
+        /*!
+         * @brief 自分の1回の評価で起こり得る最悪の仕事量
+         * @detail _modelのannotateが重みを返せば、それを葉1つとして使う。そうでなければanalyze()に任せる。
+         * @sa Analysis::worst_case
+         */
+        Analysis::WorstCase worst_case(const Analysis::CostModel& _model);
+
+        //! @brief 節点の番号。木の中の全ての節点で異なる
+        Introspection::node_id node_id() const noexcept { return m_node_id; }
+
+        /*!
+         * @brief 根として、実行中の経路を公開する
+         * @detail 初めて呼ばれた時に作り、以降のresume()の終わりに毎回書き込む。
+         * 他のスレッドはActivePath::read()で、制御スレッドを止めずに読める。
+         * 番号と節点の対応は、visit()とnode_id()で得られる。
+         */
+        std::shared_ptr<const Introspection::ActivePath> active_path();
+
+        /*!
+         * @brief 根として、resume()の度に共有メモリ上の統計へ書き込む
+         * @detail 普通はMetrics::Segment::attach()から呼ばれる。nullptrで止める。
+         */
+        void publish_metrics(Metrics::RootMetrics* _metrics);
+        /*!
+         * @brief 根として、評価の最中の経路を書き込む
+         * @detail 普通はProfiling::Sampler::attach()から呼ばれる。nullptrで止める。
+         * 書き込んでいる間は根も_stackを持つので、Samplerが先に破棄されても書き込み先は残る。
+         */
+        void publish_live_stack(std::shared_ptr<Introspection::LiveStack> _stack);
+
+        /*!
+         * @brief 根として、次から何周期の間、木が待つだけかを調べる
+         * @detail 実行中の経路の全ての節点が、その間は評価されても周期を数える以外に何もせず、未完了を返すと分かる周期の数。
+         * 分からなければ0。実行中でなければ0。
+         * @sa Simulation::Runner
+         */
+        std::uint64_t idle_cycles();
+        /*!
+         * @brief 根として、_cycles周期分(idle_cycles()以下)を評価せずに済ませる
+         * @detail 周期の番号や時計は進めない。呼んだ側が合わせて進める。
+         */
+        void skip_cycles(std::uint64_t _cycles);
+
 
     protected:
         // 以下、子クラスで(再)定義するメソッド
@@ -224,6 +341,33 @@ namespace Expr
          * Transitionで切り替わる時など
          */
         virtual void interrupt() { quit(); };
+
+        //! @brief 直接の子タスクそれぞれについて_funcを呼ぶ。子を持つクラスは再定義する
+        virtual void for_each_child(const std::function<void(AbstTask&)>& _func) { (void)_func; }
+        //! @brief warm_upで呼ばれる。実行中に作る物が有るクラスは、ここで作っておく
+        virtual void prepare() {}
+        /*!
+         * @brief worst_caseの中身
+         * @detail 既定では、子が有れば全ての子が続けて評価されるとして足し合わせ、無ければ葉1つとする。
+         * 分岐やループなど、そうでないクラスは再定義する。
+         */
+        virtual Analysis::WorstCase analyze(const Analysis::CostModel& _model);
+
+        /*!
+         * @brief 実行中の自分が、次から何周期の間、評価されても周期を数える以外に何もせず未完了を返すか
+         * @detail 既定は0(分からない)。Delayのように時間が経つのを待つだけのクラスと、
+         * 実行中の子に評価を任せるだけのクラス(子はwaiting_cycles_of()で調べる)が再定義する。
+         * 毎周期評価されることを前提に数える。
+         */
+        virtual std::uint64_t waiting_cycles() { return 0; }
+        //! @brief waiting_cycles()の範囲で、_cycles周期分の評価を済んだことにする(数を進める)
+        virtual void skip_waiting(std::uint64_t _cycles) { (void)_cycles; }
+
+        /*!
+         * @brief 自分をFleet::Programの節点として写し、その番号を返す
+         * @detail 既定ではFleet::Unsupportedを投げる。写せるクラスは再定義し、子は_builder.add()で写す。
+         */
+        virtual std::uint32_t compile(Fleet::Builder& _builder);
     };
 
 }  // namespace Expr
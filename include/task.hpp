@@ -39,16 +39,18 @@ public:
 
 protected:
     NextTask eval() override;
+    std::uint32_t compile(Fleet::Builder&) override;
 };
 
 
 // 初期化lambdaキャプチャを使用
+//     std::function<void()>を挟むと、小さな関数オブジェクトでもヒープ確保が起こるので、直接キャプチャする
 template <typename T, std::enable_if_t<std::is_same<void, decltype(std::declval<T>()())>::value, std::nullptr_t>>
 Task::Task(T&& _func)
     : m_function{nullptr}  // いったんnullptr
 {
-    if (std::function<void()> tmp{std::forward<T>(_func)}) {
-        m_function = [func = std::move(tmp)]() mutable  // _funcのoperator()がconstで無くても呼ぶ
+    if (!Expr::is_null_callable(_func)) {
+        m_function = [func = std::forward<T>(_func)]() mutable  // _funcのoperator()がconstで無くても呼ぶ
         {
             func();
             return true;
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#include "./task_replay.hpp"
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+
+    /*!
+     * @brief 互いに排他な条件式の、評価の統計
+     * @detail AdaptiveOrderをコピーしたもの同士で共有される。
+     * 値はAdaptiveOrderが並べ替えの度にまとめて書き込むので、少し遅れて反映される。
+     */
+    class ConditionStatistics
+    {
+    public:
+        //! @brief 条件式1つ分の統計
+        struct Entry {
+            std::uint64_t evaluations;          //!< 評価された回数
+            std::uint64_t hits;                 //!< 真を返した回数
+            std::chrono::nanoseconds mean_cost;  //!< 評価1回の平均時間(計測した分のみ)
+        };
+
+        //! @brief ある時点の統計
+        struct Snapshot {
+            std::vector<Entry> entries;       //!< 登録順
+            std::vector<std::size_t> order;  //!< 最後に決めた評価順
+            std::uint64_t reorders;           //!< 評価順を変えた回数
+            bool frozen;
+        };
+
+    private:
+        struct Counter {
+            std::atomic<std::uint64_t> evaluations{0};
+            std::atomic<std::uint64_t> hits{0};
+            std::atomic<std::uint64_t> timed{0};     //!< 時間を計測した回数
+            std::atomic<std::uint64_t> cost_ns{0};  //!< 計測した時間の合計
+        };
+
+        std::unique_ptr<Counter[]> m_counter_list;
+        std::size_t m_size;
+        std::vector<std::size_t> m_last_order;  //!< snapshot用
+        std::mutex m_order_mutex;              //!< m_last_orderを守る
+        std::atomic<std::uint64_t> m_reorders{0};
+        std::atomic<bool> m_frozen{false};
+
+        static std::atomic<bool> s_frozen_all;
+
+        friend class AdaptiveOrder;
+
+    public:
+        explicit ConditionStatistics(std::size_t _size);
+
+        ConditionStatistics(const ConditionStatistics&) = delete;
+        ConditionStatistics& operator=(const ConditionStatistics&) = delete;
+
+        std::size_t size() const noexcept { return m_size; }
+        Snapshot snapshot();
+
+        /*!
+         * @brief 条件式の数を変える。それまでの統計は引き継ぐ
+         * @detail 木を組んでいる間(条件式を追加する時)だけ使う。評価やsnapshot()と同時に呼んではいけない。
+         */
+        void resize(std::size_t _size);
+
+        /*!
+         * @brief 評価順を固定する
+         * @detail 固定中は並べ替えも時間の計測もしない。再現性の欲しい実行に使う。
+         */
+        void freeze(bool _frozen = true) noexcept { m_frozen = _frozen; }
+        bool frozen() const noexcept { return m_frozen || s_frozen_all; }
+
+        //! @brief 全ての評価順を一斉に固定する
+        static void freeze_all(bool _frozen = true) noexcept { s_frozen_all = _frozen; }
+    };
+
+
+    /*!
+     * @brief 互いに排他な条件式を、当たりやすく軽いものから評価するための並び
+     * @detail 条件式が排他なら、どの順に評価しても結果は変わらない。
+     * そこで、真を返した割合と評価にかかる時間を記録し、
+     * 一定回数ごとに「真になる確率 / 評価時間」の大きい順に並べ替える。
+     * 
+     * 数え上げはこのオブジェクトの中で行い、並べ替えの時にConditionStatisticsへまとめて書き込む。
+     * 評価時間は数回に1回だけ計測する。
+     * コピーすると、評価順は複製され、統計は共有される。
+     *
+     * 同じAdaptiveOrderを複数のスレッドから評価する時(JumpManagerを共有する根をExecutorで動かす時など)は、
+     * 最初に使い始めたスレッドだけが評価順と数え上げを使い、その間に来た他のスレッドは登録順に評価して数えない。
+     */
+    class AdaptiveOrder
+    {
+    public:
+        static constexpr std::uint32_t reorder_interval = 64;  //!< 並べ替えを検討する間隔(評価の回数)
+        static constexpr std::uint32_t timing_interval = 16;   //!< 評価時間を計測する間隔(評価の回数)
+
+    private:
+        struct LocalCounter {
+            std::uint32_t evaluations{0};
+            std::uint32_t hits{0};
+            std::uint32_t timed{0};
+            std::uint64_t cost_ns{0};
+        };
+
+        //! @brief 評価順と数え上げを使っている最中か。コピーしたものは使っていない状態から始める
+        struct Busy {
+            std::atomic<bool> flag{false};
+
+            Busy() noexcept {}
+            Busy(const Busy&) noexcept {}
+            Busy& operator=(const Busy&) noexcept { return *this; }
+        };
+
+        std::shared_ptr<ConditionStatistics> m_statistics;
+        Busy m_busy;
+        std::vector<std::size_t> m_order;
+        std::vector<LocalCounter> m_counter_list;
+        std::uint32_t m_calls{0};
+
+        // 並べ替えの作業領域(実行中にヒープ確保しないよう、予め確保しておく)
+        std::vector<double> m_score;
+        std::vector<std::size_t> m_next_order;
+
+    public:
+        explicit AdaptiveOrder(std::size_t _size);
+
+        AdaptiveOrder(const AdaptiveOrder&);
+        AdaptiveOrder& operator=(const AdaptiveOrder&) &;
+        AdaptiveOrder(AdaptiveOrder&&) noexcept = default;
+        AdaptiveOrder& operator=(AdaptiveOrder&&) & noexcept = default;
+
+        const std::shared_ptr<ConditionStatistics>& statistics() const noexcept { return m_statistics; }
+
+        /*!
+         * @brief 条件式の数を変える。統計は同じものを使い続け(statistics()で得たものも有効)、追加した条件式は評価順の最後に置く
+         * @detail 木を組んでいる間だけ使う。
+         */
+        void resize(std::size_t _size);
+
+        /*!
+         * @brief 現在の評価順で_test(index)を呼び、最初に真を返したindexを返す
+         * @return 全て偽ならnullopt
+         */
+        template <typename Test>
+        std::optional<std::size_t> find_first(Test&& _test);
+
+    private:
+        void reorder();
+    };
+
+
+    template <typename Test>
+    std::optional<std::size_t> AdaptiveOrder::find_first(Test&& _test)
+    {
+        using clock = std::chrono::steady_clock;
+
+        if (m_busy.flag.exchange(true, std::memory_order_acquire)) {  // 他のスレッドが使っている
+            for (std::size_t index = 0; index < m_statistics->size(); ++index) {
+                if (_test(index)) {
+                    return index;
+                }
+            }
+            return std::nullopt;
+        }
+
+        auto frozen = m_statistics->frozen();
+        auto timing = !frozen && m_calls % timing_interval == 0 && !Replay::active();  // 記録・再生中は時間で順序を変えない
+        std::optional<std::size_t> result{std::nullopt};
+
+        for (auto index : m_order) {
+            auto& counter = m_counter_list[index];
+            bool hit;
+
+            if (timing) {
+                auto begin = clock::now();
+                hit = _test(index);
+                ++counter.timed;
+                counter.cost_ns += static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - begin).count());
+            } else {
+                hit = _test(index);
+            }
+
+            ++counter.evaluations;
+            if (hit) {
+                ++counter.hits;
+                result = index;
+                break;
+            }
+        }
+
+        if (++m_calls >= reorder_interval) {
+            m_calls = 0;
+            reorder();
+        }
+
+        m_busy.flag.store(false, std::memory_order_release);
+        return result;
+    }
+
+}  // namespace Expr
+
+}  // namespace TaskManager
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "./abst_task.hpp"
+
+namespace TaskManager
+{
+
+/*!
+ * @brief 木の形から、1回のresume()で起こり得る最悪の仕事量を求める静的解析
+ * @detail 実行はせず、木の構造だけを見る。
+ * TaskSetの中のタスクが全て一瞬で終わって続けて評価されること、Ifの条件が全て評価されること、
+ * 実行中のDuringに積まれたジャンプ条件が全て評価されること、ジャンプによるinterruptの連鎖などを数える。
+ */
+namespace Analysis
+{
+    /*!
+     * @brief 仕事1つ当たりの重み
+     * @detail annotateが値を返した節点は、その部分木全体をその重みの葉1つとして扱う。
+     * 実測した最大の実行時間などを与えれば、costがそのまま実行時間の上界になる。
+     */
+    struct CostModel {
+        double leaf = 1.0;       //!< 葉(関数オブジェクトや利用者のタスク)の呼び出し1回
+        double condition = 1.0;  //!< 条件式(Switchのキー、ジャンプ条件を含む)の評価1回
+        double interrupt = 1.0;  //!< interrupt()1回
+        double node = 0.0;       //!< 節点の評価1回(ライブラリ自身の手間)
+
+        std::function<std::optional<double>(const Expr::AbstTask&)> annotate{nullptr};
+    };
+
+    //! @brief 最悪の場合の仕事量と、それを実現する経路
+    struct WorstCase {
+        std::size_t leaf_calls = 0;
+        std::size_t condition_evals = 0;
+        std::size_t interrupts = 0;
+        std::size_t nodes = 0;
+        double cost = 0.0;  //!< CostModelで重み付けした合計
+
+        bool bounded = true;            //!< 時間でしか打ち切られないループが無いか
+        bool may_switch_scene = false;  //!< OneWayジャンプで根ごと切り替わり得るか
+        std::vector<std::string> path;  //!< 最悪の場合に選ばれる分岐・ループの周回数などを、根から順に
+
+        void add_leaf(const CostModel&, std::size_t _count = 1);
+        void add_condition(const CostModel&, std::size_t _count = 1);
+        void add_interrupt(const CostModel&, std::size_t _count = 1);
+        void add_node(const CostModel&);
+
+        //! @brief 続けて起こる仕事を足す
+        WorstCase& operator+=(const WorstCase&);
+        //! @brief _count回繰り返した仕事
+        WorstCase repeated(std::size_t _count) const;
+
+        /*!
+         * @brief どちらか一方しか起こらない仕事のうち、重い方
+         * @detail may_switch_sceneとboundedは、選ばれなかった方の分も引き継ぐ(上界を保つため)。
+         */
+        static WorstCase larger(WorstCase&&, WorstCase&&);
+    };
+
+    //! @brief 節点の型名(名前空間を除く)
+    std::string type_name(const Expr::AbstTask&);
+
+    //! @brief _taskをforce_quitした時に連鎖して呼ばれ得るinterrupt()の最大数
+    std::size_t interrupt_cascade(Expr::AbstTask& _task);
+
+    /*!
+     * @brief 根_rootの1回のresume()の最悪の仕事量
+     * @detail AbstTask::worst_case()に加えて、OneWayジャンプで根の木全体がforce_quitされる分も数える。
+     * 実行中でも呼べるが、実行中の状態には依らない。
+     */
+    WorstCase worst_case(Expr::AbstTask& _root, const CostModel& = {});
+
+}  // namespace Analysis
+
+}  // namespace TaskManager
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+
+#include "./task_condition.hpp"
+
+namespace TaskManager
+{
+
+/*!
+ * @brief タスク間で共有するデータの置き場
+ * @detail 各項目は型付きで、書き込まれる度に版番号が1つ進む。
+ * Watchで読む項目を宣言した条件は、どの項目の版も変わっていなければ評価せずに前回の結果を返す。
+ * 制御スレッドの中で読み書きすることを前提としている(版番号だけはatomic)。
+ */
+class Blackboard
+{
+public:
+    using version_type = std::uint64_t;
+
+private:
+    struct AbstSlot {
+        std::atomic<version_type> version{1};
+
+        virtual ~AbstSlot() noexcept {}
+    };
+
+    template <typename T>
+    struct Slot : public AbstSlot {
+        T value;
+
+        explicit Slot(T&& _value) : value{std::move(_value)} {}
+    };
+
+public:
+    /*!
+     * @brief 黒板の1項目への参照
+     * @detail コピーは同じ項目を指す。
+     * 見つからなかった項目は空で、読むとT{}、書いても何もしない。
+     */
+    template <typename T>
+    class Entry
+    {
+    private:
+        friend class Blackboard;
+
+        std::shared_ptr<Slot<T>> m_slot;
+
+        explicit Entry(std::shared_ptr<Slot<T>>&& _slot) noexcept : m_slot{std::move(_slot)} {}
+
+    public:
+        using value_type = T;
+
+        Entry() noexcept {}
+
+        virtual ~Entry() noexcept {}
+
+        Entry(const Entry&) noexcept = default;
+        Entry& operator=(const Entry&) & noexcept = default;
+        Entry(Entry&&) noexcept = default;
+        Entry& operator=(Entry&&) & noexcept = default;
+
+        explicit operator bool() const noexcept { return static_cast<bool>(m_slot); }
+
+        const T& get() const noexcept
+        {
+            static const T empty{};
+            return m_slot ? m_slot->value : empty;
+        }
+
+        /*!
+         * @brief 値を書き込む
+         * @detail ==で比べられる型なら、同じ値の書き込みでは版を進めない。
+         * 浮動小数点数はビット列で比べる(NaNの書き直しでは進めず、0.0と-0.0の入れ替えでは進める)。
+         */
+        void set(T _value)
+        {
+            if (!m_slot) {
+                return;
+            }
+            if constexpr (std::is_floating_point_v<T>) {
+                if (std::memcmp(&m_slot->value, &_value, sizeof(T)) == 0) {
+                    return;
+                }
+            } else if constexpr (is_equality_comparable<T>::value) {
+                if (m_slot->value == _value) {
+                    return;
+                }
+            }
+            m_slot->value = std::move(_value);
+            m_slot->version.fetch_add(1, std::memory_order_release);
+        }
+
+        //! @brief 値をその場で書き換える。版は必ず進む
+        template <typename Func>
+        void modify(Func&& _func)
+        {
+            if (!m_slot) {
+                return;
+            }
+            std::forward<Func>(_func)(m_slot->value);
+            m_slot->version.fetch_add(1, std::memory_order_release);
+        }
+
+        //! @brief 版番号。空の項目は0
+        version_type version() const noexcept
+        {
+            return m_slot ? m_slot->version.load(std::memory_order_acquire) : 0;
+        }
+
+        //! @brief 条件式の葉として使う(Cond(entry) > 3)
+        T operator()() const { return get(); }
+        void identify(std::string& _key) const { Expr::append_identity(_key, m_slot.get()); }
+    };
+
+private:
+    template <typename T, typename = void>
+    struct is_equality_comparable : std::false_type {
+    };
+    template <typename T>
+    struct is_equality_comparable<T, std::void_t<decltype(std::declval<const T&>() == std::declval<const T&>())>>
+        : std::true_type {
+    };
+
+    std::unordered_map<std::string, std::shared_ptr<AbstSlot>> m_slot_map;
+
+    std::shared_ptr<AbstSlot> find_slot(const std::string& _name) const noexcept;
+    void add_slot(const std::string& _name, std::shared_ptr<AbstSlot>&& _slot);
+
+public:
+    Blackboard() noexcept {}
+
+    virtual ~Blackboard() noexcept {}
+
+    Blackboard(const Blackboard&) = delete;
+    Blackboard& operator=(const Blackboard&) = delete;
+
+    /*!
+     * @brief 項目を作る
+     * @detail 同じ名前・同じ型の項目が既に有ればそれを返す(初期値は使わない)。
+     * 同じ名前で型が違えば空のEntryを返す。
+     */
+    template <typename T>
+    Entry<T> add(const std::string& _name, T _initial = T{})
+    {
+        auto slot = find_slot(_name);
+        if (slot) {
+            return Entry<T>{std::dynamic_pointer_cast<Slot<T>>(std::move(slot))};
+        }
+
+        auto new_slot = std::make_shared<Slot<T>>(std::move(_initial));
+        add_slot(_name, new_slot);
+        return Entry<T>{std::move(new_slot)};
+    }
+
+    //! @brief 項目を探す。無いか型が違えば空のEntryを返す
+    template <typename T>
+    Entry<T> find(const std::string& _name) const noexcept
+    {
+        return Entry<T>{std::dynamic_pointer_cast<Slot<T>>(find_slot(_name))};
+    }
+};
+
+
+namespace Expr
+{
+
+    /*!
+     * @brief 読む項目を宣言した条件
+     * @detail 宣言した項目の版が前回の評価時から1つも変わっていなければ、条件を呼ばずに前回の結果を返す。
+     * 宣言していないものを読む条件に使うと、その変化を見逃す。
+     * 結果はコピー間で共有する(同じ入力なら同じ結果になる前提)。
+     */
+    template <typename... Entries>
+    class WatchCondition
+    {
+    private:
+        struct State {
+            std::array<Blackboard::version_type, sizeof...(Entries)> versions{};
+            bool result = false;
+            bool valid = false;
+        };
+
+        std::tuple<Entries...> m_inputs;
+        std::function<bool()> m_condition;
+        std::shared_ptr<State> m_state;
+
+    public:
+        WatchCondition(const std::tuple<Entries...>& _inputs, std::function<bool()>&& _condition)
+            : m_inputs{_inputs}, m_condition{std::move(_condition)}, m_state{std::make_shared<State>()} {}
+
+        bool operator()() const
+        {
+            auto versions = std::apply(
+                [](const auto&... entries) {
+                    return std::array<Blackboard::version_type, sizeof...(Entries)>{entries.version()...};
+                },
+                m_inputs);
+
+            if (!m_state->valid || versions != m_state->versions) {
+                m_state->result = m_condition();
+                m_state->versions = versions;
+                m_state->valid = true;
+            }
+            return m_state->result;
+        }
+    };
+
+    template <typename... Entries>
+    class WatchHead
+    {
+    private:
+        std::tuple<Entries...> m_inputs;
+
+        std::function<bool()> make(std::function<bool()>&& _condition) const
+        {
+            if (!_condition) {
+                return nullptr;
+            }
+            return WatchCondition<Entries...>{m_inputs, std::move(_condition)};
+        }
+
+    public:
+        explicit WatchHead(const Entries&... _inputs) : m_inputs{_inputs...} {}
+
+        std::function<bool()> operator[](std::function<bool()> _condition) const { return make(std::move(_condition)); }
+        std::function<bool()> operator()(std::function<bool()> _condition) const { return make(std::move(_condition)); }
+    };
+
+    struct WatchOperator {
+        template <typename... T>
+        WatchHead<Blackboard::Entry<T>...> operator()(const Blackboard::Entry<T>&... _inputs) const
+        {
+            return WatchHead<Blackboard::Entry<T>...>{_inputs...};
+        }
+    };
+
+}  // namespace Expr
+
+/*!
+ * @brief Watch(entry1, entry2)[条件]で、読む項目を宣言した条件を作る
+ */
+constexpr Expr::WatchOperator Watch;
+
+}  // namespace TaskManager
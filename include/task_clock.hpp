@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+
+namespace TaskManager
+{
+
+/*!
+ * @brief エンジンが時刻を読む時計
+ * @detail 既定ではstd::chrono::steady_clockをそのまま読む。
+ * VirtualTimeが有る間は仮想の時刻を返し、時刻はadvance()でしか進まない。
+ * 周期をまたいだ時刻で判断する所(Limitの時間の上限)はこれを読む。
+ * 処理にかかった時間を測る所(ループの1周期の時間の上限、Scheduler・Deferrableの予算、Profiler、Sampler、統計の遅れ、評価順の並べ替え、Executorの報告)は、
+ * 仮想の時刻では周期の中で時刻が進まず意味が無いので、steady_clockを読み続ける。
+ *
+ * time_pointはsteady_clockのものなので、steady_clockの時刻・時間とそのまま比べられる。
+ */
+struct Clock {
+    using duration = std::chrono::steady_clock::duration;
+    using rep = duration::rep;
+    using period = duration::period;
+    using time_point = std::chrono::steady_clock::time_point;
+    static constexpr bool is_steady = true;
+
+    static time_point now() noexcept;
+
+    //! @brief 仮想の時刻を使っているか
+    static bool is_virtual() noexcept;
+    //! @brief 仮想の時刻を_durationだけ進める。使っていなければ何もしない
+    static void advance(duration _duration) noexcept;
+};
+
+/*!
+ * @brief 生きている間、Clockを仮想の時刻に切り替える
+ * @detail 始める時刻を渡さなければ、作った時のClock::now()から始める(既に実行中のLimitなどの時刻と辻褄が合うように)。
+ * プロセス全体で1つの時刻を共有する。入れ子にしてもよく、破棄されると作る前の状態(仮想か、仮想ならその時刻)に戻る。
+ */
+class VirtualTime
+{
+private:
+    bool m_previous_virtual;
+    Clock::rep m_previous_now;
+
+public:
+    VirtualTime() noexcept;
+    explicit VirtualTime(Clock::time_point _start) noexcept;
+    ~VirtualTime() noexcept;
+
+    VirtualTime(const VirtualTime&) = delete;
+    VirtualTime& operator=(const VirtualTime&) = delete;
+};
+
+}  // namespace TaskManager
@@ -0,0 +1,408 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
+
+#include "./task_cycle.hpp"
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+
+    /*!
+     * @brief Memoで包んだ部分式の値を1周期の間だけ保持する領域
+     * @detail 同じ形の部分式は、木のどこに書かれていても1つの領域を共有する。
+     * 並列に評価されても値が壊れないよう、値はatomicで持つ。
+     */
+    template <typename T>
+    struct MemoCell {
+        static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>,
+            "Memo can hold only arithmetic or enum values");
+
+        std::atomic<Cycle::epoch_type> epoch{0};
+        std::atomic<T> value{};
+
+        //! @brief この周期でまだ計算していなければ_computeを呼んで値を更新し、値を返す
+        template <typename Compute>
+        T get(Compute&& _compute)
+        {
+            auto now = Cycle::epoch();
+            if (epoch.load(std::memory_order_acquire) != now) {
+                value.store(_compute(), std::memory_order_relaxed);
+                epoch.store(now, std::memory_order_release);
+            }
+            return value.load(std::memory_order_relaxed);
+        }
+
+        //! @brief 次に評価された時に計算し直させる
+        void invalidate() noexcept { epoch.store(0, std::memory_order_release); }
+    };
+
+    /*!
+     * @brief 部分式の識別文字列からMemoCellを探す。無ければ_makeで作って登録する
+     * @detail 木を組み立てる時にだけ呼ばれる。
+     */
+    std::shared_ptr<void> find_memo_cell(const std::string& _key, std::shared_ptr<void> (*_make)());
+
+    //! @brief 同一性を比較できない呼び出し可能オブジェクトに振る通し番号
+    std::uint64_t issue_condition_id() noexcept;
+
+    //! @brief 値のバイト列を識別文字列に付け足す
+    template <typename T>
+    void append_identity(std::string& _key, const T& _value)
+    {
+        _key.append(reinterpret_cast<const char*>(&_value), sizeof(T));
+    }
+
+
+    /*!
+     * @brief 条件式の節を包むクラス
+     * @detail 演算子はこのクラスに対してだけ定義されるので、
+     * Cond(x) > 3 && Flag(estop)のように書くと、型消去無しに1つの関数オブジェクトへ展開される。
+     * std::function<bool()>を受け取る全ての条件欄(If, While, JumpIfなど)へそのまま渡せる。
+     */
+    template <typename Node>
+    class CondExpr
+    {
+    private:
+        Node m_node;
+
+    public:
+        explicit CondExpr(Node _node) noexcept(std::is_nothrow_move_constructible_v<Node>)
+            : m_node{std::move(_node)} {}
+
+        auto operator()() const { return m_node(); }
+
+        const Node& node() const noexcept { return m_node; }
+
+        void identify(std::string& _key) const { m_node.identify(_key); }
+    };
+
+    template <typename T>
+    struct is_cond_expr : std::false_type {
+    };
+    template <typename Node>
+    struct is_cond_expr<CondExpr<Node>> : std::true_type {
+    };
+    template <typename T>
+    constexpr bool is_cond_expr_v = is_cond_expr<std::decay_t<T>>::value;
+
+
+    //! @brief 変数を参照する葉。評価する度に読み直す
+    template <typename T>
+    class CondValue
+    {
+    private:
+        const T* m_ptr;
+
+    public:
+        explicit CondValue(const T& _ref) noexcept : m_ptr{&_ref} {}
+
+        T operator()() const { return *m_ptr; }
+
+        void identify(std::string& _key) const { append_identity(_key, m_ptr); }
+    };
+
+    //! @brief 定数の葉
+    template <typename T>
+    class CondConstant
+    {
+    private:
+        T m_value;
+        std::uint64_t m_id;  //!< バイト列で比べられない型の時だけ使う
+
+    public:
+        explicit CondConstant(T _value)
+            : m_value{std::move(_value)},
+              m_id{std::is_trivially_copyable_v<T> ? 0 : issue_condition_id()} {}
+
+        const T& operator()() const noexcept { return m_value; }
+
+        void identify(std::string& _key) const
+        {
+            if constexpr (std::is_trivially_copyable_v<T>) {
+                append_identity(_key, m_value);
+            } else {
+                append_identity(_key, m_id);
+            }
+        }
+    };
+
+    /*!
+     * @brief 関数を呼ぶ葉
+     * @detail 関数ポインタならそのアドレスで、それ以外なら作られた時の通し番号で見分ける。
+     * コピーは同じ番号を持つので、1度作った式を使い回せば共通部分式として扱われる。
+     */
+    template <typename Func>
+    class CondCall
+    {
+    private:
+        mutable Func m_func;
+        std::uint64_t m_id;
+
+        static constexpr bool is_function_pointer
+            = std::is_pointer_v<Func> && std::is_function_v<std::remove_pointer_t<Func>>;
+
+    public:
+        template <typename F>
+        explicit CondCall(F&& _func)
+            : m_func{std::forward<F>(_func)},
+              m_id{is_function_pointer ? 0 : issue_condition_id()} {}
+
+        auto operator()() const { return m_func(); }
+
+        void identify(std::string& _key) const
+        {
+            if constexpr (is_function_pointer) {
+                append_identity(_key, m_func);
+            } else {
+                append_identity(_key, m_id);
+            }
+        }
+    };
+
+    //! @brief 単項演算の節
+    template <typename Op, typename A>
+    class CondUnary
+    {
+    private:
+        A m_a;
+
+    public:
+        explicit CondUnary(A _a) : m_a{std::move(_a)} {}
+
+        auto operator()() const { return Op{}(m_a()); }
+
+        void identify(std::string& _key) const { m_a.identify(_key); }
+    };
+
+    //! @brief 二項演算の節。両辺を必ず評価する
+    template <typename Op, typename A, typename B>
+    class CondBinary
+    {
+    private:
+        A m_a;
+        B m_b;
+
+    public:
+        CondBinary(A _a, B _b) : m_a{std::move(_a)}, m_b{std::move(_b)} {}
+
+        auto operator()() const { return Op{}(m_a(), m_b()); }
+
+        void identify(std::string& _key) const
+        {
+            m_a.identify(_key);
+            m_b.identify(_key);
+        }
+    };
+
+    //! @brief 論理積・論理和の節。左辺で決まれば右辺は評価しない
+    template <bool IsAnd, typename A, typename B>
+    class CondLogical
+    {
+    private:
+        A m_a;
+        B m_b;
+
+    public:
+        CondLogical(A _a, B _b) : m_a{std::move(_a)}, m_b{std::move(_b)} {}
+
+        bool operator()() const
+        {
+            if constexpr (IsAnd) {
+                return static_cast<bool>(m_a()) && static_cast<bool>(m_b());
+            } else {
+                return static_cast<bool>(m_a()) || static_cast<bool>(m_b());
+            }
+        }
+
+        void identify(std::string& _key) const
+        {
+            m_a.identify(_key);
+            m_b.identify(_key);
+        }
+    };
+
+    /*!
+     * @brief 1周期に1度だけ評価される節
+     * @detail 同じ形の部分式(同じ変数・同じ関数・同じ定数から同じ演算で作られたもの)は、
+     * 木のどこに書かれていても値を共有し、その周期で最初に評価された所でだけ計算される。
+     * 周期の区切りはCycle::epoch()で判断する。
+     * 周期の途中で値が変わり得る式(ループ本体が書き換える変数など)に使ってはいけない。
+     */
+    template <typename E>
+    class CondMemo
+    {
+    public:
+        using value_type = std::decay_t<decltype(std::declval<const E&>()())>;
+
+    private:
+        E m_expr;
+        std::shared_ptr<MemoCell<value_type>> m_cell;
+
+        static std::shared_ptr<void> make_cell() { return std::make_shared<MemoCell<value_type>>(); }
+
+    public:
+        explicit CondMemo(E _expr) : m_expr{std::move(_expr)}
+        {
+            std::string key{typeid(E).name()};
+            key.push_back('\0');
+            m_expr.identify(key);
+            m_cell = std::static_pointer_cast<MemoCell<value_type>>(find_memo_cell(key, &make_cell));
+        }
+
+        value_type operator()() const
+        {
+            return m_cell->get(m_expr);
+        }
+
+        void identify(std::string& _key) const { append_identity(_key, m_cell.get()); }
+    };
+
+
+    //! @brief 演算子の片側に書かれた定数をCondExprにする
+    template <typename T>
+    auto to_cond_expr(T&& _value)
+    {
+        if constexpr (is_cond_expr_v<T>) {
+            return std::forward<T>(_value);
+        } else {
+            return CondExpr<CondConstant<std::decay_t<T>>>{CondConstant<std::decay_t<T>>{std::forward<T>(_value)}};
+        }
+    }
+
+    //! @brief 自分で識別文字列を作れる呼び出し可能オブジェクト(Signalなど)は、そのまま式の節にする
+    template <typename T, typename = void>
+    struct has_identify : std::false_type {
+    };
+    template <typename T>
+    struct has_identify<T, std::void_t<decltype(std::declval<const T&>().identify(std::declval<std::string&>()))>>
+        : std::true_type {
+    };
+
+    template <typename A, typename B>
+    constexpr bool is_cond_operands_v = is_cond_expr_v<A> || is_cond_expr_v<B>;
+
+    template <typename Op, typename A, typename B>
+    auto make_cond_binary(A&& _a, B&& _b)
+    {
+        auto a = to_cond_expr(std::forward<A>(_a));
+        auto b = to_cond_expr(std::forward<B>(_b));
+        using Node = CondBinary<Op, std::decay_t<decltype(a.node())>, std::decay_t<decltype(b.node())>>;
+        return CondExpr<Node>{Node{a.node(), b.node()}};
+    }
+
+// clang-format off
+#define TASK_MANAGER_COND_BINARY_OPERATOR(op, functor)                              \
+    template <typename A, typename B, std::enable_if_t<is_cond_operands_v<A, B>, std::nullptr_t> = nullptr> \
+    auto operator op(A&& _a, B&& _b)                                                \
+    {                                                                               \
+        return make_cond_binary<functor>(std::forward<A>(_a), std::forward<B>(_b)); \
+    }
+
+    TASK_MANAGER_COND_BINARY_OPERATOR(==, std::equal_to<>)
+    TASK_MANAGER_COND_BINARY_OPERATOR(!=, std::not_equal_to<>)
+    TASK_MANAGER_COND_BINARY_OPERATOR(<, std::less<>)
+    TASK_MANAGER_COND_BINARY_OPERATOR(<=, std::less_equal<>)
+    TASK_MANAGER_COND_BINARY_OPERATOR(>, std::greater<>)
+    TASK_MANAGER_COND_BINARY_OPERATOR(>=, std::greater_equal<>)
+    TASK_MANAGER_COND_BINARY_OPERATOR(+, std::plus<>)
+    TASK_MANAGER_COND_BINARY_OPERATOR(-, std::minus<>)
+    TASK_MANAGER_COND_BINARY_OPERATOR(*, std::multiplies<>)
+    TASK_MANAGER_COND_BINARY_OPERATOR(/, std::divides<>)
+    TASK_MANAGER_COND_BINARY_OPERATOR(%, std::modulus<>)
+
+#undef TASK_MANAGER_COND_BINARY_OPERATOR
+    // clang-format on
+
+    /*!
+     * @brief 論理積
+     * @detail 変数の値を作った時点で固定してしまわないよう、両辺ともCondExprに限る。
+     */
+    template <typename A, typename B>
+    auto operator&&(const CondExpr<A>& _a, const CondExpr<B>& _b)
+    {
+        return CondExpr<CondLogical<true, A, B>>{CondLogical<true, A, B>{_a.node(), _b.node()}};
+    }
+    //! @brief 論理和。両辺ともCondExprに限る
+    template <typename A, typename B>
+    auto operator||(const CondExpr<A>& _a, const CondExpr<B>& _b)
+    {
+        return CondExpr<CondLogical<false, A, B>>{CondLogical<false, A, B>{_a.node(), _b.node()}};
+    }
+
+    template <typename A>
+    auto operator!(const CondExpr<A>& _a)
+    {
+        return CondExpr<CondUnary<std::logical_not<>, A>>{CondUnary<std::logical_not<>, A>{_a.node()}};
+    }
+    template <typename A>
+    auto operator-(const CondExpr<A>& _a)
+    {
+        return CondExpr<CondUnary<std::negate<>, A>>{CondUnary<std::negate<>, A>{_a.node()}};
+    }
+
+
+    struct CondOperator {
+        /*!
+         * @brief 条件式の葉を作る
+         * @detail 呼び出し可能なものは評価する度に呼ぶ。
+         * 左辺値の変数は参照を持ち、評価する度に読み直す。
+         * 右辺値は定数として持つ。
+         * 既にCondExprであればそのまま返す。
+         */
+        template <typename T>
+        auto operator()(T&& _value) const
+        {
+            using D = std::decay_t<T>;
+            if constexpr (is_cond_expr_v<T>) {
+                return std::forward<T>(_value);
+            } else if constexpr (has_identify<D>::value && std::is_invocable_v<const D&>) {
+                return CondExpr<D>{std::forward<T>(_value)};
+            } else if constexpr (std::is_invocable_v<D&>) {
+                return CondExpr<CondCall<D>>{CondCall<D>{std::forward<T>(_value)}};
+            } else if constexpr (std::is_lvalue_reference_v<T>) {
+                return CondExpr<CondValue<D>>{CondValue<D>{_value}};
+            } else {
+                return CondExpr<CondConstant<D>>{CondConstant<D>{std::forward<T>(_value)}};
+            }
+        }
+    };
+
+    struct FlagOperator {
+        //! @brief 真偽値の葉を作る。扱いはCondと同じ
+        template <typename T>
+        auto operator()(T&& _value) const
+        {
+            auto expr = CondOperator{}(std::forward<T>(_value));
+            static_assert(std::is_same_v<std::decay_t<decltype(expr())>, bool>, "Flag needs a bool value");
+            return expr;
+        }
+    };
+
+    struct MemoOperator {
+        //! @brief 部分式を1周期に1度だけ評価するようにする
+        template <typename T>
+        auto operator()(T&& _value) const
+        {
+            auto expr = CondOperator{}(std::forward<T>(_value));
+            using Node = CondMemo<std::decay_t<decltype(expr.node())>>;
+            return CondExpr<Node>{Node{expr.node()}};
+        }
+    };
+
+}  // namespace Expr
+
+constexpr Expr::CondOperator Cond;
+constexpr Expr::FlagOperator Flag;
+constexpr Expr::MemoOperator Memo;
+
+}  // namespace TaskManager
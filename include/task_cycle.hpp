@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+
+namespace TaskManager
+{
+
+/*!
+ * @brief 制御周期の番号(エポック)
+ * @detail 条件式の値などを「1周期の間だけ」使い回すための基準となる。
+ * AbstTask::resume()を呼ぶ度に1つ進む。
+ * 複数のタスクを同じ周期の中で順にresume()したい時は、Cycle::Scopeで囲むと、
+ * その間はresume()で進まず、Scopeを作った時に1度だけ進む。
+ */
+namespace Cycle
+{
+    using epoch_type = std::uint64_t;
+
+    //! @brief 現在の周期の番号
+    epoch_type epoch() noexcept;
+
+    //! @brief 周期を1つ進める
+    void advance() noexcept;
+    /*!
+     * @brief 周期を_count進める
+     * @detail 何もしない周期をまとめて飛ばす時に使う(Simulation::Runner)。
+     */
+    void advance(epoch_type _count) noexcept;
+
+    //! @brief Scopeの外で呼ばれたら周期を1つ進める(AbstTask::resume()から呼ばれる)
+    void advance_unless_scoped() noexcept;
+
+    /*!
+     * @brief 制御周期の周波数[Hz]を設定する(既定は1000Hz)
+     * @detail AtRateが周波数を周期数に換算する時に使う。タスクの実行を速めたり遅めたりはしない。
+     */
+    void set_frequency(double _hz) noexcept;
+    double frequency() noexcept;
+
+    /*!
+     * @brief 複数のタスクのresume()を1つの周期としてまとめる
+     * @detail 生成時に周期を1つ進め、破棄されるまではresume()による更新を止める。
+     * 入れ子にした場合は、一番外側だけが周期を進める。
+     */
+    class Scope
+    {
+    public:
+        Scope() noexcept;
+        ~Scope() noexcept;
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+}  // namespace Cycle
+
+}  // namespace TaskManager
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+#include "./abst_task.hpp"
+#include "./task_scheduler.hpp"
+#include "./task_set.hpp"
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+
+    //! @brief Deferrableが後回しにされた回数など。コピーしたDeferrable間で共有する
+    struct DeferStatistics {
+        std::atomic<std::size_t> evaluated{0};  //!< 実行した周期の数
+        std::atomic<std::size_t> deferred{0};   //!< 後回しにした周期の数
+        std::atomic<std::size_t> forced{0};     //!< 飢餓防止で予算を無視して実行した周期の数
+    };
+
+    /*!
+     * @brief Schedulerの予算が足りない周期には実行を後回しにされるブロック
+     * @detail 後回しにされた周期は何もせず、未完了として次の周期に持ち越す。
+     * 実行時間の見込みは、前回までに実行した時間の移動平均。
+     * Schedulerの外で実行された時は、常に実行する。
+     */
+    class Deferrable : public AbstTask
+    {
+    private:
+        TaskSet m_taskset;
+        int m_priority;
+
+        Scheduler::clock::duration m_estimate{};
+        std::size_t m_streak{0};  //!< 続けて後回しにされた回数
+
+        std::shared_ptr<DeferStatistics> m_statistics;
+
+    public:
+        Deferrable(int _priority, TaskSet&&);
+
+        virtual ~Deferrable() noexcept {}
+
+        Deferrable(const Deferrable&);
+        Deferrable& operator=(const Deferrable&) &;
+        Deferrable(Deferrable&&) noexcept;
+        Deferrable& operator=(Deferrable&&) & noexcept;
+
+        std::shared_ptr<const DeferStatistics> statistics() const noexcept { return m_statistics; }
+
+    protected:
+        void init() override;
+        NextTask eval() override;
+        void interrupt() override;
+
+        void for_each_child(const std::function<void(AbstTask&)>&) override;
+    };
+
+
+    class DeferrableHead
+    {
+    private:
+        int m_priority;
+
+    public:
+        explicit DeferrableHead(int _priority) noexcept : m_priority{_priority} {}
+
+        template <typename... TaskClasses>
+        Deferrable operator()(TaskClasses&&... tasks) const
+        {
+            return Deferrable{m_priority, TaskSet{std::forward<TaskClasses>(tasks)...}};
+        }
+    };
+
+    struct DeferrableOperator {
+        //! @brief 優先度を指定する。値が大きいほど後回しにされにくい
+        DeferrableHead operator[](int _priority) const noexcept { return DeferrableHead{_priority}; }
+        DeferrableHead operator()(int _priority) const noexcept { return DeferrableHead{_priority}; }
+    };
+
+}  // namespace Expr
+
+constexpr Expr::DeferrableOperator Deferrable;
+
+}  // namespace TaskManager
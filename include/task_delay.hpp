@@ -24,6 +24,12 @@ public:
 protected:
     void init() noexcept override;
     NextTask eval() noexcept override;
+
+    //! @brief 残りの周期数
+    std::uint64_t waiting_cycles() noexcept override;
+    void skip_waiting(std::uint64_t _cycles) noexcept override;
+
+    std::uint32_t compile(Fleet::Builder&) override;
 };
 
 }  // namespace TaskManager
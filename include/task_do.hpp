@@ -23,30 +23,42 @@ namespace Expr
         DoWhile(DoWhile&&) noexcept(std::is_nothrow_move_constructible<While>::value);
         DoWhile& operator=(DoWhile&&) & noexcept(std::is_nothrow_move_assignable<While>::value);
 
+        IterationAttribute<DoWhile> operator->() const&;
+        IterationAttribute<DoWhile> operator->() && noexcept(std::is_nothrow_move_constructible<While>::value);
+
     protected:
         void init() noexcept override {}
         NextTask eval() override;
+
+        std::uint64_t waiting_cycles() override;
+        std::uint32_t compile(Fleet::Builder&) override;
+
+        Analysis::WorstCase analyze(const Analysis::CostModel&) override;
     };
 
 
+    /*!
+     * @brief Doの返すクラス
+     * @detail Do(...)->While[cond]のように、operator->を通してWhileやUntilを続ける。
+     * 変数に保存して何度でも使えるが、その場合はタスクがコピーされる。
+     * 一時オブジェクトのままoperator->を呼んだ場合は、コピーせずムーブする。
+     */
     class DoTaskSet
     {
     private:
         class WhileClass
         {
         private:
-            std::shared_ptr<TaskSet> m_taskset;
+            TaskSet& m_taskset;
+            bool m_disposable;  //!< trueならm_tasksetをムーブしてよい
 
         public:
-            WhileClass(const std::shared_ptr<TaskSet>&) noexcept;
-            WhileClass(std::shared_ptr<TaskSet>&&) noexcept;
+            WhileClass(TaskSet&, bool _disposable) noexcept;
 
             virtual ~WhileClass() noexcept {}
 
-            WhileClass(const WhileClass&) noexcept = default;
-            WhileClass& operator=(const WhileClass&) & noexcept = default;
-            WhileClass(WhileClass&&) noexcept = default;
-            WhileClass& operator=(WhileClass&&) & noexcept = default;
+            WhileClass(const WhileClass&) = delete;
+            WhileClass& operator=(const WhileClass&) = delete;
 
             DoWhile operator[](const std::function<bool()>&) const;
             DoWhile operator[](std::function<bool()>&&) const;
@@ -57,44 +69,80 @@ namespace Expr
         class UntilClass : public WhileClass
         {
         public:
-            UntilClass(const std::shared_ptr<TaskSet>&) noexcept;
-            UntilClass(std::shared_ptr<TaskSet>&&) noexcept;
+            UntilClass(TaskSet&, bool _disposable) noexcept;
 
             virtual ~UntilClass() noexcept {}
 
-            UntilClass(const UntilClass&) noexcept;
-            UntilClass& operator=(const UntilClass&) & noexcept;
-            UntilClass(UntilClass&&) noexcept;
-            UntilClass& operator=(UntilClass&&) & noexcept;
-
             DoWhile operator[](const std::function<bool()>&) const;
             DoWhile operator[](std::function<bool()>&&) const;
             DoWhile operator()(const std::function<bool()>&) const;
             DoWhile operator()(std::function<bool()>&&) const;
+
+            //! @brief 条件式の否定を式の中で行い、ラムダで包み直さない
+            template <typename Node>
+            DoWhile operator[](const CondExpr<Node>& _expr) const
+            {
+                return WhileClass::operator[](std::function<bool()>{!_expr});
+            }
+            template <typename Node>
+            DoWhile operator()(const CondExpr<Node>& _expr) const
+            {
+                return WhileClass::operator()(std::function<bool()>{!_expr});
+            }
         };
 
+        /*!
+         * @brief 一時オブジェクトのDoTaskSetからoperator->で得られるクラス
+         * @detail タスクを自分で持ち、WhileやUntilへムーブして渡す。
+         * コピー・ムーブはできない。
+         */
+        class DoChain
+        {
+        private:
+            TaskSet m_taskset;
+
+        public:
+            const WhileClass While{m_taskset, true};
+            const UntilClass Until{m_taskset, true};
+
+        public:
+            explicit DoChain(TaskSet&&) noexcept;
+
+            virtual ~DoChain() noexcept {}
+
+            DoChain(const DoChain&) = delete;
+            DoChain& operator=(const DoChain&) = delete;
+
+            DoChain* operator->() noexcept { return this; }
+        };
+
+    private:
+        TaskSet m_taskset;
+
     public:
-        const WhileClass While;
-        const UntilClass Until;
+        const WhileClass While{m_taskset, false};
+        const UntilClass Until{m_taskset, false};
 
     public:
-        DoTaskSet(const std::shared_ptr<TaskSet>&) noexcept;
-        DoTaskSet(std::shared_ptr<TaskSet>&&) noexcept;
+        explicit DoTaskSet(TaskSet&&) noexcept;
 
         virtual ~DoTaskSet() noexcept {}
 
-        DoTaskSet(const DoTaskSet&) noexcept = default;
-        DoTaskSet& operator=(const DoTaskSet&) & noexcept = default;
-        DoTaskSet(DoTaskSet&&) noexcept = default;
-        DoTaskSet& operator=(DoTaskSet&&) & noexcept = default;
+        DoTaskSet(const DoTaskSet&);
+        DoTaskSet& operator=(const DoTaskSet&) &;
+        DoTaskSet(DoTaskSet&&) noexcept;
+        DoTaskSet& operator=(DoTaskSet&&) & noexcept;
+
+        const DoTaskSet* operator->() const& noexcept { return this; }
+        DoChain operator->() && noexcept;
     };
 
 
     struct DoOperator {
         template <typename... TaskClasses>
-        std::shared_ptr<DoTaskSet> operator()(TaskClasses&&... tasks) const
+        DoTaskSet operator()(TaskClasses&&... tasks) const
         {
-            return std::make_shared<DoTaskSet>(std::make_shared<TaskSet>(std::forward<TaskClasses>(tasks)...));
+            return DoTaskSet{TaskSet{std::forward<TaskClasses>(tasks)...}};
         }
     };
 
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "./abst_task.hpp"
+
+namespace TaskManager
+{
+
+/*!
+ * @brief 多数の根タスクを複数のワーカースレッドで並列にresume()するクラス
+ * @detail 根タスクはワーカーごとの担当(シャード)に振り分けられる。
+ * cycle()を呼ぶと、全ワーカーが一斉に自分の担当をresume()し、全員が終わるまで待つ(周期末の同期)。
+ * 自分の担当を終えたワーカーは、他のワーカーのまだ手を付けていない根を盗んで実行する。
+ * 周期の間に盗まれた数に応じて、次の周期から担当を付け替える。
+ *
+ * 1つのcycle()は1つの制御周期(Cycle::epoch())として扱われる。
+ * 別々の根が同じ変数を書き換えたり、ジャンプを含む同じTaskSetのコピーを別々の根にしたりすると、並列に触られる。
+ * add()とcycle()は同じスレッドから呼ぶ。
+ */
+class Executor
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    //! @brief ワーカー1つ分の負荷の報告
+    struct WorkerReport {
+        int cpu = -1;                    //!< 固定したCPU番号(固定できなければ-1)
+        std::size_t roots = 0;           //!< 担当している根の数
+        std::size_t executed = 0;        //!< 直前の周期で実行した根の数(盗んだ分を含む)
+        std::size_t stolen = 0;          //!< 直前の周期で他の担当から盗んで実行した数
+        clock::duration busy{};          //!< 直前の周期で根の実行に使った時間
+        clock::duration barrier_wait{};  //!< 直前の周期で、自分の仕事を終えてから周期末まで待った時間
+        clock::duration total_busy{};
+        clock::duration total_barrier_wait{};
+    };
+
+private:
+    //! @brief 根同士が同じキャッシュラインに乗らないようにする入れ物
+    template <typename T>
+    struct alignas(64) Padded {
+        T task;
+
+        template <typename U>
+        explicit Padded(U&& _task) : task{std::forward<U>(_task)} {}
+    };
+
+    struct alignas(64) Shard {
+        std::vector<std::shared_ptr<Expr::AbstTask>> roots;
+        std::atomic<std::size_t> cursor{0};       //!< 次に実行する根の番号。盗む側もここから取る
+        std::atomic<std::size_t> stolen_from{0};  //!< この周期に他のワーカーに盗まれた数
+
+        WorkerReport report;
+        clock::time_point finish{};
+    };
+
+    std::vector<std::unique_ptr<Shard>> m_shard_list;
+    std::vector<std::thread> m_thread_list;
+
+    std::mutex m_mutex;
+    std::condition_variable m_start_cv;
+    std::condition_variable m_done_cv;
+    std::uint64_t m_generation = 0;
+    std::size_t m_remaining = 0;
+    bool m_quit = false;
+    std::exception_ptr m_error{nullptr};
+
+    clock::duration m_last_cycle{};
+
+    void work(std::size_t _index, int _cpu);
+    void run_shard(std::size_t _index);
+    void resume_root(Expr::AbstTask&);
+    void rebalance();
+
+public:
+    /*!
+     * @param _workers ワーカースレッドの数(0なら1)
+     * @param _cpus ワーカーを固定するCPU番号。i番目のワーカーは_cpus[i % size]に固定する。
+     * 空なら0番から順に固定する。固定できない環境では固定せずに動く。
+     */
+    explicit Executor(std::size_t _workers, std::vector<int> _cpus = {});
+
+    virtual ~Executor() noexcept;
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    /*!
+     * @brief 根タスクを加える
+     * @detail TaskSetと同じく、渡したタスクはコピー(ムーブ)される。
+     * 加えた時にstart()され、担当の最も少ないワーカーに振り分けられる。
+     * @return 実際に実行されるタスク
+     */
+    template <typename TaskClass>
+    std::shared_ptr<std::decay_t<TaskClass>> add(TaskClass&& _task)
+    {
+        using Task = std::decay_t<TaskClass>;
+        static_assert(std::is_base_of_v<Expr::AbstTask, Task>, "Executor runs only tasks");
+
+        auto holder = std::make_shared<Padded<Task>>(std::forward<TaskClass>(_task));
+        std::shared_ptr<Task> task{holder, &holder->task};
+        add_root(task);
+        return task;
+    }
+    //! @brief 既に作られた根タスクをそのまま加える
+    void add_root(const std::shared_ptr<Expr::AbstTask>&);
+
+    /*!
+     * @brief 1制御周期分、全ての根をresume()する
+     * @detail 全ワーカーが終わるまで戻らない。根の中で投げられた例外は、最初の1つをここで投げ直す。
+     */
+    void cycle();
+
+    //! @brief まだ実行中の根が有るか
+    bool running() const noexcept;
+
+    std::size_t workers() const noexcept { return m_shard_list.size(); }
+
+    //! @brief ワーカーごとの負荷(直前の周期と累計)
+    std::vector<WorkerReport> report() const;
+
+    //! @brief 直前の周期にかかった時間
+    clock::duration last_cycle() const noexcept { return m_last_cycle; }
+};
+
+}  // namespace TaskManager
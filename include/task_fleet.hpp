@@ -0,0 +1,294 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "./task_cycle.hpp"
+#include "./task_while.hpp"
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+    class AbstTask;
+}
+
+/*!
+ * @brief 同じ木を非常に多く(百万程度)並べて、1つのプロセスで周期を揃えて実行する
+ * @detail 木の形・関数オブジェクト・パラメータなど変わらない部分は、Programに1度だけ写して全ての実体で共有する。
+ * 実体ごとに持つのは、実行中の位置などの状態の語(節点1つにつき多くて32bit)だけ。
+ * AbstTaskの実体を丸ごとコピーする場合に比べ、実体1つ当たりの大きさが桁違いに小さい。
+ *
+ * 関数オブジェクトは全ての実体で共有されるので、実体ごとのデータはFleet::current()の番号で引く。
+ * 対応するのはTaskSet, Task(関数の葉), Delay, While(Wait), DoWhile, If, Switch, Every(AtRate)。
+ * ジャンプ・シーン・Limit・利用者のタスクなどを含む木は、compile()がUnsupportedを投げる。
+ * 記録と再生(Replay)・Observer・Profilerは通さない。
+ *
+ * 実体を1つずつ評価するPopulationと、同じ節点に居る実体をまとめて評価するLockstepの2通りの実行方法が有る。
+ */
+namespace Fleet
+{
+    using instance_id = std::uint32_t;
+
+    //! @brief 評価中の実体の番号。評価の外では0
+    instance_id current() noexcept;
+
+    //! @brief Programに写せない節点を含む木
+    class Unsupported : public std::invalid_argument
+    {
+    public:
+        using std::invalid_argument::invalid_argument;
+    };
+
+    /*!
+     * @brief 実体の番号の並びをまとめて判定する条件(または真偽を返す葉)
+     * @detail std::function<bool()>を受け取る欄(If, While, Wait, 関数の葉など)へそのまま渡せる。
+     * Lockstepは同じ節点で判定する実体の番号をまとめて渡すので、実体ごとのデータを配列で持っていれば、1回の呼び出しで判定できる。
+     * それ以外(AbstTaskの木やPopulation)では、current()の1つだけを渡して呼ぶ。
+     */
+    class Batch
+    {
+    public:
+        //! @brief _ids[i]の結果を_results[i]に書く
+        using function_type = std::function<void(const instance_id* _ids, std::size_t _count, bool* _results)>;
+
+    private:
+        function_type m_function;
+
+    public:
+        explicit Batch(function_type _function) noexcept : m_function{std::move(_function)} {}
+
+        bool operator()() const;
+        void operator()(const instance_id* _ids, std::size_t _count, bool* _results) const { m_function(_ids, _count, _results); }
+    };
+
+    //! @brief 節点の種類
+    enum class Op : std::uint8_t {
+        Sequence,  //!< TaskSet
+        Leaf,      //!< Task
+        Delay,
+        While,
+        DoWhile,
+        If,
+        Switch,
+        Every,
+        count_
+    };
+    const char* op_name(Op) noexcept;
+
+    /*!
+     * @brief 木の変わらない部分
+     * @detail 節点は配列に並べ、子は番号で指す。状態を持つ節点には、実体ごとの状態の語の位置(slot)を割り当てる。
+     * 構築後は変更しないので、複数のPopulationやスレッドから共有してよい(関数オブジェクトが許せば)。
+     */
+    class Program
+    {
+    public:
+        static constexpr std::uint32_t npos = static_cast<std::uint32_t>(-1);
+
+        struct Node {
+            Op op = Op::Leaf;
+            std::uint32_t slot = npos;         //!< 状態の語の位置(状態が無ければnpos)
+            std::uint32_t first_child = 0;     //!< m_child_listの中の位置
+            std::uint32_t child_count = 0;
+            std::uint32_t function = npos;     //!< 葉・ループの条件・Ifの最初の条件の、m_function_listの中の位置。Switchならm_switch_listの中の位置
+            std::int64_t parameter = 0;        //!< Delayの周期数、Everyの周期数
+            std::int64_t phase = 0;            //!< Everyの位相
+            Expr::IterationPolicy policy;      //!< ループの1周期の周回数
+        };
+
+        //! @brief Switchのキーと、キーからcaseの番号への表
+        struct SwitchTable {
+            std::function<std::int64_t()> key;
+            std::vector<std::pair<std::int64_t, std::uint32_t>> cases;  //!< キーの順に並べる
+            std::uint32_t default_case = npos;
+
+            std::uint32_t find(std::int64_t _key) const noexcept;
+        };
+
+    private:
+        std::vector<Node> m_node_list;
+        std::vector<std::uint32_t> m_child_list;
+        std::vector<std::function<bool()>> m_function_list;
+        std::vector<Batch::function_type> m_batch_list;  //!< m_function_listと同じ位置に、Batchならその中身を持つ
+        std::vector<SwitchTable> m_switch_list;
+        std::uint32_t m_slot_count{0};
+
+        friend class Builder;
+
+    public:
+        /*!
+         * @brief _rootの木を写す
+         * @detail 木は実行していないものを渡す(実行中の状態は写さない)。写せない節点が有ればUnsupported。
+         */
+        static std::shared_ptr<const Program> compile(Expr::AbstTask& _root);
+
+        //! @brief 根は0番
+        const Node& node(std::uint32_t _index) const noexcept { return m_node_list[_index]; }
+        std::uint32_t child(const Node& _node, std::uint32_t _index) const noexcept { return m_child_list[_node.first_child + _index]; }
+        const std::function<bool()>& function(std::uint32_t _index) const noexcept { return m_function_list[_index]; }
+        //! @brief _index番目の関数がBatchなら、まとめて呼ぶ関数。そうでなければ空
+        const Batch::function_type& batch(std::uint32_t _index) const noexcept { return m_batch_list[_index]; }
+        const SwitchTable& switch_table(std::uint32_t _index) const noexcept { return m_switch_list[_index]; }
+
+        std::size_t size() const noexcept { return m_node_list.size(); }
+        //! @brief 実体1つ当たりの状態の語の数
+        std::uint32_t slot_count() const noexcept { return m_slot_count; }
+        //! @brief 共有している部分の大きさの概算[byte](関数オブジェクトが外に持つ物は数えない)
+        std::size_t shared_bytes() const noexcept;
+        //! @brief 木に含まれる種類ごとの節点の数
+        std::vector<std::size_t> op_count() const;
+    };
+
+    /*!
+     * @brief Programを組み立てる
+     * @detail 各節点のクラスのAbstTask::compile()から呼ばれる。子は add() で写して番号を受け取る。
+     */
+    class Builder
+    {
+    private:
+        Program& m_program;
+
+    public:
+        explicit Builder(Program& _program) noexcept : m_program{_program} {}
+
+        //! @brief _taskを写し、節点の番号を返す
+        std::uint32_t add(Expr::AbstTask& _task);
+
+        //! @brief 節点を1つ作る。_statefulなら状態の語を割り当てる
+        std::uint32_t open(Op _op, bool _stateful);
+        Program::Node& node(std::uint32_t _index) noexcept { return m_program.m_node_list[_index]; }
+        //! @brief 子の番号を並べる(子を全て写してから呼ぶ)
+        void set_children(std::uint32_t _index, const std::vector<std::uint32_t>& _children);
+        std::uint32_t function(std::function<bool()> _function);
+        std::uint32_t switch_table(Program::SwitchTable _table);
+
+        //! @brief 写せない節点
+        [[noreturn]] void unsupported(const Expr::AbstTask& _task) const;
+    };
+
+    /*!
+     * @brief 1つのProgramを共有する実体の群れ
+     * @detail 状態の語は実体ごとに並べて持つ。step()で周期を1つ進め、実行中の全ての実体を番号の順に評価する。
+     * 実体ごとの振る舞いはAbstTaskの木と同じ(init・evalを呼ぶ順、ループの周回数、Everyの番など)。
+     * 1つのスレッドから使う。
+     */
+    class Population
+    {
+    private:
+        std::shared_ptr<const Program> m_program;
+        std::size_t m_size;
+        std::uint32_t m_slot_count;
+        std::vector<std::uint32_t> m_state;   //!< 実体ごとのslot_count語(0は実行していない)
+        std::vector<std::uint8_t> m_running;  //!< 実体ごとの実行中の印
+        std::size_t m_running_count{0};
+        Cycle::epoch_type m_epoch{0};  //!< 評価中の周期の番号(start()の時のCycle::epoch()から、step()ごとに1つ進める)
+
+        //! @brief AbstTask::evaluate_task()と同じく、必要ならinitしてからevalし、終わったら状態を0に戻す
+        bool evaluate(std::uint32_t _index, std::uint32_t* _state);
+        void init(const Program::Node& _node, std::uint32_t* _state);
+        bool eval(const Program::Node& _node, std::uint32_t* _state);
+        //! @brief While::iterate()と同じ
+        bool iterate(const Program::Node& _node, std::uint32_t* _state);
+
+    public:
+        Population(std::shared_ptr<const Program> _program, std::size_t _size);
+
+        Population(const Population&) = delete;
+        Population& operator=(const Population&) = delete;
+
+        //! @brief 全ての実体を実行中にする(実行中のものは始めからやり直す)
+        void start() noexcept;
+        //! @brief 周期を1つ進め、実行中の全ての実体を評価する
+        void step();
+
+        std::size_t size() const noexcept { return m_size; }
+        bool running(std::size_t _index) const noexcept { return m_running[_index] != 0; }
+        std::size_t running_count() const noexcept { return m_running_count; }
+
+        const Program& program() const noexcept { return *m_program; }
+        //! @brief 実体1つ当たりの大きさ[byte](共有している部分を除く)
+        std::size_t bytes_per_instance() const noexcept { return m_slot_count * sizeof(std::uint32_t) + sizeof(std::uint8_t); }
+    };
+
+    /*!
+     * @brief 1つのProgramを共有する実体の群れを、同じ節点に居るものごとにまとめて評価する
+     * @detail 状態の語は節点ごとに全ての実体の分を並べて持つ(TaskSetの位置、Delayの周期数、ループの印がそれぞれ1本の配列になる)。
+     * 節点は、その周期にそこへ来た実体の番号の並びをまとめて受け取り、位置ごとに分けて子へ渡す。
+     * Delayの数え上げやEveryの番の判定は並び全体に対して1度に行い、Batchの条件は並びごとに1回だけ呼ぶ。
+     *
+     * 実体ごとの振る舞い(init・evalを呼ぶ順、ループの周回数、Everyの番など)はPopulationと同じだが、
+     * 実体をまたいだ呼び出しの順は異なる(同じ節点の関数を全ての実体で呼んでから次へ進む)。関数は自分の実体のデータだけを触ること。
+     * 時間で区切るループ(PerCycle(500us)など)は、周回の時間を実体ごとに測るため1つずつ回す。
+     * 1つのスレッドから使う。
+     */
+    class Lockstep
+    {
+    private:
+        std::shared_ptr<const Program> m_program;
+        std::size_t m_size;
+        std::vector<std::uint32_t> m_state;        //!< slot番目の語がslot * size()から実体の数だけ並ぶ(0は実行していない)
+        std::vector<std::uint8_t> m_running;       //!< 実体ごとの実行中の印
+        std::vector<instance_id> m_active;         //!< 実行中の実体の番号(周期の始めには番号の順)
+        std::vector<instance_id> m_scratch;        //!< 並べ替えや、initが要る実体を集めるのに使う一時領域
+        std::unique_ptr<bool[]> m_result;          //!< 条件の結果を受け取る一時領域
+        std::vector<std::uint32_t> m_bucket;       //!< 位置ごとの数を数える一時領域
+        Cycle::epoch_type m_epoch{0};  //!< 評価中の周期の番号(start()の時のCycle::epoch()から、step()ごとに1つ進める)
+        bool m_reordered{false};       //!< この周期にm_activeの順を入れ替えたか
+
+        std::uint32_t* state(const Program::Node& _node) noexcept { return m_state.data() + _node.slot * m_size; }
+
+        /*!
+         * @brief _ids[0, _count)の実体について_indexの節点を評価する
+         * @detail 終わらなかった実体を前に、終わった実体を後ろに並べ替え、終わった数を返す。終わった実体の状態は0に戻す。
+         */
+        std::size_t evaluate(std::uint32_t _index, instance_id* _ids, std::size_t _count);
+        /*!
+         * @brief 条件で状態を決める節点(While, If, Switch)のinit。_idsはinitが要る実体だけを集めたもの(並びは書き換える)
+         * @detail 他の節点のinitは、eval()の中で状態の語を数える時に一緒に行う。
+         */
+        void init(const Program::Node& _node, instance_id* _ids, std::size_t _count);
+        std::size_t eval(const Program::Node& _node, instance_id* _ids, std::size_t _count);
+        std::size_t iterate(const Program::Node& _node, instance_id* _ids, std::size_t _count);
+        //! @brief 節を選ぶ節点(If, Switch)。選んだ節ごとに分けて評価する
+        std::size_t select(const Program::Node& _node, instance_id* _ids, std::size_t _count);
+
+        //! @brief _function番目の関数を_ids[0, _count)について呼び、結果をm_resultに書く
+        void call(std::uint32_t _function, const instance_id* _ids, std::size_t _count);
+        //! @brief m_resultが_valueの実体を、順を保って後ろへ寄せ、その数を返す
+        std::size_t partition(instance_id* _ids, std::size_t _count, bool _value);
+        //! @brief 状態の語(1から_key_countまで)の小さい順に、順を保って並べ替える
+        void group(instance_id* _ids, std::size_t _count, const std::uint32_t* _state, std::uint32_t _key_count);
+
+    public:
+        Lockstep(std::shared_ptr<const Program> _program, std::size_t _size);
+
+        Lockstep(const Lockstep&) = delete;
+        Lockstep& operator=(const Lockstep&) = delete;
+
+        //! @brief 全ての実体を実行中にする(実行中のものは始めからやり直す)
+        void start();
+        //! @brief 周期を1つ進め、実行中の全ての実体を評価する
+        void step();
+
+        std::size_t size() const noexcept { return m_size; }
+        bool running(std::size_t _index) const noexcept { return m_running[_index] != 0; }
+        std::size_t running_count() const noexcept { return m_active.size(); }
+
+        const Program& program() const noexcept { return *m_program; }
+        //! @brief 実体1つ当たりの大きさ[byte](共有している部分を除き、一時領域を含む)
+        std::size_t bytes_per_instance() const noexcept
+        {
+            return m_program->slot_count() * sizeof(std::uint32_t) + sizeof(std::uint8_t) + 2 * sizeof(instance_id) + sizeof(bool);
+        }
+    };
+
+}  // namespace Fleet
+
+}  // namespace TaskManager
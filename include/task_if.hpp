@@ -1,6 +1,7 @@
 #pragma once
 
 #include "./abst_task.hpp"
+#include "./task_adaptive.hpp"
 #include "./task_set.hpp"
 
 namespace TaskManager
@@ -30,10 +31,18 @@ namespace Expr
     protected:
         condition_list_type m_condition_list;               //!< 条件やタスクを格納する
         std::shared_ptr<TaskSet> m_selected_task{nullptr};  //!< 条件分岐の結果、実際に実行されるタスクを格納する。
+        bool m_exclusive;                                   //!< 条件が互いに排他か(ExclusiveIf)
+        std::optional<AdaptiveOrder> m_adaptive_order;      //!< 排他な場合の、条件の評価順
+
+    public:
+        IfElse(const condition_list_type&, bool _exclusive = false);
+        IfElse(condition_list_type&&, bool _exclusive = false);
+
+    protected:
+        //! @brief If用。_has_elseがfalseなら、最後の要素もElse節ではなく条件分岐とみなす
+        IfElse(condition_list_type&&, bool _exclusive, bool _has_else);
 
     public:
-        IfElse(const condition_list_type&);
-        IfElse(condition_list_type&&) noexcept;
 
         virtual ~IfElse() noexcept {}
 
@@ -42,10 +51,18 @@ namespace Expr
         IfElse(IfElse&&) noexcept;
         IfElse& operator=(IfElse&&) & noexcept;
 
+        /*!
+         * @brief ExclusiveIfの条件の評価の統計
+         * @detail コピーしたもの同士で共有されるので、TaskSetに入れる前に取り出しておけばよい。
+         * ExclusiveIfでなければnullptr。
+         */
+        std::shared_ptr<ConditionStatistics> statistics() const noexcept;
+
     protected:
         /*!
          * @brief 条件分岐を行う
          * @detail 条件分岐の結果、実際に実行されることが決まったタスクはm_selected_taskに格納する
+         * ExclusiveIfでは、当たりやすく軽い条件から評価する。Else節は常に最後。
          */
         void init() override;
         /*!
@@ -56,6 +73,15 @@ namespace Expr
         NextTask eval() override;
 
         void interrupt() override;
+
+        void for_each_child(const std::function<void(AbstTask&)>&) override;
+        //! @brief 選ばれた節に任せる
+        std::uint64_t waiting_cycles() override;
+        void skip_waiting(std::uint64_t) override;
+        //! @brief 排他でも、条件は書いた順に判定する節点として写す
+        std::uint32_t compile(Fleet::Builder&) override;
+        //! @brief 排他なら全ての条件を評価してどれか1つの節、そうでなければi番目までの条件を評価してi番目の節
+        Analysis::WorstCase analyze(const Analysis::CostModel&) override;
     };
 
 
@@ -64,44 +90,50 @@ namespace Expr
      */
     class If : public IfElse
     {
-        class IfFunction
+        class ElseIfCondition
         {
-            class ElseIfClass
-            {
-                class ElseIfCondition
-                {
-                private:
-                    condition_list_type m_condition_list;
-                    std::function<bool()> m_condition;
+        private:
+            condition_list_type m_condition_list;
+            std::function<bool()> m_condition;
+            bool m_exclusive;
 
-                public:
-                    ElseIfCondition(const condition_list_type&, const std::function<bool()>&) noexcept;
-                    ElseIfCondition(const condition_list_type&, std::function<bool()>&&) noexcept;
+        public:
+            ElseIfCondition(condition_list_type&&, const std::function<bool()>&, bool _exclusive) noexcept;
+            ElseIfCondition(condition_list_type&&, std::function<bool()>&&, bool _exclusive) noexcept;
 
-                    virtual ~ElseIfCondition() noexcept {}
+            virtual ~ElseIfCondition() noexcept {}
 
-                    ElseIfCondition(const ElseIfCondition&) = default;
-                    ElseIfCondition& operator=(const ElseIfCondition&) & = default;
-                    ElseIfCondition(ElseIfCondition&&) noexcept = default;
-                    ElseIfCondition& operator=(ElseIfCondition&&) & noexcept = default;
+            ElseIfCondition(const ElseIfCondition&) = default;
+            ElseIfCondition& operator=(const ElseIfCondition&) & = default;
+            ElseIfCondition(ElseIfCondition&&) noexcept = default;
+            ElseIfCondition& operator=(ElseIfCondition&&) & noexcept = default;
 
-                    template <typename... TaskClasses>
-                    If operator()(TaskClasses&&... tasks) const&;
-                    template <typename... TaskClasses>
-                    If operator()(TaskClasses&&... tasks) &&;
-                };
+            template <typename... TaskClasses>
+            If operator()(TaskClasses&&... tasks) const&;
+            template <typename... TaskClasses>
+            If operator()(TaskClasses&&... tasks) &&;
+        };
 
-                std::shared_ptr<condition_list_type> m_cond_list_ptr;
+        /*!
+         * @brief operator->の返す、ElseIfやElseを続けるためのクラス
+         * @detail ヒープを使わず値で返され、operator->は自分自身を指す。
+         * 条件のリストを自分で持ち、続くElseIfやElseへはコピーせずムーブで渡す。
+         * その為、DSLの中で一時オブジェクトとして1度だけ使われることを前提とする。
+         * コピー・ムーブはできない。
+         */
+        class IfFunction
+        {
+            class ElseIfClass
+            {
+                IfFunction& m_function;
 
             public:
-                ElseIfClass(const std::shared_ptr<condition_list_type>& _ptr) noexcept : m_cond_list_ptr{_ptr} {}
+                explicit ElseIfClass(IfFunction& _function) noexcept : m_function{_function} {}
 
                 virtual ~ElseIfClass() noexcept {}
 
-                ElseIfClass(const ElseIfClass&) noexcept = default;
-                ElseIfClass& operator=(const ElseIfClass&) & noexcept = default;
-                ElseIfClass(ElseIfClass&&) noexcept = default;
-                ElseIfClass& operator=(ElseIfClass&&) & noexcept = default;
+                ElseIfClass(const ElseIfClass&) = delete;
+                ElseIfClass& operator=(const ElseIfClass&) = delete;
 
                 ElseIfCondition operator[](const std::function<bool()>&) const noexcept;
                 ElseIfCondition operator[](std::function<bool()>&&) const noexcept;
@@ -111,29 +143,30 @@ namespace Expr
             };
 
         private:
-            std::shared_ptr<condition_list_type> m_cond_list_ptr;
+            condition_list_type m_cond_list;
+            bool m_exclusive;
 
         public:
-            const ElseIfClass ElseIf;
+            const ElseIfClass ElseIf{*this};
 
         public:
-            IfFunction(const condition_list_type&);
-            IfFunction(condition_list_type&&) noexcept;
+            IfFunction(const condition_list_type&, bool _exclusive);
+            IfFunction(condition_list_type&&, bool _exclusive) noexcept;
 
             virtual ~IfFunction() noexcept {}
 
-            IfFunction(const IfFunction&) noexcept = default;
-            IfFunction& operator=(const IfFunction&) & noexcept = default;
-            IfFunction(IfFunction&&) noexcept = default;
-            IfFunction& operator=(IfFunction&&) & noexcept = default;
+            IfFunction(const IfFunction&) = delete;
+            IfFunction& operator=(const IfFunction&) = delete;
+
+            IfFunction* operator->() noexcept { return this; }
 
             template <typename... TaskClasses>
             IfElse Else(TaskClasses&&...);
         };
 
     public:
-        If(const condition_list_type& _cond_list) : IfElse{_cond_list} {}
-        If(condition_list_type&& _cond_list) noexcept : IfElse{std::move(_cond_list)} {}
+        If(const condition_list_type& _cond_list, bool _exclusive = false) : IfElse{condition_list_type{_cond_list}, _exclusive, false} {}
+        If(condition_list_type&& _cond_list, bool _exclusive = false) : IfElse{std::move(_cond_list), _exclusive, false} {}
 
         virtual ~If() noexcept {}
 
@@ -142,18 +175,19 @@ namespace Expr
         If(If&& _other) noexcept : IfElse{std::move(_other)} {}
         If& operator=(If&&) & noexcept;
 
-        std::shared_ptr<IfFunction> operator->() const&;
-        std::shared_ptr<IfFunction> operator->() && noexcept;
+        IfFunction operator->() const&;
+        IfFunction operator->() && noexcept;
     };
 
 
     struct IfCondition {
     private:
         std::function<bool()> m_condition;
+        bool m_exclusive;
 
     public:
-        IfCondition(const std::function<bool()>&) noexcept;
-        IfCondition(std::function<bool()>&&) noexcept;
+        IfCondition(const std::function<bool()>&, bool _exclusive = false) noexcept;
+        IfCondition(std::function<bool()>&&, bool _exclusive = false) noexcept;
 
         virtual ~IfCondition() noexcept {}
 
@@ -177,55 +211,71 @@ namespace Expr
     };
 
 
+    /*!
+     * @brief 互いに排他な条件を並べるIf文
+     * @detail 使い方はIfと同じだが、どの2つの条件も同時には真にならないと宣言する。
+     * 排他なら評価順は結果に影響しないので、当たりやすく軽い条件から評価するよう、実行中に並べ替える。
+     * 並べ替えの統計はstatistics()で得られ、ConditionStatistics::freezeで順番を固定できる。
+     */
+    struct ExclusiveIfOperator {
+        IfCondition operator[](const std::function<bool()>&) const& noexcept;
+        IfCondition operator[](std::function<bool()>&&) const& noexcept;
+        IfCondition operator()(const std::function<bool()>&) const& noexcept;
+        IfCondition operator()(std::function<bool()>&&) const& noexcept;
+    };
+
+
     template <typename... TaskClasses>
     IfElse If::IfFunction::Else(TaskClasses&&... tasks)
     {
-        condition_list_type tmp{*m_cond_list_ptr};
-        tmp.emplace_back([] { return true; }, TaskSet{std::forward<TaskClasses>(tasks)...});
-        return {tmp};
+        m_cond_list.emplace_back([] { return true; }, TaskSet{std::forward<TaskClasses>(tasks)...});
+        return {std::move(m_cond_list), m_exclusive};
     }
 
     template <typename... TaskClasses>
-    If If::IfFunction::ElseIfClass::ElseIfCondition::operator()(TaskClasses&&... tasks) const&
+    If If::ElseIfCondition::operator()(TaskClasses&&... tasks) const&
     {
         condition_list_type tmp{m_condition_list};
         if (m_condition) {
             tmp.emplace_back(m_condition, TaskSet{std::forward<TaskClasses>(tasks)...});
         }
-        return {tmp};
+        return {std::move(tmp), m_exclusive};
     }
     template <typename... TaskClasses>
-    If If::IfFunction::ElseIfClass::ElseIfCondition::operator()(TaskClasses&&... tasks) &&
+    If If::ElseIfCondition::operator()(TaskClasses&&... tasks) &&
     {
         if (m_condition) {
             m_condition_list.emplace_back(std::move(m_condition), TaskSet{std::forward<TaskClasses>(tasks)...});
         }
         m_condition = nullptr;
-        return {std::move(m_condition_list)};
+        return {std::move(m_condition_list), m_exclusive};
     }
 
 
+    // 初期化子リストを使うと要素がコピーされるので、emplace_backで構築する
     template <typename... TaskClasses>
     If IfCondition::operator()(TaskClasses&&... tasks) const&
     {
+        If::condition_list_type tmp;
         if (m_condition) {
-            return {{{m_condition, TaskSet{std::forward<TaskClasses>(tasks)...}}}};
+            tmp.emplace_back(m_condition, TaskSet{std::forward<TaskClasses>(tasks)...});
         }
-        return {{}};
+        return {std::move(tmp), m_exclusive};
     }
     template <typename... TaskClasses>
     If IfCondition::operator()(TaskClasses&&... tasks) &&
     {
+        If::condition_list_type tmp;
         if (m_condition) {
-            If tmp{{{std::move(m_condition), TaskSet{std::forward<TaskClasses>(tasks)...}}}};
+            tmp.emplace_back(std::move(m_condition), TaskSet{std::forward<TaskClasses>(tasks)...});
             m_condition = nullptr;
-            return tmp;
         }
-        return {{}};
+        return {std::move(tmp), m_exclusive};
     }
 
 }  // namespace Expr
 
 constexpr Expr::IfOperator If;
+constexpr Expr::ExclusiveIfOperator ExclusiveIf;
 
 }  // namespace TaskManager
@@ -1,9 +1,32 @@
 #include "./abst_task.hpp"
+#include "./task_analysis.hpp"
 #include "./task.hpp"
+#include "./task_blackboard.hpp"
+#include "./task_clock.hpp"
+#include "./task_condition.hpp"
+#include "./task_cycle.hpp"
+#include "./task_deferrable.hpp"
 #include "./task_delay.hpp"
 #include "./task_do.hpp"
+#include "./task_executor.hpp"
+#include "./task_fleet.hpp"
 #include "./task_if.hpp"
+#include "./task_input.hpp"
+#include "./task_introspection.hpp"
 #include "./task_jump.hpp"
+#include "./task_limit.hpp"
+#include "./task_log.hpp"
+#include "./task_metrics.hpp"
+#include "./task_observer.hpp"
+#include "./task_profiler.hpp"
+#include "./task_rate.hpp"
+#include "./task_realtime.hpp"
+#include "./task_replay.hpp"
 #include "./task_runloop.hpp"
+#include "./task_sampler.hpp"
+#include "./task_scheduler.hpp"
 #include "./task_set.hpp"
+#include "./task_signal.hpp"
+#include "./task_simulation.hpp"
+#include "./task_switch.hpp"
 #include "./task_while.hpp"
\ No newline at end of file
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "./task_condition.hpp"
+#include "./task_cycle.hpp"
+
+namespace TaskManager
+{
+
+/*!
+ * @brief I/Oスレッドから制御スレッドへ値を渡す入力置き場
+ * @detail 3つのバッファを回す(トリプルバッファ)ので、書き込み側も読み込み側も待たされない。
+ * 書き込み側は裏のバッファに書いてからpublish()で差し替え、
+ * 読み込み側はその周期(Cycle::epoch())で最初に読んだ時に、その時点で完成している最新の値に切り替える。
+ * 同じ周期の中では何度読んでも同じ値が見え、書きかけの値が見えることは無い。
+ *
+ * 書き込むスレッド・読むスレッドはそれぞれ1つに限る。
+ * 複数の値を組で一貫させたい時は、1つの構造体にまとめて1つのInputStoreに入れる。
+ * コピーは同じ置き場を指す。
+ */
+template <typename T>
+class InputStore
+{
+private:
+    static constexpr std::uint8_t index_mask = 0x3;
+    static constexpr std::uint8_t fresh_bit = 0x4;  //!< 中央のバッファに未読の値が有る
+
+    struct alignas(64) Buffer {
+        T value;
+    };
+
+    struct State {
+        std::array<Buffer, 3> buffers;
+
+        alignas(64) std::atomic<std::uint8_t> middle{1};
+
+        alignas(64) std::uint8_t back = 2;  //!< 書き込み側だけが触る
+
+        alignas(64) std::uint8_t front = 0;  //!< 以下は読み込み側だけが触る
+        Cycle::epoch_type latched_epoch = 0;
+
+        explicit State(const T& _initial) : buffers{{{_initial}, {_initial}, {_initial}}} {}
+    };
+
+    std::shared_ptr<State> m_state;
+
+    void latch() const noexcept
+    {
+        auto& state = *m_state;
+        auto now = Cycle::epoch();
+        if (state.latched_epoch == now) {
+            return;
+        }
+        state.latched_epoch = now;
+
+        if (state.middle.load(std::memory_order_relaxed) & fresh_bit) {
+            state.front = state.middle.exchange(state.front, std::memory_order_acq_rel) & index_mask;
+        }
+    }
+
+public:
+    using value_type = T;
+
+    explicit InputStore(const T& _initial = T{}) : m_state{std::make_shared<State>(_initial)} {}
+
+    virtual ~InputStore() noexcept {}
+
+    InputStore(const InputStore&) noexcept = default;
+    InputStore& operator=(const InputStore&) & noexcept = default;
+    InputStore(InputStore&&) noexcept = default;
+    InputStore& operator=(InputStore&&) & noexcept = default;
+
+    //! @brief 書き込み側: 値を公開する
+    void publish(const T& _value)
+    {
+        back_buffer() = _value;
+        commit();
+    }
+    void publish(T&& _value)
+    {
+        back_buffer() = std::move(_value);
+        commit();
+    }
+
+    /*!
+     * @brief 書き込み側: 裏のバッファを直接書き換える
+     * @detail 中身は数回前の値のままなので、全ての要素を書き直してからcommit()する。
+     */
+    T& back_buffer() noexcept { return m_state->buffers[m_state->back].value; }
+    void commit() noexcept
+    {
+        auto& state = *m_state;
+        state.back = state.middle.exchange(static_cast<std::uint8_t>(state.back | fresh_bit), std::memory_order_acq_rel)
+                     & index_mask;
+    }
+
+    //! @brief 読み込み側: この周期の値
+    const T& get() const noexcept
+    {
+        latch();
+        return m_state->buffers[m_state->front].value;
+    }
+
+    //! @brief 条件式の葉として使う(Cond(input) > 3)
+    T operator()() const { return get(); }
+    void identify(std::string& _key) const { Expr::append_identity(_key, m_state.get()); }
+};
+
+}  // namespace TaskManager
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace TaskManager
+{
+
+/*!
+ * @brief 実行中の経路を、制御スレッドを止めずに他のスレッドから覗く仕組み
+ * @detail 根のactive_path()で得たActivePathに、resume()の終わりに根から葉までの節点の番号を書き込む。
+ * 読む側はseqlockの手順で読むので、制御スレッドは読む側を待たない。
+ */
+namespace Introspection
+{
+    using node_id = std::uint32_t;
+
+    //! @brief 節点の番号を発行する。全ての節点は構築時(コピーを含む)に1つ受け取る
+    node_id issue_node_id() noexcept;
+
+    /*!
+     * @brief 1つの根の、実行中の経路
+     * @detail 書くのは根をresume()するスレッドだけ。読むのはどのスレッドからでもよい。
+     */
+    class ActivePath
+    {
+    public:
+        static constexpr std::size_t max_depth = 32;  //!< これより深い節点の番号は記録しない
+
+        //! @brief ある時点の経路の写し
+        struct Snapshot {
+            std::size_t depth = 0;                    //!< 根から葉までの節点の数。実行中でなければ0
+            std::array<node_id, max_depth> path{};    //!< 根から順の節点の番号(先頭のmax_depth個)
+            std::uint64_t active_cycles = 0;          //!< 葉が続けて実行中である周期の数
+            std::uint64_t epoch = 0;                  //!< 書き込んだ時の周期の番号(Cycle::epoch())
+            std::uint64_t sequence = 0;               //!< 書き込みの回数(同じなら同じ写し)
+
+            //! @brief 葉の節点の番号(実行中でなければ0)
+            node_id leaf() const noexcept { return depth == 0 ? 0 : path[(depth < max_depth ? depth : max_depth) - 1]; }
+            bool truncated() const noexcept { return depth > max_depth; }
+        };
+
+    private:
+        std::atomic<std::uint64_t> m_sequence{0};  //!< 奇数なら書き込み中
+        std::atomic<std::size_t> m_depth{0};
+        std::array<std::atomic<node_id>, max_depth> m_path{};
+        std::atomic<std::uint64_t> m_active_cycles{0};
+        std::atomic<std::uint64_t> m_epoch{0};
+
+        // 書くスレッドだけが使う
+        node_id m_last_leaf{0};
+        std::size_t m_last_depth{0};
+        std::uint64_t m_last_cycles{0};
+
+    public:
+        ActivePath() noexcept {}
+
+        ActivePath(const ActivePath&) = delete;
+        ActivePath& operator=(const ActivePath&) = delete;
+
+        /*!
+         * @brief 今の経路を読む
+         * @detail 書き込みと重なったら読み直す。書き込みは1周期に1度なので、待つことはほぼ無い。
+         */
+        Snapshot read() const noexcept;
+        //! @brief 1度だけ読んでみる。書き込みと重なったらfalse
+        bool try_read(Snapshot&) const noexcept;
+
+        //! @brief 経路を書き込む(根のresume()から呼ばれる)
+        void publish(const node_id* _path, std::size_t _depth) noexcept;
+    };
+
+    /*!
+     * @brief 評価している途中の節点の積み重なり
+     * @detail ActivePathがresume()の終わりの経路なのに対し、こちらは評価の最中の経路を、節点に入る度・出る度に書き換える。
+     * サンプリングで「周期の時間をどこで使っているか」を調べる為に使う(Profiling::Sampler)。
+     * 書くのは根をresume()するスレッドだけ。読む側はseqlockの手順で読み、書き込みと重なった読みは捨てる。
+     */
+    class LiveStack
+    {
+    public:
+        static constexpr std::size_t max_depth = ActivePath::max_depth;
+
+    private:
+        std::atomic<std::uint64_t> m_sequence{0};  //!< 奇数なら書き込み中
+        std::atomic<std::size_t> m_depth{0};
+        std::array<std::atomic<node_id>, max_depth> m_path{};
+
+    public:
+        LiveStack() noexcept {}
+
+        LiveStack(const LiveStack&) = delete;
+        LiveStack& operator=(const LiveStack&) = delete;
+
+        //! @brief _depth番目に節点を積む
+        void push(std::size_t _depth, node_id _id) noexcept
+        {
+            auto sequence = m_sequence.load(std::memory_order_relaxed);
+            m_sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            if (_depth < max_depth) {
+                m_path[_depth].store(_id, std::memory_order_relaxed);
+            }
+            m_depth.store(_depth + 1, std::memory_order_relaxed);
+
+            m_sequence.store(sequence + 2, std::memory_order_release);
+        }
+        //! @brief 積み重なりを_depth個に戻す(縮めるだけなので、読む側は前後どちらの状態を見ても正しい)
+        void pop(std::size_t _depth) noexcept { m_depth.store(_depth, std::memory_order_release); }
+
+        /*!
+         * @brief 1度だけ読んでみる。書き込みと重なったらfalse
+         * @param _depth 節点の数(max_depthを超えることがある。_pathには先頭のmax_depth個)
+         */
+        bool try_read(std::array<node_id, max_depth>& _path, std::size_t& _depth) const noexcept;
+    };
+
+    /*!
+     * @brief resume()の1回の間に、評価中の節点を積んで実行中の経路を求める
+     * @detail AbstTask::resume()が作り、evaluate_task()が使う。
+     * 評価が未完了で返った最初の(最も深い)節点までを経路とし、それ以降の評価では書き換えない。
+     * _liveが有れば、評価の最中の経路も書き込む。
+     * 書き込み先が無く_recordでもない(経路も統計も公開していない根の)間は、current()がnullptrになり何も記録しない。
+     */
+    class PathTracker
+    {
+    private:
+        ActivePath* m_target;
+        LiveStack* m_live;
+        std::array<node_id, ActivePath::max_depth> m_path;
+        std::size_t m_depth{0};
+        std::size_t m_length{0};
+        std::uint64_t m_evaluations{0};
+        bool m_frozen{false};
+        PathTracker* m_previous;
+
+    public:
+        explicit PathTracker(ActivePath* _target, bool _record = false, LiveStack* _live = nullptr) noexcept;
+        ~PathTracker() noexcept;
+
+        PathTracker(const PathTracker&) = delete;
+        PathTracker& operator=(const PathTracker&) = delete;
+
+        //! @brief 呼んだスレッドで経路を求めているPathTracker(無ければnullptr)
+        static PathTracker* current() noexcept;
+
+        //! @brief 節点の評価を始める。戻り値はleaveに渡す
+        std::size_t enter(node_id _id) noexcept
+        {
+            auto depth = m_depth++;
+            ++m_evaluations;
+            if (!m_frozen && depth < m_path.size()) {
+                m_path[depth] = _id;
+            }
+            if (m_live) {
+                m_live->push(depth, _id);
+            }
+            return depth;
+        }
+        //! @brief 節点の評価を終える。_runningなら未完了
+        void leave(std::size_t _depth, bool _running) noexcept
+        {
+            m_depth = _depth;
+            if (m_live) {
+                m_live->pop(_depth);
+            }
+            if (_running && !m_frozen) {
+                m_length = _depth + 1;
+                m_frozen = true;
+            }
+        }
+
+        //! @brief 求めた経路の節点の数(実行中でなければ0)
+        std::size_t depth() const noexcept { return m_frozen ? m_length : 0; }
+        //! @brief 葉の節点の番号(実行中でなければ0)
+        node_id leaf() const noexcept { return m_frozen ? m_path[std::min(m_length, m_path.size()) - 1] : 0; }
+        //! @brief 評価した節点の数
+        std::uint64_t evaluations() const noexcept { return m_evaluations; }
+
+        //! @brief 求めた経路を書き込む
+        void publish() const noexcept
+        {
+            if (m_target) {
+                m_target->publish(m_path.data(), m_frozen ? m_length : 0);
+            }
+        }
+    };
+
+}  // namespace Introspection
+
+}  // namespace TaskManager
@@ -1,6 +1,10 @@
+#pragma once
+
+#include <atomic>
 #include <map>
 
 #include "./abst_task.hpp"
+#include "./task_adaptive.hpp"
 #include "./task_set.hpp"
 
 namespace TaskManager
@@ -28,6 +32,22 @@ namespace Expr
             using jump_cond_list_t = std::map<int, std::vector<jump_cond_t>>;
 
             std::shared_ptr<jump_cond_list_t> m_jump_list{std::make_shared<jump_cond_list_t>()};
+            std::map<int, AdaptiveOrder> m_exclusive_list;  //!< 互いに排他と宣言された優先度の、条件の評価順
+            /*!
+             * @brief ジャンプ先の実行用の予備
+             * @detail 同じJumpManagerを共有する根(EmbeddedJumpのコピー)が別のスレッドで動いていても、
+             * 取り出しと作り直しはclaimedを立てた1つのスレッドだけが行う。freshはclaimedを立てている間だけ触る。
+             */
+            struct Spare {
+                std::shared_ptr<TaskSet> task;
+                std::atomic<bool> claimed{false};  //!< 取り出し・作り直しの最中か
+                bool fresh{true};                  //!< まだ使われていないか
+
+                explicit Spare(std::shared_ptr<TaskSet>&& _task) noexcept : task{std::move(_task)} {}
+            };
+
+            std::map<const TaskSet*, Spare> m_spare_list;  //!< warm_upで作る、ジャンプ先の実行用の予備
+            bool m_visiting{false};  //!< for_each_targetの途中か(循環するジャンプ先で無限に辿らないように)
 
         public:
             JumpManager() noexcept {}
@@ -39,6 +59,43 @@ namespace Expr
             JumpManager(JumpManager&&) noexcept = default;
             JumpManager& operator=(JumpManager&&) & noexcept = default;
 
+            //! @brief _priorityのジャンプ条件が互いに排他であると宣言する
+            void set_exclusive(int _priority);
+            //! @brief ジャンプ条件を追加する。排他と宣言された優先度なら、評価順も合わせて伸ばす
+            void add_condition(int _priority, jump_cond_t&& _cond);
+            std::shared_ptr<ConditionStatistics> statistics(int _priority);
+
+            /*!
+             * @brief 全てのジャンプ先について、実行用の予備を作っておく
+             * @detail ジャンプは、まだ使われていない予備が有ればコピーせずにそれを使う。
+             * 使い終わった予備は、ここでジャンプ先から作り直す(RealTime::reuse_jump_targets()なら作り直さずに使い回す)。
+             */
+            void prepare();
+            /*!
+             * @brief 本体の最悪の仕事量_duringに、ジャンプ条件の評価とジャンプの分を加える
+             * @detail ジャンプ先は次の周期に本体の代わりに評価されるので、どちらか重い方とする。
+             * @param _body ReturnBackジャンプでforce_quitされる本体(無ければnullptr)
+             */
+            Analysis::WorstCase analyze(Analysis::WorstCase&& _during, AbstTask* _body, const Analysis::CostModel&);
+            /*!
+             * @brief 全てのジャンプ先(予備が有れば予備)について_funcを呼ぶ
+             * @detail ジャンプ先を辿って自分に戻ってきた時は何もしない。
+             */
+            void for_each_target(const std::function<void(AbstTask&)>& _func);
+
+        private:
+            /*!
+             * @brief 排他と宣言された優先度の評価順を得る
+             * @detail 宣言の後に追加された条件は、add_conditionで評価順に加えてある。
+             * 排他でなければnullptr。
+             */
+            AdaptiveOrder* exclusive_order(int _priority) noexcept;
+            //! @brief _priorityのジャンプ条件の数。表に項目を作らずに数える
+            std::size_t condition_count(int _priority) const noexcept;
+
+            //! @brief ジャンプ先の実行用のタスクを得る。使える予備が有ればそれを、無ければコピーを返す
+            std::shared_ptr<TaskSet> take_target(const std::shared_ptr<TaskSet>& _target);
+
         private:
             struct JumpTarget {
                 int priority;
@@ -88,6 +145,7 @@ namespace Expr
 
                 public:
                     JumpIfClass(const std::shared_ptr<JumpManager>&, const std::shared_ptr<TaskSet>&) noexcept;
+                    JumpIfClass(std::shared_ptr<JumpManager>&&, std::shared_ptr<TaskSet>&&) noexcept;
 
                     virtual ~JumpIfClass() noexcept {}
 
@@ -170,19 +228,60 @@ namespace Expr
                     JumpBackIfCondition operator()(std::function<bool()>&&) && noexcept;
                 };
 
+                /*!
+                 * @brief JumpIf・JumpBackIfの先頭
+                 * @detail JumpManagerOperatorの持つポインタをムーブして、上記のクラスへ渡す。
+                 * ポインタを握ったまま残らないので、出来上がったJumpは共有されていないタスクを持ち、
+                 * TaskSetに格納する時にコピーせずに済む。
+                 */
+                template <typename JumpClass, typename JumpCondition>
+                class JumpHead
+                {
+                    JumpManagerOperator& m_operator;
+
+                    JumpClass take() const noexcept { return {std::move(m_operator.m_jump_manager), std::move(m_operator.m_taskset)}; }
+
+                public:
+                    explicit JumpHead(JumpManagerOperator& _operator) noexcept : m_operator{_operator} {}
+
+                    virtual ~JumpHead() noexcept {}
+
+                    JumpHead(const JumpHead&) = delete;
+                    JumpHead& operator=(const JumpHead&) = delete;
+
+                    JumpClass operator[](int _priority) const noexcept { return take()[_priority]; }
+
+                    JumpCondition operator[](const std::function<bool()>& _func) const noexcept { return take()[_func]; }
+                    JumpCondition operator[](std::function<bool()>&& _func) const noexcept { return take()[std::move(_func)]; }
+                    JumpCondition operator()(const std::function<bool()>& _func) const noexcept { return take()(_func); }
+                    JumpCondition operator()(std::function<bool()>&& _func) const noexcept { return take()(std::move(_func)); }
+                };
+
+                std::shared_ptr<JumpManager> m_jump_manager;
+                std::shared_ptr<TaskSet> m_taskset;
+
             public:
-                const JumpIfClass JumpIf;
-                const JumpBackIfClass JumpBackIf;
+                const JumpHead<JumpIfClass, JumpIfCondition> JumpIf{*this};
+                const JumpHead<JumpBackIfClass, JumpBackIfCondition> JumpBackIf{*this};
+
+                /*!
+                 * @brief _priorityのジャンプ条件が互いに排他であると宣言する
+                 * @detail 排他なら同じ優先度の中での評価順は結果に影響しないので、
+                 * 当たりやすく軽い条件から評価するよう、実行中に並べ替える。
+                 */
+                Jump Exclusive(int _priority = 0);
 
                 JumpManagerOperator(const std::shared_ptr<JumpManager>&, const std::shared_ptr<TaskSet>&) noexcept;
                 JumpManagerOperator(std::shared_ptr<JumpManager>&&, std::shared_ptr<TaskSet>&&) noexcept;
 
                 virtual ~JumpManagerOperator() noexcept {}
 
-                JumpManagerOperator(const JumpManagerOperator&) noexcept = default;
-                JumpManagerOperator& operator=(const JumpManagerOperator&) & noexcept = default;
-                JumpManagerOperator(JumpManagerOperator&&) noexcept = default;
-                JumpManagerOperator& operator=(JumpManagerOperator&&) & noexcept = default;
+                // 値で返され、operator->は自分自身を指す
+                //     DSLの中で一時オブジェクトとして1度だけ使われることを前提とする
+                JumpManagerOperator(const JumpManagerOperator&) = delete;
+                JumpManagerOperator& operator=(const JumpManagerOperator&) = delete;
+
+                JumpManagerOperator* operator->() noexcept { return this; }
             };
         };
 
@@ -206,6 +305,10 @@ namespace Expr
         protected:
             NextTask eval() override;
             void interrupt() override;
+
+            void for_each_child(const std::function<void(AbstTask&)>&) override;
+            void prepare() override;
+            Analysis::WorstCase analyze(const Analysis::CostModel&) override;
         };
 
     private:
@@ -228,12 +331,23 @@ namespace Expr
         Jump(Jump&&) noexcept;
         Jump& operator=(Jump&&) & noexcept;
 
-        std::shared_ptr<JumpManager::JumpManagerOperator> operator->() const& noexcept;
-        std::shared_ptr<JumpManager::JumpManagerOperator> operator->() && noexcept;
+        JumpManager::JumpManagerOperator operator->() const& noexcept;
+        JumpManager::JumpManagerOperator operator->() && noexcept;
+
+        /*!
+         * @brief Exclusiveと宣言した優先度の、ジャンプ条件の評価の統計
+         * @detail ジャンプ情報はコピーされないので、TaskSetに入れた後も有効。
+         * 排他と宣言されていなければnullptr。
+         */
+        std::shared_ptr<ConditionStatistics> statistics(int _priority = 0) const;
 
     protected:
         NextTask eval() override;
         void interrupt() override;
+
+        void for_each_child(const std::function<void(AbstTask&)>&) override;
+        void prepare() override;
+        Analysis::WorstCase analyze(const Analysis::CostModel&) override;
     };
 
     template <>
@@ -255,9 +369,7 @@ namespace Expr
     auto Jump::JumpManager::JumpManagerOperator::JumpIfCondition::operator()(TaskClasses&&... _tasks) const& -> std::enable_if_t<std::is_constructible<TaskSet, TaskClasses...>::value, Jump>
     {
         if (m_jump_manager) {
-            if (auto& jump_list = m_jump_manager->m_jump_list) {
-                (*jump_list)[m_priority].emplace_back(m_func, JumpType::OneWay, std::make_shared<TaskSet>(std::forward<TaskClasses>(_tasks)...));
-            }
+            m_jump_manager->add_condition(m_priority, {m_func, JumpType::OneWay, std::make_shared<TaskSet>(std::forward<TaskClasses>(_tasks)...)});
         }
 
         return {m_taskset, m_jump_manager};
@@ -266,9 +378,7 @@ namespace Expr
     auto Jump::JumpManager::JumpManagerOperator::JumpIfCondition::operator()(TaskClasses&&... _tasks) && -> std::enable_if_t<std::is_constructible<TaskSet, TaskClasses...>::value, Jump>
     {
         if (m_jump_manager) {
-            if (auto& jump_list = m_jump_manager->m_jump_list) {
-                (*jump_list)[m_priority].emplace_back(std::move(m_func), JumpType::OneWay, std::make_shared<TaskSet>(std::forward<TaskClasses>(_tasks)...));
-            }
+            m_jump_manager->add_condition(m_priority, {std::move(m_func), JumpType::OneWay, std::make_shared<TaskSet>(std::forward<TaskClasses>(_tasks)...)});
         }
 
         return {std::move(m_taskset), std::move(m_jump_manager)};
@@ -279,9 +389,7 @@ namespace Expr
     auto Jump::JumpManager::JumpManagerOperator::JumpBackIfCondition::operator()(TaskClasses&&... _tasks) const& -> std::enable_if_t<std::is_constructible<TaskSet, TaskClasses...>::value, Jump>
     {
         if (m_jump_manager) {
-            if (auto& jump_list = m_jump_manager->m_jump_list) {
-                (*jump_list)[m_priority].emplace_back(m_func, JumpType::ReturnBack, std::make_shared<TaskSet>(std::forward<TaskClasses>(_tasks)...));
-            }
+            m_jump_manager->add_condition(m_priority, {m_func, JumpType::ReturnBack, std::make_shared<TaskSet>(std::forward<TaskClasses>(_tasks)...)});
         }
 
         return {m_taskset, m_jump_manager};
@@ -290,9 +398,7 @@ namespace Expr
     auto Jump::JumpManager::JumpManagerOperator::JumpBackIfCondition::operator()(TaskClasses&&... _tasks) && -> std::enable_if_t<std::is_constructible<TaskSet, TaskClasses...>::value, Jump>
     {
         if (m_jump_manager) {
-            if (auto& jump_list = m_jump_manager->m_jump_list) {
-                (*jump_list)[m_priority].emplace_back(std::move(m_func), JumpType::ReturnBack, std::make_shared<TaskSet>(std::forward<TaskClasses>(_tasks)...));
-            }
+            m_jump_manager->add_condition(m_priority, {std::move(m_func), JumpType::ReturnBack, std::make_shared<TaskSet>(std::forward<TaskClasses>(_tasks)...)});
         }
 
         return {std::move(m_taskset), std::move(m_jump_manager)};
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+
+#include "./abst_task.hpp"
+#include "./task_clock.hpp"
+#include "./task_cycle.hpp"
+#include "./task_set.hpp"
+
+namespace TaskManager
+{
+
+//! @brief Limitの上限を超えた時の情報
+struct LimitEvent {
+    Introspection::node_id node = 0;           //!< 上限を超えたLimitの節点の番号
+    std::size_t cycles = 0;                    //!< 実行を始めてからの周期の数
+    std::chrono::steady_clock::duration elapsed{};  //!< 実行を始めてからの時間(時間の上限が無ければ0)
+};
+
+//! @brief 上限を超えた時にどうするか
+enum class LimitAction {
+    Quit,     //!< 中身をforce_quitし、Limitを終了する(次のタスクへ進む)
+    Continue  //!< そのまま続ける。次に実行を始めるまでは、再び知らせない
+};
+
+namespace Expr
+{
+
+    //! @brief Limitが上限を超えた回数など。コピーしたLimited間で共有する
+    struct LimitStatistics {
+        std::atomic<std::size_t> started{0};   //!< 実行を始めた回数
+        std::atomic<std::size_t> exceeded{0};  //!< 上限を超えた回数
+        std::atomic<std::size_t> quit{0};      //!< 上限を超えて中身をforce_quitした回数
+    };
+
+    /*!
+     * @brief 中身が長く実行中のままであれば知らせるブロック
+     * @detail 実行を始めてからの周期の数・時間に上限を設け、超えたら処理関数を呼ぶ。
+     * 処理関数が無ければLimitAction::Quitとする。
+     * 判定は自身が評価される度に行うので、手間は実行中のLimitの数に比例し、木を辿ることは無い。
+     * 周期の数は、自身が評価された周期を数える(Scopeの外で別の根のresume()が周期を進めても数えない)。
+     * 時間の上限が有る時だけ時計を読む。
+     */
+    class Limited : public AbstTask
+    {
+    public:
+        using clock = Clock;
+        using handler_type = std::function<LimitAction(const LimitEvent&)>;
+
+    private:
+        TaskSet m_taskset;
+        std::optional<std::size_t> m_max_cycles;
+        std::optional<clock::duration> m_max_time;
+        handler_type m_handler;
+
+        std::size_t m_cycles{0};             //!< 始めた周期から数えて、自身が評価された周期の数
+        Cycle::epoch_type m_cycle_epoch{0};  //!< 最後に評価された周期のCycle::epoch()
+        clock::time_point m_begin_time{};
+        bool m_notified{false};  //!< 今回の実行で既に知らせたか
+
+        std::shared_ptr<LimitStatistics> m_statistics;
+
+    public:
+        Limited(std::optional<std::size_t> _max_cycles, std::optional<clock::duration> _max_time, handler_type _handler, TaskSet&&);
+
+        virtual ~Limited() noexcept {}
+
+        Limited(const Limited&);
+        Limited& operator=(const Limited&) &;
+        Limited(Limited&&) noexcept;
+        Limited& operator=(Limited&&) & noexcept;
+
+        std::shared_ptr<const LimitStatistics> statistics() const noexcept { return m_statistics; }
+
+    protected:
+        void init() override;
+        NextTask eval() override;
+        void interrupt() override;
+
+        void for_each_child(const std::function<void(AbstTask&)>&) override;
+        /*!
+         * @brief 上限を超えるまでの周期数と、中身の分の小さい方
+         * @detail 時間の上限は、仮想の時刻(VirtualTime)の下で、1周期にCycle::frequency()の逆数ずつ進むとして数える。
+         * 実際の時刻の下では、時間の上限が有れば0。
+         */
+        std::uint64_t waiting_cycles() override;
+        //! @brief 飛ばした周期の分だけ周期の数を進める
+        void skip_waiting(std::uint64_t) override;
+    };
+
+}  // namespace Expr
+
+
+/*!
+ * @brief Limit{cycles}(...)、Limit{time}(...)、Limit{cycles, time}(...)で、中身の実行中の周期の数・時間に上限を設ける
+ * @detail 最後の引数に処理関数を渡せる。上限を超えると呼ばれ、戻り値で中身を終わらせるか続けるかを決める。
+ * 省略すると、中身をforce_quitして次へ進む。
+ */
+class Limit
+{
+private:
+    std::optional<std::size_t> m_max_cycles;
+    std::optional<Expr::Limited::clock::duration> m_max_time;
+    Expr::Limited::handler_type m_handler;
+
+public:
+    explicit Limit(std::size_t _max_cycles, Expr::Limited::handler_type _handler = nullptr)
+        : m_max_cycles{_max_cycles}, m_max_time{std::nullopt}, m_handler{std::move(_handler)} {}
+
+    template <typename Rep, typename Period>
+    explicit Limit(std::chrono::duration<Rep, Period> _max_time, Expr::Limited::handler_type _handler = nullptr)
+        : m_max_cycles{std::nullopt},
+          m_max_time{std::chrono::duration_cast<Expr::Limited::clock::duration>(_max_time)},
+          m_handler{std::move(_handler)}
+    {
+    }
+
+    template <typename Rep, typename Period>
+    Limit(std::size_t _max_cycles, std::chrono::duration<Rep, Period> _max_time, Expr::Limited::handler_type _handler = nullptr)
+        : m_max_cycles{_max_cycles},
+          m_max_time{std::chrono::duration_cast<Expr::Limited::clock::duration>(_max_time)},
+          m_handler{std::move(_handler)}
+    {
+    }
+
+    template <typename... TaskClasses>
+    Expr::Limited operator()(TaskClasses&&... tasks) const
+    {
+        return Expr::Limited{m_max_cycles, m_max_time, m_handler, TaskSet{std::forward<TaskClasses>(tasks)...}};
+    }
+};
+
+}  // namespace TaskManager
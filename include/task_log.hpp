@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace TaskManager
+{
+
+/*!
+ * @brief ライブラリ自身の診断メッセージの行き先
+ * @detail 制御スレッドから直接入出力をしないよう、メッセージは差し替えられるSinkへ渡す。
+ * 既定のSinkは、ロックフリーのリングに写すだけのRing。書き出しは別スレッド(Ring::start())か、
+ * 利用者が安全な時点で呼ぶRing::flush()が行う。どちらも無ければ、プロセスの終わりに標準エラー出力へ書き出す。
+ */
+namespace Log
+{
+    enum class Level {
+        Info,
+        Warning,
+        Error
+    };
+
+    const char* level_name(Level) noexcept;
+
+    /*!
+     * @brief メッセージを出す場所1つ
+     * @detail 呼び出し箇所ごとにstaticに置く。同じ場所からの繰り返しは、intervalに1度だけ通し、
+     * その間に抑えた数を次に通したメッセージに添える。
+     */
+    struct Site {
+        Level level;
+        const char* message;  //!< 静的な文字列
+        std::chrono::nanoseconds interval{std::chrono::seconds{1}};
+
+        std::atomic<std::int64_t> last_ns{0};        //!< 最後に通した時刻(0ならまだ通していない)
+        std::atomic<std::uint32_t> suppressed{0};  //!< 抑えた数
+
+        // constexprなので、関数の中のstaticでも初めて通る時の初期化の手間が無い
+        constexpr Site(Level _level, const char* _message) noexcept : level{_level}, message{_message} {}
+        constexpr Site(Level _level, const char* _message, std::chrono::nanoseconds _interval) noexcept
+            : level{_level}, message{_message}, interval{_interval} {}
+
+        Site(const Site&) = delete;
+        Site& operator=(const Site&) = delete;
+    };
+
+    //! @brief Sinkへ渡す1件
+    struct Record {
+        static constexpr std::size_t detail_size = 120;
+
+        Level level = Level::Info;
+        const char* message = "";        //!< Siteの静的な文字列
+        char detail[detail_size] = {};   //!< 例外のwhat()など、その時だけの文字列(切り詰める)
+        std::uint32_t suppressed = 0;    //!< 直前までに抑えた同じ場所からの数
+        std::int64_t time_ns = 0;        //!< steady_clockの時刻
+    };
+
+    //! @brief Recordを1行の文字列にして書く
+    void write(std::ostream&, const Record&);
+
+    /*!
+     * @brief メッセージの受け取り手
+     * @detail post()は制御スレッドからも呼ばれるので、ブロックや入出力をしないこと。
+     */
+    class Sink
+    {
+    public:
+        virtual ~Sink() noexcept {}
+        virtual void post(const Record&) noexcept = 0;
+    };
+
+    /*!
+     * @brief 固定長のロックフリーなMPSCリング
+     * @detail 複数のスレッドからpost()でき、取り出すのは1つのスレッド(drain())。
+     * 満杯なら捨てて数える(待たない)。作る時以外はヒープ確保をしない。
+     */
+    class Ring : public Sink
+    {
+    private:
+        struct Slot {
+            std::atomic<std::size_t> sequence;
+            Record record;
+        };
+
+        std::unique_ptr<Slot[]> m_slot;
+        std::size_t m_mask;
+        alignas(64) std::atomic<std::size_t> m_enqueue{0};
+        alignas(64) std::atomic<std::size_t> m_dequeue{0};
+        std::atomic<std::uint64_t> m_dropped{0};
+
+        std::mutex m_mutex;  //!< 取り出す側どうし(書き出しスレッドとflush())の排他。post()は取らない
+        std::thread m_thread;
+        std::condition_variable m_cv;
+        bool m_quit{false};
+
+    public:
+        //! @param _capacity 入る数(2の冪に切り上げる)
+        explicit Ring(std::size_t _capacity = 256);
+        ~Ring() noexcept;
+
+        Ring(const Ring&) = delete;
+        Ring& operator=(const Ring&) = delete;
+
+        void post(const Record&) noexcept override;
+
+        //! @brief 溜まっている分を全て取り出して_funcに渡す。戻り値は取り出した数
+        std::size_t drain(const std::function<void(const Record&)>& _func);
+        //! @brief 溜まっている分を_osに書き出す
+        std::size_t flush(std::ostream& _os);
+        //! @brief 満杯で捨てた数
+        std::uint64_t dropped() const noexcept { return m_dropped.load(std::memory_order_relaxed); }
+
+        //! @brief _period毎に_osへ書き出すスレッドを動かす
+        void start(std::ostream& _os, std::chrono::milliseconds _period = std::chrono::milliseconds{100});
+        //! @brief 書き出すスレッドを止める(残りは書き出す)
+        void stop() noexcept;
+    };
+
+    //! @brief 既定のSink。プロセスの終わりに残りを標準エラー出力へ書き出す
+    Ring& default_ring();
+
+    /*!
+     * @brief Sinkを差し替える。nullptrで既定に戻す
+     * @detail 渡したSinkは、差し替えるまで生かしておくこと。
+     */
+    void set_sink(Sink* _sink) noexcept;
+
+    /*!
+     * @brief メッセージを出す
+     * @detail 頻度を抑えた上でSinkに渡す。入出力もロックもしない。
+     */
+    void post(Site& _site, const char* _detail = nullptr) noexcept;
+
+}  // namespace Log
+
+}  // namespace TaskManager
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "./task_introspection.hpp"
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+    class AbstTask;
+}
+
+/*!
+ * @brief 外部から監視する為の、共有メモリ上の統計
+ * @detail POSIX共有メモリ(名前が"/name"の形)か、mmapしたファイル(それ以外)に、決まった配置で統計を置く。
+ * 制御スレッドはresume()の度に緩い(relaxed)atomicで数個の値を書くだけで、システムコールは呼ばない。
+ * 読む側は別のプロセスから同じ名前を開いて読む(metrics_reader)。
+ *
+ * 配置: Headerの後に、RootMetricsがroot_capacity個並ぶ。全ての値はロックフリーのatomic。
+ */
+namespace Metrics
+{
+    constexpr std::uint32_t layout_version = 2;
+
+    struct Header {
+        char magic[8];                          //!< "TASKMETR"
+        std::uint32_t version;                  //!< layout_version
+        std::uint32_t root_capacity;            //!< RootMetricsの数
+        std::uint32_t root_stride;              //!< RootMetrics1つの大きさ[byte]
+        std::atomic<std::uint32_t> root_count;  //!< 使われているRootMetricsの数
+        std::uint64_t pid;                      //!< 書いているプロセス
+    };
+
+    //! @brief 根1つ分の統計
+    struct alignas(64) RootMetrics {
+        static constexpr std::size_t name_size = 48;
+        static constexpr std::size_t jump_priorities = 8;     //!< 優先度0~7を個別に数える(範囲外は端に寄せる)
+        static constexpr std::size_t histogram_buckets = 32;  //!< i番目は[2^i, 2^(i+1))ns(0番目は0nsも、最後は上限無しで数える)
+
+        char name[name_size];
+        std::uint64_t budget_ns;  //!< これを超えたresume()を超過として数える(0なら数えない)
+
+        std::atomic<std::uint64_t> cycles;         //!< resume()の回数
+        std::atomic<std::uint64_t> evaluations;    //!< 節点の評価の累計
+        std::atomic<std::uint64_t> overruns;       //!< 予算を超えたresume()の回数
+        std::atomic<std::uint64_t> last_latency_ns;
+        std::atomic<std::uint64_t> max_latency_ns;
+        std::atomic<std::uint64_t> latency_sum_ns;  //!< resume()にかかった時間の合計
+
+        std::atomic<std::uint32_t> active_leaf;    //!< 実行中の葉の節点の番号
+        std::atomic<std::uint32_t> active_depth;   //!< 根から葉までの節点の数
+        std::atomic<std::uint64_t> active_cycles;  //!< 葉が続けて実行中である周期の数
+
+        std::atomic<std::uint64_t> jump_fires[jump_priorities];         //!< 優先度ごとの、実際に行われたジャンプの回数
+        std::atomic<std::uint64_t> latency_histogram[histogram_buckets];  //!< resume()にかかった時間の分布
+
+        //! @brief resume()1回分を書き込む(制御スレッドから)
+        void record(std::uint64_t _latency_ns, std::uint64_t _evaluations, Introspection::node_id _leaf, std::size_t _depth) noexcept;
+        //! @brief ジャンプ1回を数える
+        void record_jump(int _priority) noexcept;
+    };
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free, "metrics need lock-free 64bit atomics");
+
+    /*!
+     * @brief 統計を置く共有メモリ
+     * @detail 作る側(制御プロセス)はSegment(name, capacity)、読む側はSegment::open(name)を使う。
+     * 作れなければstd::system_errorを投げる。ムーブのみ可。
+     */
+    class Segment
+    {
+    private:
+        void* m_base{nullptr};
+        std::size_t m_length{0};
+        bool m_writable{false};
+
+        Segment() noexcept {}
+
+    public:
+        //! @brief 書く側として作る。既に有れば作り直す
+        Segment(const std::string& _name, std::size_t _root_capacity);
+        //! @brief 読む側として開く
+        static Segment open(const std::string& _name);
+        //! @brief 共有メモリの名前を消す(ファイルならファイルを消す)
+        static void remove(const std::string& _name) noexcept;
+
+        ~Segment() noexcept;
+
+        Segment(const Segment&) = delete;
+        Segment& operator=(const Segment&) = delete;
+        Segment(Segment&&) noexcept;
+        Segment& operator=(Segment&&) & noexcept;
+
+        const Header& header() const noexcept { return *static_cast<const Header*>(m_base); }
+        //! @brief 使われているRootMetricsの数(壊れた値でも確保した数を超えない)
+        std::size_t size() const noexcept { return std::min<std::size_t>(header().root_count.load(std::memory_order_acquire), header().root_capacity); }
+        const RootMetrics& root(std::size_t _index) const noexcept;
+
+        /*!
+         * @brief 根の統計の場所を確保し、根のresume()から書き込ませる
+         * @detail Segmentは根より長生きさせるか、先にroot.publish_metrics(nullptr)で外すこと。
+         * 場所が無ければnullptr。
+         */
+        RootMetrics* attach(Expr::AbstTask& _root, const std::string& _name, std::chrono::nanoseconds _budget = std::chrono::nanoseconds::zero());
+
+    private:
+        RootMetrics& root_at(std::size_t _index) noexcept;
+    };
+
+    /*!
+     * @brief resume()の間、その根の統計を呼んだスレッドの「今の根」にする
+     * @detail AbstTask::resume()が使う。record_jump()はこれを通して今の根に数える。
+     */
+    class Scope
+    {
+    private:
+        RootMetrics* m_previous;
+
+    public:
+        explicit Scope(RootMetrics* _metrics) noexcept;
+        ~Scope() noexcept;
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    //! @brief 今の根にジャンプを1回数える(統計を取っていなければ何もしない)。実際に移った時に呼ぶ
+    void record_jump(int _priority) noexcept;
+
+}  // namespace Metrics
+
+}  // namespace TaskManager
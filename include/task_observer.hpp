@@ -0,0 +1,83 @@
+#pragma once
+
+#include <type_traits>
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+    class AbstTask;
+}
+
+/*!
+ * @brief タスクの一生の出来事を、ビルド時に選んだ観測者へ知らせる仕組み
+ * @detail 観測者はNullを継承し、知りたい出来事の静的メンバ関数だけを同じ名前で定義し直したクラス。
+ * それを定義したヘッダをTASK_MANAGER_OBSERVER_HEADERで、クラス名をそのヘッダの中でTASK_MANAGER_OBSERVERとして与える
+ * (CMakeではTASK_MANAGER_OBSERVER_HEADERオプション)。ライブラリの全ての翻訳単位で同じものを使うこと。
+ *
+ * 観測者が無ければ、呼び出し箇所はif constexprで消え、手間は全く無い。
+ * 有れば、静的メンバ関数の直接の呼び出しになり、インライン化できる。
+ * AbstTaskはテンプレートではないので、テンプレート引数ではなくビルドオプションで選ぶ。
+ */
+namespace Observer
+{
+    //! @brief 何もしない観測者。観測者はこれを継承する
+    struct Null {
+        //! @brief init()の直前
+        static void on_init(const Expr::AbstTask&) noexcept {}
+        //! @brief eval()の直前
+        static void on_eval(const Expr::AbstTask&) noexcept {}
+        //! @brief eval()の直後。_finishedなら終了(またはNextTaskで切り替え)
+        static void on_eval_end(const Expr::AbstTask&, bool _finished) noexcept { (void)_finished; }
+        //! @brief evalが終了を示した後のquit()の直前
+        static void on_quit(const Expr::AbstTask&) noexcept {}
+        //! @brief 実行中に終了させられた時、interrupt()の直前
+        static void on_interrupt(const Expr::AbstTask&) noexcept {}
+        /*!
+         * @brief ジャンプ条件が真になり、ジャンプが受け付けられた時
+         * @param _jump ジャンプ条件を持つ節点(During)
+         * @param _return_back JumpBackIfならtrue
+         */
+        static void on_jump(const Expr::AbstTask& _jump, const Expr::AbstTask& _target, int _priority, bool _return_back) noexcept
+        {
+            (void)_jump, (void)_target, (void)_priority, (void)_return_back;
+        }
+        /*!
+         * @brief マシンが実行するタスク(シーン)を切り替えた時
+         * @detail NextTaskによる切り替えと、OneWayジャンプで根ごと切り替わる時の両方。
+         * @param _machine 切り替えたマシン(OneWayジャンプなら根)
+         */
+        static void on_scene(const Expr::AbstTask& _machine, const Expr::AbstTask& _from, const Expr::AbstTask& _to) noexcept
+        {
+            (void)_machine, (void)_from, (void)_to;
+        }
+    };
+
+}  // namespace Observer
+
+}  // namespace TaskManager
+
+#ifdef TASK_MANAGER_OBSERVER_HEADER
+#include TASK_MANAGER_OBSERVER_HEADER
+#endif
+
+namespace TaskManager
+{
+
+namespace Observer
+{
+#ifdef TASK_MANAGER_OBSERVER
+    using Active = TASK_MANAGER_OBSERVER;
+#else
+    using Active = Null;
+#endif
+
+    static_assert(std::is_base_of<Null, Active>::value, "an observer must derive from Observer::Null");
+
+    //! @brief 観測者が選ばれているか。呼び出し箇所はif constexprでこれを見る
+    constexpr bool enabled = !std::is_same<Active, Null>::value;
+
+}  // namespace Observer
+
+}  // namespace TaskManager
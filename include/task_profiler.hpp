@@ -0,0 +1,161 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "./task_introspection.hpp"
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+    class AbstTask;
+}
+
+/*!
+ * @brief 選んだ節点のeval()を、ハードウェアの性能カウンタで挟んで測る
+ * @detail Linuxのperf_event_openで、呼んだスレッドのサイクル数・命令数・キャッシュミス・分岐予測ミスを数える。
+ * 使えない環境(権限が無い、仮想マシンなど)では経過時間だけを測る。
+ * 選ばなかった節点では、節点1つにつき番号の二分探索1回しか増えない。
+ */
+namespace Profiling
+{
+    //! @brief カウンタの値。使えないものは0のまま
+    struct Counters {
+        std::uint64_t cycles = 0;
+        std::uint64_t instructions = 0;
+        std::uint64_t cache_misses = 0;
+        std::uint64_t branch_misses = 0;
+        std::uint64_t nanoseconds = 0;  //!< 経過時間。常に測る
+
+        Counters& operator+=(const Counters&) noexcept;
+        Counters& operator-=(const Counters&) noexcept;
+        friend Counters operator-(Counters _a, const Counters& _b) noexcept { return _a -= _b; }
+        //! @brief 各値ごとに大きい方
+        static Counters larger(const Counters&, const Counters&) noexcept;
+
+        //! @brief 1サイクル当たりの命令数(サイクル数が無ければ0)
+        double ipc() const noexcept { return cycles == 0 ? 0.0 : static_cast<double>(instructions) / static_cast<double>(cycles); }
+    };
+
+    //! @brief 節点1つ分の集計
+    struct NodeProfile {
+        Introspection::node_id node = 0;
+        std::string type;          //!< 選んだ時のクラス名
+        std::uint64_t calls = 0;   //!< eval()の回数
+        Counters total;            //!< eval()全体(子の評価を含む)の合計
+        Counters self;             //!< totalから、選ばれた子孫の分を引いたもの
+        Counters max;              //!< eval()1回当たりの最大(値ごと)
+    };
+
+    /*!
+     * @brief 節点ごとのカウンタの集計
+     * @detail カウンタは作ったスレッドに結び付くので、根をresume()するスレッドで作り、そのスレッドでScopeを置く。
+     * 測るのはeval()の中だけで、init()・quit()は含まない。
+     * 1回の計測にread()が2回かかる(数百ns~数us)ので、1kHzの制御周期では葉や小さな部分木に絞って選ぶこと。
+     * 制御スレッド1つから使う。report()は計測していない間に呼ぶ。
+     */
+    class Profiler
+    {
+    public:
+        static constexpr std::size_t max_depth = 64;  //!< これより深く入れ子になった選ばれた節点は測らない
+        static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+    private:
+        static constexpr std::size_t event_count = 4;
+
+        struct Frame {
+            std::size_t slot;
+            Counters begin;
+            Counters children;  //!< 選ばれた子孫の分
+        };
+
+        std::array<int, event_count> m_fd;  //!< 開けなかったものは-1。先頭がグループの代表
+        std::array<std::size_t, event_count> m_order{};  //!< 読んだ値の並び順 → m_fdの添字
+        std::size_t m_opened{0};
+        std::string m_fallback_reason;
+
+        std::vector<std::pair<Introspection::node_id, std::size_t>> m_selected;  //!< 番号の順。(番号, m_slotの添字)
+        std::vector<NodeProfile> m_slot;
+        std::array<Frame, max_depth> m_stack{};
+        std::size_t m_depth{0};
+
+        void open_events();
+        Counters read() const noexcept;
+        //! @brief 測る節点に加える。既に加えてあればfalse
+        bool add(Expr::AbstTask& _node);
+
+    public:
+        //! @brief 呼んだスレッドのカウンタを開く。開けなければ経過時間だけを測る
+        Profiler();
+        ~Profiler() noexcept;
+
+        Profiler(const Profiler&) = delete;
+        Profiler& operator=(const Profiler&) = delete;
+
+        //! @brief ハードウェアのカウンタ(少なくともサイクル数)を使えているか
+        bool hardware() const noexcept { return m_opened > 0; }
+        //! @brief 使えているカウンタの名前
+        std::vector<std::string> events() const;
+        //! @brief 経過時間だけになった理由(使えていれば空)
+        const std::string& fallback_reason() const noexcept { return m_fallback_reason; }
+
+        /*!
+         * @brief _nodeを(_subtreeなら、その全ての子孫も)測る節点に加える
+         * @detail 節点は番号で見分ける。TaskSetなどに入れた節点は新しい番号を持つコピーなので、
+         * 入れる前の変数ではなく、根からvisit()で辿った節点を渡すこと。
+         * @return 新たに加えた節点の数
+         */
+        std::size_t select(Expr::AbstTask& _node, bool _subtree = true);
+        /*!
+         * @brief _rootの木の中で、_predicateが真の節点を測る節点に加える
+         * @detail 例えばAnalysis::type_name()でクラス名を見て選ぶ。1つも当てはまらなければ警告をログに出す。
+         * @return 当てはまった節点の数
+         */
+        std::size_t select_if(Expr::AbstTask& _root, const std::function<bool(const Expr::AbstTask&)>& _predicate);
+
+        //! @brief 集計を0に戻す(選んだ節点はそのまま)
+        void clear() noexcept;
+        //! @brief 1度でも測った節点の集計を、totalのサイクル数(無ければ経過時間)の多い順に
+        std::vector<NodeProfile> report() const;
+        //! @brief 選んだのに1度も測っていない節点の数(実行した木に無い節点を選んでいないか確かめる)
+        std::size_t unevaluated() const noexcept;
+        //! @brief report()を表にして書く。測っていない節点が有れば、その数も書く
+        void print(std::ostream&) const;
+
+        //! @brief 呼んだスレッドで計測中のProfiler(無ければnullptr)
+        static Profiler* current() noexcept;
+
+        //! @brief 節点のeval()の前に呼ぶ。選ばれていなければ何もせずnposを返す。戻り値はleaveに渡す
+        std::size_t enter(Introspection::node_id _id) noexcept;
+        //! @brief 節点のeval()の後に呼ぶ
+        void leave(std::size_t _frame) noexcept;
+
+        /*!
+         * @brief 生きている間、呼んだスレッドでこのProfilerを使って測る
+         * @detail resume()を囲んで置く。Schedulerのcycle()などを囲んでもよい。
+         */
+        class Scope
+        {
+        private:
+            Profiler* m_previous;
+
+        public:
+            explicit Scope(Profiler&) noexcept;
+            ~Scope() noexcept;
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+        };
+    };
+
+}  // namespace Profiling
+
+}  // namespace TaskManager
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "./abst_task.hpp"
+#include "./task_cycle.hpp"
+#include "./task_set.hpp"
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+
+    /*!
+     * @brief 決まった周期数ごとにだけ中身を評価するブロック
+     * @detail 自分が評価された周期を数えた番号と位相から、自分の番の周期でだけ中身を1度評価し、
+     * それ以外の周期は何もせずに未完了を返す。中身が終了したら終了する。
+     *
+     * 番号は、初めて評価された周期のCycle::epoch()から始め、評価された周期ごとに1つ進める
+     * (同じ周期に何度評価されても1つ)。Scopeの外で別の根のresume()が周期を進めても、自分の根の周期の数で番が回る。
+     * 1つの根だけを動かす時や、全ての根をCycle::Scopeで囲む時は、Cycle::epoch()と同じ番号になる。
+     *
+     * 位相を指定しなければ、実行を始めた時に、既に動いている全ての多重レートのブロックの位相を見て、
+     * 同じ周期に仕事が重ならないように選ぶ(10Hzと100Hzの仕事が同じ周期に集中しないように)。
+     * 選んだ位相は、このオブジェクトが破棄されるまで保持する。コピーは改めて選び直す。
+     */
+    class MultiRate : public AbstTask
+    {
+    private:
+        TaskSet m_taskset;
+        std::size_t m_period;                     //!< 0ならm_hzから換算する
+        double m_hz;
+        std::optional<std::size_t> m_fixed_phase;  //!< 指定された位相
+
+        std::size_t m_active_period{0};  //!< 実行中の周期数
+        std::optional<std::size_t> m_phase{std::nullopt};
+        bool m_owns_phase{false};  //!< 位相を表から借りているか
+        std::uint64_t m_turn{0};            //!< 自分が評価された周期を数えた番号
+        Cycle::epoch_type m_turn_epoch{0};  //!< 最後に評価された周期のCycle::epoch()(0はまだ評価していない)
+
+        void release_phase() noexcept;
+        //! @brief 周期数を換算し、位相がまだ無いか周期数が変わっていれば決める
+        void assign_phase();
+        //! @brief 新しい周期に評価されたら番号を進める
+        void advance_turn() noexcept;
+
+    public:
+        MultiRate(std::size_t _period, double _hz, std::optional<std::size_t> _phase, TaskSet&&);
+
+        virtual ~MultiRate() noexcept;
+
+        MultiRate(const MultiRate&);
+        MultiRate& operator=(const MultiRate&) &;
+        MultiRate(MultiRate&&) noexcept;
+        MultiRate& operator=(MultiRate&&) & noexcept;
+
+        //! @brief 実行中の周期数と位相(まだ決まっていなければnullopt)
+        std::size_t period() const noexcept { return m_active_period; }
+        std::optional<std::size_t> phase() const noexcept { return m_phase; }
+
+    protected:
+        void init() override;
+        NextTask eval() override;
+        void interrupt() override;
+
+        void for_each_child(const std::function<void(AbstTask&)>&) override;
+        //! @brief 位相を決めておく
+        void prepare() override;
+        /*!
+         * @brief 次の自分の番までの周期数
+         * @detail 自分の番の周期は中身が評価されるので数えない(中身はその周期ごとにしか数が進まないので、中身には任せない)。
+         */
+        std::uint64_t waiting_cycles() override;
+        //! @brief 飛ばした周期の分だけ番号を進める
+        void skip_waiting(std::uint64_t) override;
+        //! @brief 位相を決めてから写す(全ての実体が同じ位相を使う)
+        std::uint32_t compile(Fleet::Builder&) override;
+    };
+
+    /*!
+     * @brief 周期数_periodの位相を、既に使われている位相と重なりにくいように選んで借りる
+     * @detail 全ての多重レートのブロックで共有する表を使う。
+     */
+    std::size_t acquire_rate_phase(std::size_t _period);
+    //! @brief 借りた位相を返す
+    void release_rate_phase(std::size_t _period, std::size_t _phase) noexcept;
+
+}  // namespace Expr
+
+
+/*!
+ * @brief Every{n}(...)で、n周期に1度だけ中身を評価するブロックを作る
+ * @detail Every{n, phase}で位相を固定することもできる。
+ */
+class Every
+{
+private:
+    std::size_t m_period;
+    std::optional<std::size_t> m_phase;
+
+public:
+    explicit Every(std::size_t _period) noexcept : m_period{_period > 0 ? _period : 1}, m_phase{std::nullopt} {}
+    Every(std::size_t _period, std::size_t _phase) noexcept : m_period{_period > 0 ? _period : 1}, m_phase{_phase % m_period} {}
+
+    template <typename... TaskClasses>
+    Expr::MultiRate operator()(TaskClasses&&... tasks) const
+    {
+        return Expr::MultiRate{m_period, 0.0, m_phase, TaskSet{std::forward<TaskClasses>(tasks)...}};
+    }
+};
+
+/*!
+ * @brief AtRate{hz}(...)で、hz[Hz]で中身を評価するブロックを作る
+ * @detail 制御周期の周波数(Cycle::set_frequency)から、何周期に1度かに換算する(実行を始めた時点の値を使う)。
+ */
+class AtRate
+{
+private:
+    double m_hz;
+
+public:
+    explicit AtRate(double _hz) noexcept : m_hz{_hz} {}
+
+    template <typename... TaskClasses>
+    Expr::MultiRate operator()(TaskClasses&&... tasks) const
+    {
+        return Expr::MultiRate{0, m_hz, std::nullopt, TaskSet{std::forward<TaskClasses>(tasks)...}};
+    }
+};
+
+}  // namespace TaskManager
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "./abst_task.hpp"
+
+namespace TaskManager
+{
+
+/*!
+ * @brief resume()の中でのヒープ確保を見張る仕組み
+ * @detail 確保を捕まえるには、operator newからnote_allocation()を呼ぶ必要が有る。
+ * TASK_MANAGER_RT_CHECKを定義してビルドすると、ライブラリがoperator newを置き換えてそれを行う
+ * (CMakeのオプションTASK_MANAGER_RT_CHECK)。自前でoperator newを置き換えている場合は、そこから呼べばよい。
+ *
+ * 実行前に根でwarm_up()を呼んでおけば、定常状態のresume()は確保をしない。
+ * ただし、利用者の関数オブジェクトやNextTaskで返すシーンの中での確保は、利用者が避けること
+ * (シーンは予め作っておいたshared_ptrを返す)。
+ */
+namespace RealTime
+{
+    enum class Check {
+        Off,    //!< 何もしない
+        Count,  //!< resume()の中での確保を数える
+        Abort   //!< resume()の中で確保されたらstd::abort()する
+    };
+
+    void set_check(Check) noexcept;
+    Check check() noexcept;
+
+    //! @brief Count・Abortの間に、resume()の中で起きた確保の数
+    std::size_t allocations() noexcept;
+    void reset_allocations() noexcept;
+
+    //! @brief operator newから呼ぶ。呼んだスレッドがresume()の中なら確保として扱う
+    void note_allocation() noexcept;
+
+    //! @brief 呼んだスレッドがresume()の中か
+    bool in_resume() noexcept;
+
+    /*!
+     * @brief ジャンプ先の予備を、使い終わった後もコピーし直さずに使い回すか(既定はfalse)
+     * @detail 既定では、warm_up()で作った予備は1度だけ使い、使い終わった予備は次のwarm_up()で作り直す
+     * (それまでのジャンプは、今までどおり実行の度にコピーする)。
+     * trueにすると定常状態のジャンプでも確保をしないが、ジャンプ先の葉の関数オブジェクトの状態は前の訪問から引き継がれる。
+     */
+    void set_reuse_jump_targets(bool) noexcept;
+    bool reuse_jump_targets() noexcept;
+
+    //! @brief resume()の中であることを示す。AbstTask::resume()が使う
+    class ResumeScope
+    {
+    public:
+        ResumeScope() noexcept;
+        ~ResumeScope() noexcept;
+
+        ResumeScope(const ResumeScope&) = delete;
+        ResumeScope& operator=(const ResumeScope&) = delete;
+    };
+
+
+    //! @brief setup_thread()で制御スレッドに施す設定
+    struct ThreadConfig {
+        int priority = 80;                      //!< SCHED_FIFOの優先度。0以下なら変えない
+        int cpu = -1;                           //!< 固定するCPU番号。負なら固定しない
+        bool lock_memory = true;                //!< mlockall(MCL_CURRENT | MCL_FUTURE)するか
+        std::size_t stack_prefault = 512 * 1024;  //!< 予め触っておくスタックの大きさ[byte]
+    };
+
+    //! @brief setup_thread()の結果。できなかった設定はfailuresに理由を残す
+    struct ThreadReport {
+        bool scheduling = false;        //!< SCHED_FIFOにできたか
+        bool pinned = false;            //!< CPUに固定できたか
+        bool memory_locked = false;     //!< mlockallできたか
+        bool stack_prefaulted = false;  //!< スタックを触れたか
+        std::vector<std::string> failures;
+
+        bool complete() const noexcept { return failures.empty(); }
+    };
+
+    /*!
+     * @brief resume()を呼ぶスレッドが、自分自身を実時間向けに設定する
+     * @detail 実時間スケジューリング(SCHED_FIFO)・CPUへの固定・メモリのロック・スタックの事前確保を行う。
+     * 権限が無いなど、できなかった設定は飛ばして続け、理由を報告に残す(例外は投げない)。
+     * Linux以外では何もせず、全て未対応と報告する。
+     */
+    ThreadReport setup_thread(const ThreadConfig& = {});
+
+    //! @brief 呼んだスレッドを_cpuに固定する。固定できたらtrue
+    bool pin_current_thread(int _cpu) noexcept;
+
+    /*!
+     * @brief 木をwarm_up()し、全ての節点を1度触っておく
+     * @detail まれにしか通らない分岐でも、初めて触った時のページフォルトが実行中に起きないようにする。
+     * mlockallの後に呼ぶとよい。
+     */
+    void pre_touch(Expr::AbstTask& _root);
+
+}  // namespace RealTime
+
+}  // namespace TaskManager
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+    class AbstTask;
+}
+
+/*!
+ * @brief 条件式と葉の結果を記録し、そのまま再生する
+ * @detail 記録中は、条件式(If, While, JumpIfなど)の真偽、Switchのキー、関数の葉(Task)の終了・未終了、
+ * それに時刻や周期の番号で決まる判断(ループの周回の打ち切り、Every、Limit、Deferrable、Schedulerの後回し)を、
+ * 評価した順に1周期ごとにまとめて記録する。
+ * 再生中は、関数オブジェクトを呼ばずに記録した結果を返すので、同じ木は記録した時と全く同じ制御の流れを辿る。
+ * AbstTaskを直接継承した利用者のタスクのeval()や、interrupt_funcは再生中も呼ばれる。
+ *
+ * 記録と再生は、同じ形の木を新しく組んでから始めること(適応的な評価順も同じ結果になるよう、
+ * 記録中・再生中は評価時間による並べ替えを止める)。
+ */
+namespace Replay
+{
+    //! @brief 再生した木が、記録と違う数の結果を求めた
+    class Divergence : public std::runtime_error
+    {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /*!
+     * @brief 1周期分の結果の列
+     * @detail Recorder・Playerの共通部分。呼んだスレッドの「今のセッション」として使われる。
+     */
+    class Session
+    {
+    protected:
+        bool m_replaying;
+        std::vector<std::uint64_t> m_bits;  //!< 真偽の列(1ビットずつ)
+        std::size_t m_bit_count{0};
+        std::size_t m_bit_index{0};  //!< 再生中の読み出し位置
+        std::vector<std::int64_t> m_keys;   //!< Switchのキーの列
+        std::size_t m_key_index{0};
+
+        Session* m_previous{nullptr};
+
+        static thread_local Session* s_current;
+
+        explicit Session(bool _replaying) noexcept : m_replaying{_replaying} {}
+        ~Session() noexcept {}
+
+        void enter() noexcept;
+        void leave() noexcept;
+
+    public:
+        Session(const Session&) = delete;
+        Session& operator=(const Session&) = delete;
+
+        //! @brief 呼んだスレッドで記録・再生中のセッション(無ければnullptr)
+        static Session* current() noexcept { return s_current; }
+
+        bool replaying() const noexcept { return m_replaying; }
+
+        void put_boolean(bool _value);
+        bool next_boolean();
+        void put_key(std::int64_t _value);
+        std::int64_t next_key();
+    };
+
+    //! @brief 記録中か再生中か
+    inline bool active() noexcept { return Session::current() != nullptr; }
+
+    /*!
+     * @brief 真偽を返す関数オブジェクトを、記録・再生を通して呼ぶ
+     * @detail どちらでもなければ、そのまま呼ぶ。再生中は呼ばない。
+     */
+    template <typename Func>
+    bool condition(Func&& _func)
+    {
+        auto session = Session::current();
+        if (!session) {
+            return static_cast<bool>(_func());
+        }
+        if (session->replaying()) {
+            return session->next_boolean();
+        }
+        auto result = static_cast<bool>(_func());
+        session->put_boolean(result);
+        return result;
+    }
+
+    //! @brief Switchのキーを、記録・再生を通して求める
+    template <typename Func>
+    auto key(Func&& _func) -> decltype(_func())
+    {
+        auto session = Session::current();
+        if (!session) {
+            return _func();
+        }
+        if (session->replaying()) {
+            return static_cast<decltype(_func())>(session->next_key());
+        }
+        auto result = _func();
+        session->put_key(static_cast<std::int64_t>(result));
+        return result;
+    }
+
+
+    /*!
+     * @brief 記録する側
+     * @detail 1回のrecord()(resume())を1周期として、結果を可変長の2進数で詰めて溜める。
+     * 溜める領域は始めに確保しておき、超えた時だけ広げる。書き出し(save)は制御ループの外で行う。
+     */
+    class Recorder : public Session
+    {
+    private:
+        std::vector<std::uint8_t> m_log;
+        std::size_t m_cycles{0};
+
+        void begin() noexcept;
+        void commit();
+
+    public:
+        //! @param _reserve 始めに確保しておく記録の大きさ[byte]
+        explicit Recorder(std::size_t _reserve = 1 << 20);
+
+        //! @brief _stepの実行を1周期として記録する(Schedulerのcycle()などを渡してもよい)
+        template <typename Step>
+        void record(Step&& _step)
+        {
+            begin();
+            try {
+                std::forward<Step>(_step)();
+            } catch (...) {
+                commit();
+                throw;
+            }
+            commit();
+        }
+        //! @brief _rootのresume()1回を記録する
+        void resume(Expr::AbstTask& _root);
+
+        std::size_t cycles() const noexcept { return m_cycles; }
+        //! @brief 記録(ヘッダ込みの2進数)
+        std::vector<std::uint8_t> data() const;
+
+        void save(std::ostream&) const;
+        //! @brief ファイルに書き出す。書けなければstd::runtime_error
+        void save(const std::string& _path) const;
+    };
+
+    /*!
+     * @brief 再生する側
+     * @detail 記録した周期を順に再生する。読み込めない記録ならstd::runtime_errorを投げる。
+     */
+    class Player : public Session
+    {
+    private:
+        std::vector<std::uint8_t> m_log;
+        std::size_t m_position;  //!< 次の周期の位置
+        std::size_t m_cycles{0};
+        std::size_t m_played{0};
+
+        //! @brief 次の周期を読み込む。もう無ければfalse
+        bool begin();
+        void finish() const;
+
+    public:
+        explicit Player(std::vector<std::uint8_t> _data);
+        static Player load(std::istream&);
+        static Player load(const std::string& _path);
+
+        /*!
+         * @brief 記録の1周期分を、_stepを実行して再生する
+         * @detail 記録の時と同じ物を渡す。もう周期が無ければ何もせずfalse。
+         * 木が記録と違う数の結果を求めたらDivergenceを投げる。
+         */
+        template <typename Step>
+        bool replay(Step&& _step)
+        {
+            if (!begin()) {
+                return false;
+            }
+            enter();
+            try {
+                std::forward<Step>(_step)();
+            } catch (...) {
+                leave();
+                throw;
+            }
+            leave();
+            finish();
+            return true;
+        }
+        //! @brief _rootのresume()1回を再生する
+        bool resume(Expr::AbstTask& _root);
+
+        std::size_t cycles() const noexcept { return m_cycles; }
+        std::size_t played() const noexcept { return m_played; }
+        std::size_t remaining() const noexcept { return m_cycles - m_played; }
+        //! @brief 最初の周期から再生し直す
+        void rewind() noexcept;
+    };
+
+}  // namespace Replay
+
+}  // namespace TaskManager
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "./task_introspection.hpp"
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+    class AbstTask;
+}
+
+namespace Profiling
+{
+    /*!
+     * @brief 評価の最中の経路を一定間隔で拾い、フレームグラフ用のfolded stack形式で書き出す
+     * @detail 根をattach()すると、根はresume()の間、評価中の節点をLiveStackに積む(節点1つにつきatomicへの数個のストア)。
+     * 別スレッドが一定間隔でそれを読み、同じ経路ごとに数える。制御スレッドは待たされず、木にもロックを掛けない。
+     * 書き込みと重なった読みは捨てる(偏りは無視できる程度)。
+     *
+     * 節点の名前は、attach()した時に木を辿って「クラス名#番号」とし、label()で付け替えられる。
+     * Switchのcaseなど実行中に作られる節点も名前を付けるなら、warm_up()の後にattach()する。
+     * 破棄する時に、まだ付いている根を外す。根を先に破棄してもよい。
+     * attach()・detach()・破棄は、根のresume()と同時に行わないこと。
+     */
+    class Sampler
+    {
+    public:
+        struct Statistics {
+            std::uint64_t samples = 0;    //!< 拾った経路の数(実行していなかったものを含む)
+            std::uint64_t idle = 0;       //!< resume()の外だったもの
+            std::uint64_t discarded = 0;  //!< 書き込みと重なって捨てたもの
+        };
+
+    private:
+        struct Root {
+            std::string name;
+            Expr::AbstTask* task;
+            std::shared_ptr<Introspection::LiveStack> stack;  //!< 付いている間は根も持つ
+            std::uint64_t idle;
+        };
+
+        std::chrono::nanoseconds m_period;
+
+        mutable std::mutex m_mutex;  //!< 以下を守る。制御スレッドは取らない
+        std::vector<Root> m_root_list;
+        std::unordered_map<Introspection::node_id, std::string> m_label;
+        std::map<std::pair<std::size_t, std::vector<Introspection::node_id>>, std::uint64_t> m_count;  //!< (根の添字, 経路)ごとの数
+        Statistics m_statistics;
+
+        std::thread m_thread;
+        std::condition_variable m_cv;
+        bool m_quit{false};
+
+        void sample_locked();
+        std::string frame(Introspection::node_id) const;
+        void run();
+
+    public:
+        //! @param _period 拾う間隔
+        explicit Sampler(std::chrono::nanoseconds _period = std::chrono::milliseconds{1}) noexcept;
+        //! @brief 拾うスレッドを止め、まだ付いている根を全て外す
+        ~Sampler() noexcept;
+
+        Sampler(const Sampler&) = delete;
+        Sampler& operator=(const Sampler&) = delete;
+
+        //! @brief 根を加え、名前を_nameとする。木の節点に名前を付けておく
+        void attach(Expr::AbstTask& _root, const std::string& _name);
+        //! @brief 根を外す。集めた数は残す
+        void detach(Expr::AbstTask& _root) noexcept;
+        //! @brief 節点の名前を付け替える(';'は':'に置き換える)
+        void label(const Expr::AbstTask& _node, const std::string& _label);
+
+        //! @brief 拾うスレッドを動かす
+        void start();
+        //! @brief 拾うスレッドを止める
+        void stop() noexcept;
+        //! @brief 今すぐ全ての根の経路を1度拾う(スレッドを使わない時に)
+        void sample();
+
+        Statistics statistics() const;
+        //! @brief 集めた数を捨てる
+        void clear();
+
+        /*!
+         * @brief "根の名前;節点;節点;... 数"の行を書き出す
+         * @detail flamegraph.plなどにそのまま渡せる。_idleならresume()の外だった分を"根の名前;[idle]"として加える。
+         */
+        void write_folded(std::ostream&, bool _idle = false) const;
+    };
+
+}  // namespace Profiling
+
+}  // namespace TaskManager
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "./abst_task.hpp"
+
+namespace TaskManager
+{
+
+//! @brief 根タスクの重要度の区分
+enum class Criticality {
+    Critical,   //!< 予算を超えても必ず毎周期実行する
+    Normal,     //!< 予算が足りなければ後の周期へ回す
+    BestEffort  //!< Normalより後に実行し、予算が足りなければ後の周期へ回す
+};
+
+/*!
+ * @brief 1周期の時間予算を見ながら根タスクをresume()するクラス
+ * @detail 根タスクはCritical, Normal, BestEffortの順、同じ区分の中では優先度の高い順に実行する。
+ * Critical以外の根は、実行しても予算内に収まる見込み(前回までの実行時間の移動平均)が無ければ、
+ * その周期は実行せずに後の周期へ回す。
+ * 同じ根が続けてmax_defer回回されたら、次の周期は予算に関わらず実行する(飢餓防止)。
+ *
+ * 実行中の木の中のDeferrableも、この予算に従って後回しにされる。
+ * 1回のcycle()は1つの制御周期(Cycle::epoch())として扱われる。
+ * 予算と見込みは周期の中で実際にかかった時間なので、仮想の時刻(VirtualTime)の下でもsteady_clockで測る。
+ * 制御スレッド1つから使う。
+ */
+class Scheduler
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    //! @brief 根1つ分の報告
+    struct RootReport {
+        int priority = 0;
+        Criticality criticality = Criticality::Normal;
+        std::size_t deferred = 0;  //!< 後回しにされた回数の累計
+        std::size_t streak = 0;    //!< 現在続けて後回しにされている回数
+        std::size_t forced = 0;    //!< 飢餓防止で予算を無視して実行した回数
+        clock::duration estimate{};  //!< 実行時間の見込み
+    };
+
+    //! @brief 全体の報告
+    struct Report {
+        std::size_t cycles = 0;
+        std::size_t over_budget = 0;        //!< 予算を超えた周期の数
+        std::size_t deferred_roots = 0;     //!< 後回しにした根の延べ数
+        std::size_t deferred_subtrees = 0;  //!< 後回しにしたDeferrableの延べ数
+        std::size_t forced = 0;             //!< 飢餓防止で予算を無視して実行した延べ数
+        clock::duration last_cycle{};
+    };
+
+private:
+    struct Root {
+        std::shared_ptr<Expr::AbstTask> task;
+        RootReport report;
+    };
+
+    clock::duration m_budget;
+    std::size_t m_max_defer;
+
+    std::vector<Root> m_root_list;  //!< 実行する順に並べておく
+    Report m_report;
+
+    clock::time_point m_deadline{};
+    std::size_t m_current{0};  //!< 実行中の根の番号
+
+    static thread_local Scheduler* s_active;
+
+    clock::duration reserve(int _priority) const noexcept;
+
+public:
+    /*!
+     * @param _budget 1周期の時間予算
+     * @param _max_defer 同じ根・Deferrableを続けて後回しにしてよい回数
+     */
+    explicit Scheduler(clock::duration _budget, std::size_t _max_defer = 10) noexcept;
+
+    virtual ~Scheduler() noexcept {}
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    /*!
+     * @brief 根タスクを加える
+     * @detail TaskSetと同じく、渡したタスクはコピー(ムーブ)される。加えた時にstart()される。
+     * @return 実際に実行されるタスク
+     */
+    template <typename TaskClass>
+    std::shared_ptr<std::decay_t<TaskClass>> add(TaskClass&& _task, int _priority = 0, Criticality _criticality = Criticality::Normal)
+    {
+        using Task = std::decay_t<TaskClass>;
+        static_assert(std::is_base_of_v<Expr::AbstTask, Task>, "Scheduler runs only tasks");
+
+        auto task = std::make_shared<Task>(std::forward<TaskClass>(_task));
+        add_root(task, _priority, _criticality);
+        return task;
+    }
+    void add_root(const std::shared_ptr<Expr::AbstTask>&, int _priority = 0, Criticality _criticality = Criticality::Normal);
+
+    //! @brief 1周期分、予算に従って根をresume()する
+    void cycle();
+
+    //! @brief まだ実行中の根が有るか
+    bool running() const noexcept;
+
+    const Report& report() const noexcept { return m_report; }
+    //! @brief 根ごとの報告(実行する順)
+    std::vector<RootReport> root_report() const;
+
+    /*!
+     * @brief 実行中のcycle()の中から、優先度_priorityで見込み_estimateの処理を今始めると予算を超えるか
+     * @detail 後に控えている、より優先度の高い根とCriticalな根の見込みも差し引いて判断する。
+     * cycle()の外で呼ばれたらfalse。_streakがmax_defer以上でもfalse(飢餓防止)。
+     */
+    static bool should_defer(int _priority, clock::duration _estimate, std::size_t _streak) noexcept;
+    //! @brief Deferrableが後回しにしたこと・飢餓防止で実行したことを数える
+    static void count_subtree(bool _deferred) noexcept;
+};
+
+}  // namespace TaskManager
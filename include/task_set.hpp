@@ -23,15 +23,15 @@ private:
     decltype(m_task_list)::size_type m_index;            //! 実行中のタスクのインデックス
 
     // AbstTaskのpublic子孫の実体型に対してのみ使用せよ
+    //     登録時に実体型を記録しているので、static_castで十分
     template <typename T>
-    struct reconstructor {
-        std::shared_ptr<AbstTask> operator()(const std::shared_ptr<AbstTask>& _ptr) noexcept(std::is_nothrow_copy_constructible<T>::value)
-        {
-            return std::shared_ptr<AbstTask>{new T{*dynamic_cast<const T*>(_ptr.get())}};
-        }
-    };
+    static std::shared_ptr<AbstTask> reconstructor(const std::shared_ptr<AbstTask>& _ptr)
+    {
+        return std::make_shared<T>(*static_cast<const T*>(_ptr.get()));
+    }
 
-    using task_reconstructor_t = std::function<std::shared_ptr<AbstTask>(const std::shared_ptr<AbstTask>&)>;
+    // 状態を持たないので、std::functionではなく関数ポインタで持つ
+    using task_reconstructor_t = std::shared_ptr<AbstTask> (*)(const std::shared_ptr<AbstTask>&);
 
     std::vector<task_reconstructor_t> m_rector_list;
 
@@ -156,7 +156,7 @@ private:
     template <typename T, typename... TaskClasses>
     void construct(T&&, TaskClasses&&...);
 
-    void reconstruct();
+    void reconstruct(const TaskSet&);
 
 public:
     virtual ~TaskSet() noexcept {}
@@ -171,6 +171,14 @@ protected:
     NextTask eval() override;
 
     void interrupt() override;
+
+    void for_each_child(const std::function<void(AbstTask&)>&) override;
+
+    //! @brief 実行中のタスクに任せる
+    std::uint64_t waiting_cycles() override;
+    void skip_waiting(std::uint64_t) override;
+
+    std::uint32_t compile(Fleet::Builder&) override;
 };
 
 }  // namespace TaskManager
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#include "./task_condition.hpp"
+
+namespace TaskManager
+{
+
+/*!
+ * @brief 1制御周期に1度だけ計算される値
+ * @detail 「グリッパーが閉じているか」のように、多くのWait・If・JumpIfから参照される値を包む。
+ * その周期で最初に呼ばれた時だけ元の関数を呼び、以降は同じ周期の間その値を返す。
+ * コピーは計算結果を共有するので、TaskSetにコピーされて何箇所に散らばっても、呼び出しは1周期に1度で済む。
+ *
+ * std::function<bool()>(CachedConditionの場合)を受け取る全ての欄へそのまま渡せるほか、
+ * Cond(signal) > 3のように条件式の葉としても使える。
+ *
+ * 周期はCycle::epoch()で判断する(AbstTask::resume()かCycle::Scopeで進む)。
+ * 値はatomicで持つので、算術型かenumに限る。
+ */
+template <typename T>
+class Signal
+{
+private:
+    struct State {
+        std::function<T()> source;
+        Expr::MemoCell<T> cell;
+
+        explicit State(std::function<T()>&& _source) noexcept : source{std::move(_source)} {}
+    };
+
+    std::shared_ptr<State> m_state;
+
+public:
+    using value_type = T;
+
+    /*!
+     * @param _source 値を計算する関数。nullptrならT{}を返し続ける
+     */
+    template <typename Func, std::enable_if_t<!std::is_same_v<std::decay_t<Func>, Signal>, std::nullptr_t> = nullptr>
+    explicit Signal(Func&& _source)
+        : m_state{std::make_shared<State>(std::function<T()>{std::forward<Func>(_source)})}
+    {
+    }
+
+    virtual ~Signal() noexcept {}
+
+    Signal(const Signal&) noexcept = default;
+    Signal& operator=(const Signal&) & noexcept = default;
+    Signal(Signal&&) noexcept = default;
+    Signal& operator=(Signal&&) & noexcept = default;
+
+    //! @brief この周期の値。まだ計算していなければここで計算する
+    T operator()() const
+    {
+        return m_state->cell.get([this] { return m_state->source ? m_state->source() : T{}; });
+    }
+
+    /*!
+     * @brief 次に呼ばれた時に計算し直させる
+     * @detail 周期の途中で元の値を書き換えた時に使う。
+     */
+    void invalidate() const noexcept { m_state->cell.invalidate(); }
+
+    //! @brief 条件式の中での同一性。コピー同士は同じものとして扱われる
+    void identify(std::string& _key) const { Expr::append_identity(_key, m_state.get()); }
+};
+
+//! @brief 1制御周期に1度だけ評価される条件
+using CachedCondition = Signal<bool>;
+
+}  // namespace TaskManager
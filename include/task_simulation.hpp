@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "./abst_task.hpp"
+#include "./task_clock.hpp"
+
+namespace TaskManager
+{
+
+/*!
+ * @brief 仮想の時刻で、実際の時間より速く木を実行する
+ * @detail Runnerは生きている間Clockを仮想の時刻に切り替え、1周期ごとに時刻を周期の長さだけ進めてから根をresume()する。
+ * 周期を待たないので、実際の時間とは関係なく、CPUの速さで進む。
+ */
+namespace Simulation
+{
+    struct Statistics {
+        std::uint64_t executed = 0;  //!< 実際に評価した周期の数
+        std::uint64_t skipped = 0;   //!< 評価せずに飛ばした周期の数
+        std::uint64_t skips = 0;     //!< まとめて飛ばした回数
+    };
+
+    /*!
+     * @brief 仮想の時刻で根を実行する
+     * @detail 全ての根がidle_cycles()で待つだけと分かる周期は、評価せずにまとめて飛ばし、
+     * 周期の番号と時刻もその分を一度に進める(Delay、Everyの番でない周期、Limitの上限までの周期など)。
+     * 飛ばした周期は、根から見て評価した時と区別が付かない。
+     *
+     * 作っている間は、Cycle::set_frequency()を周期の長さに合わせる(破棄すると戻す)。
+     * 1つのスレッドから使い、同時に2つ作らないこと。
+     */
+    class Runner
+    {
+    public:
+        /*!
+         * @brief 周期を評価する直前に呼ばれる、外界の模型
+         * @param _elapsed 前に呼ばれてからの仮想の時間(飛ばした周期の分を含む)
+         */
+        using environment_type = std::function<void(Clock::duration _elapsed)>;
+
+    private:
+        Clock::duration m_period;
+        VirtualTime m_time;
+        double m_previous_frequency;
+
+        std::vector<std::shared_ptr<Expr::AbstTask>> m_root_list;
+        environment_type m_environment{nullptr};
+        bool m_skip_idle{true};
+
+        Clock::duration m_pending{};  //!< 外界の模型にまだ渡していない時間
+        Statistics m_statistics;
+
+        void skip(std::uint64_t _cycles);
+        void execute();
+
+    public:
+        //! @param _period 1周期の長さ
+        explicit Runner(Clock::duration _period);
+        ~Runner() noexcept;
+
+        Runner(const Runner&) = delete;
+        Runner& operator=(const Runner&) = delete;
+
+        /*!
+         * @brief 根タスクを加える
+         * @detail Schedulerと同じく、渡したタスクはコピー(ムーブ)される。加えた時にstart()される。
+         * @return 実際に実行されるタスク
+         */
+        template <typename TaskClass>
+        std::shared_ptr<std::decay_t<TaskClass>> add(TaskClass&& _task)
+        {
+            using Task = std::decay_t<TaskClass>;
+            static_assert(std::is_base_of_v<Expr::AbstTask, Task>, "Runner runs only tasks");
+
+            auto task = std::make_shared<Task>(std::forward<TaskClass>(_task));
+            add_root(task);
+            return task;
+        }
+        void add_root(const std::shared_ptr<Expr::AbstTask>&);
+
+        void set_environment(environment_type _environment) { m_environment = std::move(_environment); }
+        //! @brief 何もしない周期を飛ばすか(既定はtrue)。falseなら全ての周期を評価する
+        void set_skip_idle(bool _skip_idle) noexcept { m_skip_idle = _skip_idle; }
+
+        /*!
+         * @brief 1周期を評価する。その前に何もしない周期が有れば、合わせて_max_cycles周期以下になるよう飛ばす
+         * @return 進めた周期の数(実行中の根が無ければ0)
+         */
+        std::uint64_t step(std::uint64_t _max_cycles = std::numeric_limits<std::uint64_t>::max());
+        /*!
+         * @brief 仮想の時間_durationの分(周期の長さで切り捨て)だけ進める
+         * @detail 全ての根が終われば、そこで止める。
+         * @return まだ実行中の根が有るか
+         */
+        bool run_for(Clock::duration _duration);
+        /*!
+         * @brief 全ての根が終わるまで進める。_limitの仮想の時間を過ぎたら止める
+         * @return 全ての根が終わったか
+         */
+        bool run_until_done(Clock::duration _limit);
+
+        //! @brief まだ実行中の根が有るか
+        bool running() const noexcept;
+
+        Clock::duration period() const noexcept { return m_period; }
+        Clock::time_point now() const noexcept { return Clock::now(); }
+        const Statistics& statistics() const noexcept { return m_statistics; }
+    };
+
+}  // namespace Simulation
+
+}  // namespace TaskManager
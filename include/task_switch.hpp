@@ -0,0 +1,192 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "./abst_task.hpp"
+#include "./task_set.hpp"
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+
+    /*!
+     * @brief 整数やenumの値で分岐するタスク
+     * @detail 登録された各caseの値から、構築時に表引きのテーブルを作っておき、
+     * 実行時にはキーを1度だけ評価して、条件式を順に調べることなく分岐先を決める。
+     * caseの値が密に並んでいれば配列、疎ならハッシュ表を引く。
+     * 
+     * 各caseのタスクは雛形として共有しておき、実際に分岐した時に初めてコピーして実行用に作る。
+     * その為、Switchをコピーしても、実行されていないcaseのタスクはコピーされない。
+     */
+    class Switch : public AbstTask
+    {
+    public:
+        using key_type = std::int64_t;  //!< 整数・enumはこの型に変換して扱う
+
+        //! @brief Case<key>(...)、Default(...)の返すクラス
+        struct CaseBlock {
+            std::optional<key_type> key;  //!< nulloptならDefault
+            TaskSet body;
+        };
+
+    private:
+        /*!
+         * @brief キーからcaseの番号を引く表
+         * @detail 構築後は変更しないので、コピーしたSwitch間で共有する
+         */
+        struct DispatchTable {
+            static constexpr std::size_t npos = static_cast<std::size_t>(-1);
+
+            key_type min_key{0};
+            std::vector<std::size_t> dense;                      //!< 密な場合の表。key - min_keyで引く
+            std::unordered_map<key_type, std::size_t> sparse;  //!< 疎な場合の表
+            std::size_t default_index{npos};
+
+            std::size_t find(key_type) const noexcept;
+        };
+
+        std::function<key_type()> m_key;
+        std::vector<std::shared_ptr<const TaskSet>> m_prototype_list;  //!< caseごとのタスクの雛形(共有)
+        std::shared_ptr<const DispatchTable> m_table;
+        std::vector<std::shared_ptr<TaskSet>> m_body_list;  //!< 実行用のタスク(初めて分岐した時に作る)
+        std::shared_ptr<TaskSet> m_selected_task{nullptr};  //!< 実行中のcaseのタスク
+
+    public:
+        Switch(std::function<key_type()>&&, std::vector<CaseBlock>&&);
+
+        virtual ~Switch() noexcept {}
+
+        Switch(const Switch&);
+        Switch& operator=(const Switch&) &;
+        Switch(Switch&&) noexcept;
+        Switch& operator=(Switch&&) & noexcept;
+
+    protected:
+        /*!
+         * @brief キーを評価し、分岐先を決める
+         * @detail 同じ値のcaseが複数有れば、先に登録したものが選ばれる。
+         * 該当するcaseもDefaultも無ければ、何もせずに終了する。
+         */
+        void init() override;
+        NextTask eval() override;
+
+        void interrupt() override;
+
+        /*!
+         * @brief まだ実行用に作られていないcaseは雛形を渡す
+         */
+        void for_each_child(const std::function<void(AbstTask&)>&) override;
+        //! @brief 全てのcaseの実行用のタスクを作っておく
+        void prepare() override;
+        //! @brief 実行中のcaseに任せる
+        std::uint64_t waiting_cycles() override;
+        void skip_waiting(std::uint64_t) override;
+        //! @brief caseの中身は雛形から写す
+        std::uint32_t compile(Fleet::Builder&) override;
+        //! @brief キーを1度評価し、最も重いcaseに分岐する
+        Analysis::WorstCase analyze(const Analysis::CostModel&) override;
+    };
+
+
+    template <auto Key>
+    struct CaseOperator {
+        static_assert(std::is_integral<decltype(Key)>::value || std::is_enum<decltype(Key)>::value,
+            "Case<key>: key must be an integer or an enum");
+
+        template <typename... TaskClasses>
+        Switch::CaseBlock operator()(TaskClasses&&... tasks) const
+        {
+            return {static_cast<Switch::key_type>(Key), TaskSet{std::forward<TaskClasses>(tasks)...}};
+        }
+    };
+
+
+    struct DefaultOperator {
+        template <typename... TaskClasses>
+        Switch::CaseBlock operator()(TaskClasses&&... tasks) const
+        {
+            return {std::nullopt, TaskSet{std::forward<TaskClasses>(tasks)...}};
+        }
+    };
+
+
+    class SwitchCondition
+    {
+    private:
+        std::function<Switch::key_type()> m_key;
+
+    public:
+        explicit SwitchCondition(std::function<Switch::key_type()>&&) noexcept;
+
+        virtual ~SwitchCondition() noexcept {}
+
+        SwitchCondition(const SwitchCondition&) = default;
+        SwitchCondition& operator=(const SwitchCondition&) & = default;
+        SwitchCondition(SwitchCondition&&) noexcept = default;
+        SwitchCondition& operator=(SwitchCondition&&) & noexcept = default;
+
+        template <typename... Cases>
+        Switch operator()(Cases&&...) const&;
+        template <typename... Cases>
+        Switch operator()(Cases&&...) &&;
+    };
+
+
+    /*!
+     * キーには、引数無しで呼べ、整数かenumを返す関数オブジェクトを渡す
+     */
+    struct SwitchOperator {
+    private:
+        template <typename F>
+        using key_result_t = std::remove_cv_t<std::remove_reference_t<decltype(std::declval<F&>()())>>;
+
+        template <typename F>
+        static SwitchCondition make(F&& _func)
+        {
+            static_assert(std::is_integral<key_result_t<F>>::value || std::is_enum<key_result_t<F>>::value,
+                "Switch[key]: key must return an integer or an enum");
+
+            if (is_null_callable(_func)) {
+                return SwitchCondition{nullptr};
+            }
+            return SwitchCondition{[func = std::forward<F>(_func)]() mutable { return static_cast<Switch::key_type>(func()); }};
+        }
+
+    public:
+        template <typename F>
+        SwitchCondition operator[](F&& _func) const { return make(std::forward<F>(_func)); }
+        template <typename F>
+        SwitchCondition operator()(F&& _func) const { return make(std::forward<F>(_func)); }
+    };
+
+
+    template <typename... Cases>
+    Switch SwitchCondition::operator()(Cases&&... cases) const&
+    {
+        std::vector<Switch::CaseBlock> case_list;
+        case_list.reserve(sizeof...(Cases));
+        (case_list.push_back(std::forward<Cases>(cases)), ...);
+        return Switch{std::function<Switch::key_type()>{m_key}, std::move(case_list)};
+    }
+    template <typename... Cases>
+    Switch SwitchCondition::operator()(Cases&&... cases) &&
+    {
+        std::vector<Switch::CaseBlock> case_list;
+        case_list.reserve(sizeof...(Cases));
+        (case_list.push_back(std::forward<Cases>(cases)), ...);
+        return Switch{std::move(m_key), std::move(case_list)};
+    }
+
+}  // namespace Expr
+
+constexpr Expr::SwitchOperator Switch;
+template <auto Key>
+constexpr Expr::CaseOperator<Key> Case{};
+constexpr Expr::DefaultOperator Default;
+
+}  // namespace TaskManager
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <chrono>
+#include <optional>
+
 #include "./abst_task.hpp"
+#include "./task_condition.hpp"
 #include "./task_set.hpp"
 
 namespace TaskManager
@@ -9,11 +13,91 @@ namespace TaskManager
 namespace Expr
 {
 
+    /*!
+     * @brief ループが1制御周期の間に何周してよいかを表すクラス
+     * @detail 周回数の上限と、経過時間の上限を持てる。
+     * どちらも指定しなければ1周(従来通り)。
+     * 時間だけを指定した場合、周回数は無制限となる。
+     * 両方を指定した場合は、先に達した方で打ち切る。
+     */
+    class IterationPolicy
+    {
+    public:
+        using clock = std::chrono::steady_clock;  //!< 時間の上限は1周期の中で実際に使った時間なので、仮想の時刻(Clock)ではなく実際の時計で測る
+
+    private:
+        std::optional<std::size_t> m_max_count{std::nullopt};
+        std::optional<clock::duration> m_budget{std::nullopt};
+
+    public:
+        IterationPolicy() noexcept {}
+
+        void set_count(std::size_t _count) noexcept;
+        void set_budget(clock::duration _budget) noexcept;
+
+        //! @brief 経過時間を見る必要が有るか
+        bool timed() const noexcept { return m_budget.has_value(); }
+
+        /*!
+         * @brief 次の周回に進んでよいか
+         * @param _count このサイクルで既に回った周回数
+         * @param _begin このサイクルでループを始めた時刻(timed()がfalseなら使わない)
+         */
+        bool allows(std::size_t _count, clock::time_point _begin) const noexcept;
+
+        //! @brief 1サイクルの周回数の上限。時間でしか打ち切らなければnullopt
+        std::optional<std::size_t> max_iterations() const noexcept;
+    };
+
+
+    /*!
+     * @brief ループに周回数の属性を付けるクラス
+     * @detail While[cond](...)->PerCycle(200)のように、operator->を通して使う。
+     * PerCycleはループを返すので、->PerCycle(200)->PerCycle(500us)と両方指定できる。
+     * 一時オブジェクトとして1度だけ使われる前提で、コピー・ムーブはできない。
+     */
+    template <typename LoopType>
+    class IterationAttribute
+    {
+    private:
+        LoopType m_loop;
+
+    public:
+        explicit IterationAttribute(const LoopType& _loop) : m_loop{_loop} {}
+        explicit IterationAttribute(LoopType&& _loop) noexcept(std::is_nothrow_move_constructible<LoopType>::value) : m_loop{std::move(_loop)} {}
+
+        virtual ~IterationAttribute() noexcept {}
+
+        IterationAttribute(const IterationAttribute&) = delete;
+        IterationAttribute& operator=(const IterationAttribute&) = delete;
+
+        IterationAttribute* operator->() noexcept { return this; }
+
+        //! @brief 1サイクルに最大_count周する(0は1とみなす)
+        LoopType PerCycle(std::size_t _count)
+        {
+            m_loop.m_policy.set_count(_count);
+            return std::move(m_loop);
+        }
+        //! @brief 1サイクルの中で_budgetを使い切るまで周回する
+        template <typename Rep, typename Period>
+        LoopType PerCycle(std::chrono::duration<Rep, Period> _budget)
+        {
+            m_loop.m_policy.set_budget(std::chrono::duration_cast<IterationPolicy::clock::duration>(_budget));
+            return std::move(m_loop);
+        }
+    };
+
+
     class While : public AbstTask
     {
+        template <typename>
+        friend class IterationAttribute;
+
     protected:
         std::function<bool()> m_condition;
         TaskSet m_taskset;
+        IterationPolicy m_policy;  //!< 1サイクル当たりの周回数
 
     private:
         bool m_should_eval;  //!< 実行中かを示すフラグ
@@ -31,11 +115,33 @@ namespace Expr
         While(While&&) noexcept(std::is_nothrow_move_constructible<TaskSet>::value);
         While& operator=(While&&) & noexcept(std::is_nothrow_move_assignable<TaskSet>::value);
 
+        IterationAttribute<While> operator->() const&;
+        IterationAttribute<While> operator->() && noexcept(std::is_nothrow_move_constructible<TaskSet>::value);
+
     protected:
         void init() override;
         NextTask eval() override;
 
+        /*!
+         * @brief 周回数の属性に従って、本体と条件判定を繰り返す
+         * @detail 本体が終了しなかったか、属性の上限に達したらfalseを返す。
+         * 条件が偽となってループを抜けるならtrueを返す。
+         */
+        bool iterate();
+
         void interrupt() override;
+
+        void for_each_child(const std::function<void(AbstTask&)>&) override;
+        //! @brief 本体の実行中なら本体に任せる(本体が終わるまで条件は判定しないので)
+        std::uint64_t waiting_cycles() override;
+        void skip_waiting(std::uint64_t) override;
+        std::uint32_t compile(Fleet::Builder&) override;
+        //! @brief _checks_firstなら、最初の周回の前にも条件を判定する節点として写す(Whileはする、DoWhileはしない)
+        std::uint32_t compile_loop(Fleet::Builder&, bool _checks_first);
+        //! @brief 周回数の上限だけ、本体と条件判定を繰り返す
+        Analysis::WorstCase analyze(const Analysis::CostModel&) override;
+        //! @brief _checks_firstなら、最初の周回の前にも条件を判定する(Whileはする、DoWhileはしない)
+        Analysis::WorstCase analyze_loop(const Analysis::CostModel&, bool _checks_first);
     };
 
 
@@ -75,6 +181,12 @@ namespace Expr
         WhileCondition operator[](std::function<bool()>&&) const& noexcept;
         WhileCondition operator()(const std::function<bool()>&) const& noexcept;
         WhileCondition operator()(std::function<bool()>&&) const& noexcept;
+
+        //! @brief 条件式の否定を式の中で行い、ラムダで包み直さない
+        template <typename Node>
+        WhileCondition operator[](const CondExpr<Node>& _expr) const& { return WhileCondition{!_expr}; }
+        template <typename Node>
+        WhileCondition operator()(const CondExpr<Node>& _expr) const& { return WhileCondition{!_expr}; }
     };
 
 
@@ -99,6 +211,12 @@ namespace Expr
 
 
     struct WaitOperator {
+        //! @brief 条件式の否定を式の中で行い、ラムダで包み直さない
+        template <typename Node>
+        While operator[](const CondExpr<Node>& _expr) const { return While{!_expr, {}}; }
+        template <typename Node>
+        While operator()(const CondExpr<Node>& _expr) const { return While{!_expr, {}}; }
+
         While operator[](const std::function<bool()>& _func) const noexcept
         {
             if (_func) {
@@ -1,9 +1,15 @@
 #include "abst_task.hpp"
-
+#include "task_analysis.hpp"
+#include "task_cycle.hpp"
+#include "task_fleet.hpp"
+#include "task_log.hpp"
+#include "task_metrics.hpp"
+#include "task_observer.hpp"
+#include "task_profiler.hpp"
+#include "task_realtime.hpp"
+
+#include <chrono>
 #include <exception>
-#include <iostream>
-
-// TODO: AbstTask::force_quitでcerr使用中
 
 namespace TaskManager
 {
@@ -11,10 +17,19 @@ namespace TaskManager
 namespace Expr
 {
 
+    struct AbstTask::RootState {
+        std::shared_ptr<Introspection::ActivePath> active_path_owner{nullptr};  //!< 公開している実行中の経路
+        std::atomic<Introspection::ActivePath*> active_path{nullptr};           //!< resume()から見る、active_path_ownerの中身
+        std::atomic<Metrics::RootMetrics*> metrics{nullptr};                    //!< 書き込む共有メモリ上の統計
+        std::shared_ptr<Introspection::LiveStack> live_stack_owner{nullptr};    //!< 書き込む評価の最中の経路
+        std::atomic<Introspection::LiveStack*> live_stack{nullptr};             //!< resume()から見る、live_stack_ownerの中身
+    };
+
 
     AbstTask::~AbstTask() noexcept
     {
         force_quit(*this);
+        delete m_root_state.load(std::memory_order_acquire);
     }
 
     AbstTask::AbstTask(const AbstTask& _other) noexcept
@@ -88,6 +103,9 @@ namespace Expr
         m_task_on_eval->m_manager = nullptr;
 
         if (auto next = result.pointer()) {  // 次のタスクを指定
+            if constexpr (Observer::enabled) {
+                Observer::Active::on_scene(*this, *m_task_on_eval, *next);
+            }
             m_task_on_eval = next;
             return false;
 
@@ -102,17 +120,45 @@ namespace Expr
 
     NextTask AbstTask::evaluate_task()
     {
+        auto tracker = Introspection::PathTracker::current();
+        auto depth = tracker ? tracker->enter(m_node_id) : 0;
+
         if (!m_me_on_eval) {
+            if constexpr (Observer::enabled) {
+                Observer::Active::on_init(*this);
+            }
             init();
             m_me_on_eval = true;
         }
 
-        if (auto result = eval()) {
+        auto profiler = Profiling::Profiler::current();
+        auto frame = profiler ? profiler->enter(m_node_id) : Profiling::Profiler::npos;
+        if constexpr (Observer::enabled) {
+            Observer::Active::on_eval(*this);
+        }
+        auto result = eval();
+        if constexpr (Observer::enabled) {
+            Observer::Active::on_eval_end(*this, static_cast<bool>(result));
+        }
+        if (profiler) {
+            profiler->leave(frame);
+        }
+
+        if (result) {
             m_me_on_eval = false;
+            if constexpr (Observer::enabled) {
+                Observer::Active::on_quit(*this);
+            }
             quit();
+            if (tracker) {
+                tracker->leave(depth, false);
+            }
             return result;
         }
 
+        if (tracker) {
+            tracker->leave(depth, true);
+        }
         return false;
     }
 
@@ -121,6 +167,23 @@ namespace Expr
         _task.force_quit_machine();
     }
 
+    std::uint64_t AbstTask::waiting_cycles_of(AbstTask& _task)
+    {
+        std::lock_guard<std::mutex> lock{_task.m_machine_mutex};
+
+        auto& task = *_task.m_task_on_eval;
+        return task.m_me_on_eval ? task.waiting_cycles() : 0;
+    }
+    void AbstTask::skip_waiting_of(AbstTask& _task, std::uint64_t _cycles)
+    {
+        std::lock_guard<std::mutex> lock{_task.m_machine_mutex};
+
+        auto& task = *_task.m_task_on_eval;
+        if (task.m_me_on_eval) {
+            task.skip_waiting(_cycles);
+        }
+    }
+
     void AbstTask::force_quit_machine() noexcept
     {
         std::lock_guard<std::mutex> lock{m_machine_mutex};
@@ -139,6 +202,9 @@ namespace Expr
 #ifdef NDEBUG
             try {
 #endif
+                if constexpr (Observer::enabled) {
+                    Observer::Active::on_interrupt(*this);
+                }
                 interrupt();
                 if (interrupt_func) {
                     interrupt_func();
@@ -146,11 +212,12 @@ namespace Expr
 
 #ifdef NDEBUG
             } catch (const std::exception& e) {
-                std::cerr << "error occurred during a task's force_quit...\n"
-                          << e.what() << std::endl;
+                static Log::Site site{Log::Level::Error, "error occurred during a task's force_quit()"};
+                Log::post(site, e.what());
 
             } catch (...) {
-                std::cerr << "error occurred during a task's force_quit()...\n(not an instance of std::exception 's derived class)" << std::endl;
+                static Log::Site site{Log::Level::Error, "error occurred during a task's force_quit() (not an instance of std::exception 's derived class)"};
+                Log::post(site);
             }
 #endif
         }
@@ -159,7 +226,8 @@ namespace Expr
     void AbstTask::start() noexcept
     {
         if (m_running) {
-            std::cerr << "start() a task which has already started" << std::endl;
+            static Log::Site site{Log::Level::Warning, "start() a task which has already started"};
+            Log::post(site);
             return;
         }
 
@@ -168,9 +236,25 @@ namespace Expr
     void AbstTask::resume()
     {
         if (m_running) {
+            RealTime::ResumeScope scope;
+            auto root_state = m_root_state.load(std::memory_order_acquire);
+            auto metrics = root_state ? root_state->metrics.load(std::memory_order_acquire) : nullptr;
+            Metrics::Scope metrics_scope{metrics};
+            Introspection::PathTracker tracker{root_state ? root_state->active_path.load(std::memory_order_acquire) : nullptr, metrics != nullptr,
+                root_state ? root_state->live_stack.load(std::memory_order_acquire) : nullptr};
+            auto begin = metrics ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point{};
+            Cycle::advance_unless_scoped();
+
             auto finish = evaluate_as_manager(*m_machine_on_eval);
 
             if (m_jump_task) {
+                // OneWayジャンプは、より優先度の高いものに上書きされ得るので、実際に移る時に数える
+                if (metrics && m_priority) {
+                    metrics->record_jump(m_priority.value());
+                }
+                if constexpr (Observer::enabled) {
+                    Observer::Active::on_scene(*this, *m_machine_on_eval, *m_jump_task);
+                }
                 force_quit(*m_machine_on_eval);
                 m_machine_on_eval = std::move(m_jump_task);
 
@@ -181,12 +265,129 @@ namespace Expr
 
             m_priority = std::nullopt;
             m_jump_task = nullptr;
+
+            tracker.publish();
+            if (metrics) {
+                auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin);
+                metrics->record(static_cast<std::uint64_t>(latency.count()), tracker.evaluations(), tracker.leaf(), tracker.depth());
+            }
+        }
+    }
+    std::uint64_t AbstTask::idle_cycles()
+    {
+        return m_running ? waiting_cycles_of(*m_machine_on_eval) : 0;
+    }
+    void AbstTask::skip_cycles(std::uint64_t _cycles)
+    {
+        if (m_running && _cycles > 0) {
+            skip_waiting_of(*m_machine_on_eval, _cycles);
+        }
+    }
+    void AbstTask::warm_up()
+    {
+        prepare();
+        for_each_child([](AbstTask& _child) { _child.warm_up(); });
+    }
+    void AbstTask::visit(const std::function<void(AbstTask&)>& _func)
+    {
+        _func(*this);
+        for_each_child([&_func](AbstTask& _child) { _child.visit(_func); });
+    }
+
+    namespace
+    {
+        // 根としての情報を作るのは根ごとに1度きりなので、全ての根で1つのmutexを使う
+        std::mutex& root_state_mutex()
+        {
+            static std::mutex mutex;
+            return mutex;
+        }
+    }  // namespace
+
+    AbstTask::RootState& AbstTask::root_state()
+    {
+        if (auto state = m_root_state.load(std::memory_order_acquire)) {
+            return *state;
+        }
+
+        std::lock_guard<std::mutex> lock{root_state_mutex()};
+        auto state = m_root_state.load(std::memory_order_acquire);
+        if (!state) {
+            state = new RootState;
+            m_root_state.store(state, std::memory_order_release);
+        }
+        return *state;
+    }
+
+    std::shared_ptr<const Introspection::ActivePath> AbstTask::active_path()
+    {
+        auto& state = root_state();
+        std::lock_guard<std::mutex> lock{root_state_mutex()};
+
+        if (!state.active_path_owner) {
+            state.active_path_owner = std::make_shared<Introspection::ActivePath>();
+            state.active_path.store(state.active_path_owner.get(), std::memory_order_release);
+        }
+        return state.active_path_owner;
+    }
+
+    void AbstTask::publish_metrics(Metrics::RootMetrics* _metrics)
+    {
+        if (!_metrics && !m_root_state.load(std::memory_order_acquire)) {
+            return;
+        }
+        root_state().metrics.store(_metrics, std::memory_order_release);
+    }
+    void AbstTask::publish_live_stack(std::shared_ptr<Introspection::LiveStack> _stack)
+    {
+        if (!_stack && !m_root_state.load(std::memory_order_acquire)) {
+            return;
+        }
+        auto& state = root_state();
+        std::lock_guard<std::mutex> lock{root_state_mutex()};
+
+        state.live_stack.store(_stack.get(), std::memory_order_release);
+        state.live_stack_owner = std::move(_stack);
+    }
+
+    Analysis::WorstCase AbstTask::worst_case(const Analysis::CostModel& _model)
+    {
+        if (_model.annotate) {
+            if (auto cost = _model.annotate(*this)) {
+                Analysis::WorstCase result;
+                result.leaf_calls = 1;
+                result.cost = cost.value();
+                result.path.push_back(Analysis::type_name(*this) + ": annotated");
+                return result;
+            }
         }
+        return analyze(_model);
+    }
+    std::uint32_t AbstTask::compile(Fleet::Builder& _builder)
+    {
+        _builder.unsupported(*this);
     }
+    Analysis::WorstCase AbstTask::analyze(const Analysis::CostModel& _model)
+    {
+        Analysis::WorstCase result;
+        result.add_node(_model);
+
+        auto has_child = false;
+        for_each_child([&](AbstTask& _child) {
+            result += _child.worst_case(_model);
+            has_child = true;
+        });
+        if (!has_child) {
+            result.add_leaf(_model);
+        }
+        return result;
+    }
+
     void AbstTask::stop() noexcept
     {
         if (!m_running) {
-            std::cerr << "stop() a task which has already stopped" << std::endl;
+            static Log::Site site{Log::Level::Warning, "stop() a task which has already stopped"};
+            Log::post(site);
             return;
         }
 
@@ -1,4 +1,6 @@
 #include "task.hpp"
+#include "task_fleet.hpp"
+#include "task_replay.hpp"
 
 namespace TaskManager
 {
@@ -31,7 +33,16 @@ Task& Task::operator=(Task&& _other) & noexcept
 NextTask Task::eval()
 {
     // std::functionはnullptrも格納できるので、チェック
-    return m_function && m_function();
+    return m_function && Replay::condition(m_function);
+}
+
+std::uint32_t Task::compile(Fleet::Builder& _builder)
+{
+    auto index = _builder.open(Fleet::Op::Leaf, false);
+    if (m_function) {
+        _builder.node(index).function = _builder.function(m_function);
+    }
+    return index;
 }
 
 }  // namespace TaskManager
@@ -0,0 +1,165 @@
+#include "task_adaptive.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+
+    std::atomic<bool> ConditionStatistics::s_frozen_all{false};
+
+    ConditionStatistics::ConditionStatistics(std::size_t _size)
+        : m_counter_list{new Counter[_size]},
+          m_size{_size},
+          m_last_order(_size)
+    {
+        std::iota(m_last_order.begin(), m_last_order.end(), std::size_t{0});
+    }
+
+    ConditionStatistics::Snapshot ConditionStatistics::snapshot()
+    {
+        Snapshot result{{}, {}, m_reorders.load(std::memory_order_relaxed), frozen()};
+
+        result.entries.reserve(m_size);
+        for (std::size_t i{0}; i < m_size; ++i) {
+            auto& counter = m_counter_list[i];
+            auto timed = counter.timed.load(std::memory_order_relaxed);
+            auto cost = counter.cost_ns.load(std::memory_order_relaxed);
+
+            result.entries.push_back({counter.evaluations.load(std::memory_order_relaxed),
+                counter.hits.load(std::memory_order_relaxed),
+                std::chrono::nanoseconds{timed == 0 ? 0 : static_cast<std::int64_t>(cost / timed)}});
+        }
+
+        std::lock_guard<std::mutex> lock{m_order_mutex};
+        result.order = m_last_order;
+        return result;
+    }
+
+
+    void ConditionStatistics::resize(std::size_t _size)
+    {
+        std::unique_ptr<Counter[]> counter_list{new Counter[_size]};
+        for (std::size_t i{0}; i < std::min(m_size, _size); ++i) {
+            auto& from = m_counter_list[i];
+            auto& to = counter_list[i];
+            to.evaluations.store(from.evaluations.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            to.hits.store(from.hits.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            to.timed.store(from.timed.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            to.cost_ns.store(from.cost_ns.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        m_counter_list = std::move(counter_list);
+        m_size = _size;
+
+        std::lock_guard<std::mutex> lock{m_order_mutex};
+        m_last_order.erase(std::remove_if(m_last_order.begin(), m_last_order.end(), [_size](std::size_t _index) { return _index >= _size; }), m_last_order.end());
+        for (auto index = m_last_order.size(); index < _size; ++index) {
+            m_last_order.push_back(index);
+        }
+    }
+
+
+    AdaptiveOrder::AdaptiveOrder(std::size_t _size)
+        : m_statistics{std::make_shared<ConditionStatistics>(_size)},
+          m_order(_size),
+          m_counter_list(_size),
+          m_score(_size),
+          m_next_order(_size)
+    {
+        std::iota(m_order.begin(), m_order.end(), std::size_t{0});
+    }
+
+    // 統計は共有し、まだ書き込んでいない数え上げは持ち越さない
+    AdaptiveOrder::AdaptiveOrder(const AdaptiveOrder& _other)
+        : m_statistics{_other.m_statistics},
+          m_order{_other.m_order},
+          m_counter_list(_other.m_counter_list.size()),
+          m_score(_other.m_score.size()),
+          m_next_order(_other.m_next_order.size())
+    {
+    }
+    AdaptiveOrder& AdaptiveOrder::operator=(const AdaptiveOrder& _other) &
+    {
+        m_statistics = _other.m_statistics;
+        m_order = _other.m_order;
+        m_counter_list.assign(_other.m_counter_list.size(), LocalCounter{});
+        m_calls = 0;
+        m_score.resize(_other.m_score.size());
+        m_next_order.resize(_other.m_next_order.size());
+        return *this;
+    }
+
+    void AdaptiveOrder::resize(std::size_t _size)
+    {
+        m_statistics->resize(_size);
+
+        m_order.erase(std::remove_if(m_order.begin(), m_order.end(), [_size](std::size_t _index) { return _index >= _size; }), m_order.end());
+        for (auto index = m_order.size(); index < _size; ++index) {
+            m_order.push_back(index);
+        }
+        m_counter_list.resize(_size);
+        m_score.resize(_size);
+        m_next_order.resize(_size);
+    }
+
+    void AdaptiveOrder::reorder()
+    {
+        auto& statistics = *m_statistics;
+
+        // 溜めた数え上げを共有の統計へ書き込む
+        for (std::size_t i{0}; i < m_counter_list.size(); ++i) {
+            auto& local = m_counter_list[i];
+            auto& shared = statistics.m_counter_list[i];
+
+            shared.evaluations.fetch_add(local.evaluations, std::memory_order_relaxed);
+            shared.hits.fetch_add(local.hits, std::memory_order_relaxed);
+            shared.timed.fetch_add(local.timed, std::memory_order_relaxed);
+            shared.cost_ns.fetch_add(local.cost_ns, std::memory_order_relaxed);
+            local = LocalCounter{};
+        }
+
+        if (statistics.frozen()) {
+            return;
+        }
+
+        // 真になる確率 / 評価時間 の大きい順
+        //     評価回数の少ない条件式の確率は、1/2に寄せて見積もる
+        for (std::size_t i{0}; i < m_score.size(); ++i) {
+            auto& shared = statistics.m_counter_list[i];
+            auto evaluations = static_cast<double>(shared.evaluations.load(std::memory_order_relaxed));
+            auto hits = static_cast<double>(shared.hits.load(std::memory_order_relaxed));
+            auto timed = shared.timed.load(std::memory_order_relaxed);
+            auto cost = timed == 0 ? 1.0 : static_cast<double>(shared.cost_ns.load(std::memory_order_relaxed)) / static_cast<double>(timed);
+
+            m_score[i] = (hits + 1.0) / (evaluations + 2.0) / std::max(cost, 1.0);
+        }
+
+        // 条件式は高々数十個なので挿入ソートで十分(安定で、ヒープも使わない)
+        std::copy(m_order.begin(), m_order.end(), m_next_order.begin());
+        for (std::size_t i{1}; i < m_next_order.size(); ++i) {
+            auto index = m_next_order[i];
+            auto j = i;
+            for (; j > 0 && m_score[m_next_order[j - 1]] < m_score[index]; --j) {
+                m_next_order[j] = m_next_order[j - 1];
+            }
+            m_next_order[j] = index;
+        }
+
+        if (m_next_order != m_order) {
+            m_order.swap(m_next_order);
+            statistics.m_reorders.fetch_add(1, std::memory_order_relaxed);
+
+            // 制御を止めないよう、取れなければsnapshot用の記録は諦める
+            std::unique_lock<std::mutex> lock{statistics.m_order_mutex, std::try_to_lock};
+            if (lock) {
+                statistics.m_last_order = m_order;
+            }
+        }
+    }
+
+}  // namespace Expr
+
+}  // namespace TaskManager
@@ -0,0 +1,117 @@
+#include "task_analysis.hpp"
+
+#include <algorithm>
+#include <typeinfo>
+
+#ifdef __GNUG__
+#include <cstdlib>
+#include <cxxabi.h>
+#endif
+
+namespace TaskManager
+{
+
+namespace Analysis
+{
+    void WorstCase::add_leaf(const CostModel& _model, std::size_t _count)
+    {
+        leaf_calls += _count;
+        cost += _model.leaf * static_cast<double>(_count);
+    }
+    void WorstCase::add_condition(const CostModel& _model, std::size_t _count)
+    {
+        condition_evals += _count;
+        cost += _model.condition * static_cast<double>(_count);
+    }
+    void WorstCase::add_interrupt(const CostModel& _model, std::size_t _count)
+    {
+        interrupts += _count;
+        cost += _model.interrupt * static_cast<double>(_count);
+    }
+    void WorstCase::add_node(const CostModel& _model)
+    {
+        ++nodes;
+        cost += _model.node;
+    }
+
+    WorstCase& WorstCase::operator+=(const WorstCase& _other)
+    {
+        leaf_calls += _other.leaf_calls;
+        condition_evals += _other.condition_evals;
+        interrupts += _other.interrupts;
+        nodes += _other.nodes;
+        cost += _other.cost;
+        bounded = bounded && _other.bounded;
+        may_switch_scene = may_switch_scene || _other.may_switch_scene;
+        path.insert(path.end(), _other.path.begin(), _other.path.end());
+        return *this;
+    }
+
+    WorstCase WorstCase::repeated(std::size_t _count) const
+    {
+        auto result = *this;
+        result.leaf_calls *= _count;
+        result.condition_evals *= _count;
+        result.interrupts *= _count;
+        result.nodes *= _count;
+        result.cost *= static_cast<double>(_count);
+        return result;
+    }
+
+    WorstCase WorstCase::larger(WorstCase&& _a, WorstCase&& _b)
+    {
+        auto& result = _a.cost < _b.cost ? _b : _a;
+        result.bounded = _a.bounded && _b.bounded;
+        result.may_switch_scene = _a.may_switch_scene || _b.may_switch_scene;
+        return std::move(result);
+    }
+
+
+    std::string type_name(const Expr::AbstTask& _task)
+    {
+        auto name = typeid(_task).name();
+        std::string result;
+#ifdef __GNUG__
+        int status = 0;
+        if (auto demangled = abi::__cxa_demangle(name, nullptr, nullptr, &status)) {
+            result = demangled;
+            std::free(demangled);
+        } else {
+            result = name;
+        }
+#else
+        result = name;
+#endif
+
+        for (auto prefix : {"TaskManager::Expr::", "TaskManager::"}) {
+            std::string::size_type found;
+            while ((found = result.find(prefix)) != std::string::npos) {
+                result.erase(found, std::char_traits<char>::length(prefix));
+            }
+        }
+        return result;
+    }
+
+    std::size_t interrupt_cascade(Expr::AbstTask& _task)
+    {
+        // 実行中の子は高々1つなので、最も深い子の分だけ連鎖する
+        std::size_t deepest = 0;
+        _task.for_each_child([&deepest](Expr::AbstTask& _child) {
+            deepest = std::max(deepest, interrupt_cascade(_child));
+        });
+        return deepest + 1;
+    }
+
+    WorstCase worst_case(Expr::AbstTask& _root, const CostModel& _model)
+    {
+        auto result = _root.worst_case(_model);
+        if (result.may_switch_scene) {  // resume()が木全体をforce_quitして切り替える
+            result.add_interrupt(_model, interrupt_cascade(_root));
+            result.path.push_back("scene switch: interrupt whole tree");
+        }
+        return result;
+    }
+
+}  // namespace Analysis
+
+}  // namespace TaskManager
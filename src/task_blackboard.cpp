@@ -0,0 +1,20 @@
+#include "task_blackboard.hpp"
+
+namespace TaskManager
+{
+
+std::shared_ptr<Blackboard::AbstSlot> Blackboard::find_slot(const std::string& _name) const noexcept
+{
+    auto it = m_slot_map.find(_name);
+    if (it == m_slot_map.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void Blackboard::add_slot(const std::string& _name, std::shared_ptr<AbstSlot>&& _slot)
+{
+    m_slot_map.emplace(_name, std::move(_slot));
+}
+
+}  // namespace TaskManager
@@ -0,0 +1,54 @@
+#include "task_clock.hpp"
+
+#include <atomic>
+
+namespace TaskManager
+{
+
+namespace
+{
+    std::atomic<bool> s_virtual{false};
+    std::atomic<Clock::rep> s_now{0};  //!< 仮想の時刻(time_since_epochの値)
+}
+
+Clock::time_point Clock::now() noexcept
+{
+    if (s_virtual.load(std::memory_order_acquire)) {
+        return time_point{duration{s_now.load(std::memory_order_acquire)}};
+    }
+    return std::chrono::steady_clock::now();
+}
+
+bool Clock::is_virtual() noexcept
+{
+    return s_virtual.load(std::memory_order_acquire);
+}
+
+void Clock::advance(duration _duration) noexcept
+{
+    if (s_virtual.load(std::memory_order_acquire)) {
+        s_now.fetch_add(_duration.count(), std::memory_order_acq_rel);
+    }
+}
+
+
+VirtualTime::VirtualTime() noexcept
+    : VirtualTime{Clock::now()}
+{
+}
+
+VirtualTime::VirtualTime(Clock::time_point _start) noexcept
+    : m_previous_virtual{s_virtual.load(std::memory_order_acquire)},
+      m_previous_now{s_now.load(std::memory_order_acquire)}
+{
+    s_now.store(_start.time_since_epoch().count(), std::memory_order_release);
+    s_virtual.store(true, std::memory_order_release);
+}
+
+VirtualTime::~VirtualTime() noexcept
+{
+    s_now.store(m_previous_now, std::memory_order_release);
+    s_virtual.store(m_previous_virtual, std::memory_order_release);
+}
+
+}  // namespace TaskManager
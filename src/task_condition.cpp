@@ -0,0 +1,50 @@
+#include "task_condition.hpp"
+
+#include <mutex>
+#include <unordered_map>
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+
+    namespace
+    {
+        std::mutex s_memo_mutex;
+        std::unordered_map<std::string, std::weak_ptr<void>> s_memo_table;
+
+        std::atomic<std::uint64_t> s_condition_id{1};
+    }
+
+    std::shared_ptr<void> find_memo_cell(const std::string& _key, std::shared_ptr<void> (*_make)())
+    {
+        std::lock_guard<std::mutex> lock{s_memo_mutex};
+
+        auto& entry = s_memo_table[_key];
+        if (auto cell = entry.lock()) {
+            return cell;
+        }
+
+        // 使われなくなった領域の項目は、ここでまとめて片付ける
+        for (auto it = s_memo_table.begin(); it != s_memo_table.end();) {
+            if (it->second.expired() && &it->second != &entry) {
+                it = s_memo_table.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        auto cell = _make();
+        entry = cell;
+        return cell;
+    }
+
+    std::uint64_t issue_condition_id() noexcept
+    {
+        return s_condition_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+}  // namespace Expr
+
+}  // namespace TaskManager
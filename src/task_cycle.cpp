@@ -0,0 +1,62 @@
+#include "task_cycle.hpp"
+
+#include <atomic>
+
+namespace TaskManager
+{
+
+namespace Cycle
+{
+    namespace
+    {
+        std::atomic<epoch_type> s_epoch{1};  // 0は「まだ評価していない」の意味に使えるよう空けておく
+        std::atomic<int> s_scope_depth{0};
+        std::atomic<double> s_frequency{1000.0};
+    }
+
+    epoch_type epoch() noexcept
+    {
+        return s_epoch.load(std::memory_order_acquire);
+    }
+
+    void advance() noexcept
+    {
+        s_epoch.fetch_add(1, std::memory_order_acq_rel);
+    }
+    void advance(epoch_type _count) noexcept
+    {
+        s_epoch.fetch_add(_count, std::memory_order_acq_rel);
+    }
+
+    void advance_unless_scoped() noexcept
+    {
+        if (s_scope_depth.load(std::memory_order_acquire) == 0) {
+            advance();
+        }
+    }
+
+    void set_frequency(double _hz) noexcept
+    {
+        if (_hz > 0.0) {
+            s_frequency.store(_hz, std::memory_order_relaxed);
+        }
+    }
+    double frequency() noexcept
+    {
+        return s_frequency.load(std::memory_order_relaxed);
+    }
+
+    Scope::Scope() noexcept
+    {
+        if (s_scope_depth.fetch_add(1, std::memory_order_acq_rel) == 0) {
+            advance();
+        }
+    }
+    Scope::~Scope() noexcept
+    {
+        s_scope_depth.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+}  // namespace Cycle
+
+}  // namespace TaskManager
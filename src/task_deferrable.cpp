@@ -0,0 +1,96 @@
+#include "task_deferrable.hpp"
+#include "task_replay.hpp"
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+
+    Deferrable::Deferrable(int _priority, TaskSet&& _taskset)
+        : m_taskset{std::move(_taskset)},
+          m_priority{_priority},
+          m_statistics{std::make_shared<DeferStatistics>()}
+    {
+    }
+
+    Deferrable::Deferrable(const Deferrable& _other)
+        : AbstTask{_other},
+          m_taskset{_other.m_taskset},
+          m_priority{_other.m_priority},
+          m_estimate{_other.m_estimate},
+          m_statistics{_other.m_statistics}
+    {
+    }
+    Deferrable& Deferrable::operator=(const Deferrable& _other) &
+    {
+        AbstTask::operator=(_other);
+        m_taskset = _other.m_taskset;
+        m_priority = _other.m_priority;
+        m_estimate = _other.m_estimate;
+        m_streak = 0;
+        m_statistics = _other.m_statistics;
+        return *this;
+    }
+    Deferrable::Deferrable(Deferrable&& _other) noexcept
+        : AbstTask{std::move(_other)},
+          m_taskset{std::move(_other.m_taskset)},
+          m_priority{_other.m_priority},
+          m_estimate{_other.m_estimate},
+          m_statistics{std::move(_other.m_statistics)}
+    {
+    }
+    Deferrable& Deferrable::operator=(Deferrable&& _other) & noexcept
+    {
+        AbstTask::operator=(std::move(_other));
+        m_taskset = std::move(_other.m_taskset);
+        m_priority = _other.m_priority;
+        m_estimate = _other.m_estimate;
+        m_streak = 0;
+        m_statistics = std::move(_other.m_statistics);
+        return *this;
+    }
+
+
+    void Deferrable::init()
+    {
+        m_streak = 0;
+    }
+
+    NextTask Deferrable::eval()
+    {
+        if (Replay::condition([this] { return Scheduler::should_defer(m_priority, m_estimate, m_streak); })) {
+            ++m_streak;
+            ++m_statistics->deferred;
+            Scheduler::count_subtree(true);
+            return false;
+        }
+        if (m_streak > 0 && Scheduler::should_defer(m_priority, m_estimate, 0)) {  // 飢餓防止で実行する
+            ++m_statistics->forced;
+            Scheduler::count_subtree(false);
+        }
+        m_streak = 0;
+        ++m_statistics->evaluated;
+
+        auto begin = Scheduler::clock::now();
+        auto finish = evaluate(m_taskset);
+        auto elapsed = Scheduler::clock::now() - begin;
+        m_estimate = m_estimate == Scheduler::clock::duration::zero() ? elapsed : (m_estimate * 7 + elapsed) / 8;
+
+        return finish;
+    }
+
+    void Deferrable::interrupt()
+    {
+        force_quit(m_taskset);
+        quit();
+    }
+
+    void Deferrable::for_each_child(const std::function<void(AbstTask&)>& _func)
+    {
+        _func(m_taskset);
+    }
+
+}  // namespace Expr
+
+}  // namespace TaskManager
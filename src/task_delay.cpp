@@ -1,4 +1,5 @@
 #include "task_delay.hpp"
+#include "task_fleet.hpp"
 
 namespace TaskManager
 {
@@ -45,4 +46,20 @@ NextTask Delay::eval() noexcept
     return ++m_count > m_delay;
 }
 
+std::uint64_t Delay::waiting_cycles() noexcept
+{
+    return m_count < m_delay ? static_cast<std::uint64_t>(m_delay - m_count) : 0;
+}
+void Delay::skip_waiting(std::uint64_t _cycles) noexcept
+{
+    m_count += static_cast<int>(_cycles);
+}
+
+std::uint32_t Delay::compile(Fleet::Builder& _builder)
+{
+    auto index = _builder.open(Fleet::Op::Delay, true);
+    _builder.node(index).parameter = m_delay;
+    return index;
+}
+
 }  // namespace TaskManager
@@ -1,4 +1,5 @@
 #include "task_do.hpp"
+#include "task_analysis.hpp"
 
 namespace TaskManager
 {
@@ -44,75 +45,103 @@ namespace Expr
 
     NextTask DoWhile::eval()
     {
-        return evaluate(m_taskset) && !(m_condition && m_condition());
+        // 条件判定の前に必ず1度は実行する点以外はWhileと同じ
+        return iterate();
     }
 
-
-    DoTaskSet::DoTaskSet(const std::shared_ptr<TaskSet>& _task) noexcept
-        : While{_task},
-          Until{_task}
+    std::uint64_t DoWhile::waiting_cycles()
     {
+        return waiting_cycles_of(m_taskset);
     }
-    DoTaskSet::DoTaskSet(std::shared_ptr<TaskSet>&& _task) noexcept
-        : While{_task},
-          Until{std::move(_task)}
+    std::uint32_t DoWhile::compile(Fleet::Builder& _builder)
     {
+        return compile_loop(_builder, false);
     }
 
+    Analysis::WorstCase DoWhile::analyze(const Analysis::CostModel& _model)
+    {
+        return analyze_loop(_model, false);
+    }
 
-    DoTaskSet::WhileClass::WhileClass(const std::shared_ptr<TaskSet>& _task) noexcept
-        : m_taskset{_task}
+    IterationAttribute<DoWhile> DoWhile::operator->() const&
+    {
+        return IterationAttribute<DoWhile>{*this};
+    }
+    IterationAttribute<DoWhile> DoWhile::operator->() && noexcept(std::is_nothrow_move_constructible<While>::value)
     {
+        return IterationAttribute<DoWhile>{std::move(*this)};
     }
-    DoTaskSet::WhileClass::WhileClass(std::shared_ptr<TaskSet>&& _task) noexcept
+
+
+    DoTaskSet::DoTaskSet(TaskSet&& _task) noexcept
         : m_taskset{std::move(_task)}
     {
     }
 
-    DoWhile DoTaskSet::WhileClass::operator[](const std::function<bool()>& _func) const
+    DoTaskSet::DoTaskSet(const DoTaskSet& _other)
+        : m_taskset{_other.m_taskset}
     {
-        return DoWhile(*m_taskset, _func);
     }
-    DoWhile DoTaskSet::WhileClass::operator[](std::function<bool()>&& _func) const
+    DoTaskSet& DoTaskSet::operator=(const DoTaskSet& _other) &
     {
-        return DoWhile(*m_taskset, std::move(_func));
+        m_taskset = _other.m_taskset;
+        return *this;
     }
-    DoWhile DoTaskSet::WhileClass::operator()(const std::function<bool()>& _func) const
+    DoTaskSet::DoTaskSet(DoTaskSet&& _other) noexcept
+        : m_taskset{std::move(_other.m_taskset)}
     {
-        return DoWhile(*m_taskset, _func);
     }
-    DoWhile DoTaskSet::WhileClass::operator()(std::function<bool()>&& _func) const
+    DoTaskSet& DoTaskSet::operator=(DoTaskSet&& _other) & noexcept
+    {
+        m_taskset = std::move(_other.m_taskset);
+        return *this;
+    }
+
+    DoTaskSet::DoChain DoTaskSet::operator->() && noexcept
     {
-        return DoWhile(*m_taskset, std::move(_func));
+        return DoChain{std::move(m_taskset)};
     }
 
 
-    DoTaskSet::UntilClass::UntilClass(const std::shared_ptr<TaskSet>& _task) noexcept
-        : WhileClass{_task}
+    DoTaskSet::DoChain::DoChain(TaskSet&& _task) noexcept
+        : m_taskset{std::move(_task)}
     {
     }
-    DoTaskSet::UntilClass::UntilClass(std::shared_ptr<TaskSet>&& _task) noexcept
-        : WhileClass{std::move(_task)}
+
+
+    DoTaskSet::WhileClass::WhileClass(TaskSet& _task, bool _disposable) noexcept
+        : m_taskset{_task},
+          m_disposable{_disposable}
     {
     }
 
-    DoTaskSet::UntilClass::UntilClass(const UntilClass& _other) noexcept
-        : WhileClass(_other)
+    DoWhile DoTaskSet::WhileClass::operator[](const std::function<bool()>& _func) const
     {
+        if (m_disposable) {
+            return DoWhile(std::move(m_taskset), _func);
+        }
+        return DoWhile(m_taskset, _func);
     }
-    DoTaskSet::UntilClass& DoTaskSet::UntilClass::operator=(const UntilClass& _other) & noexcept
+    DoWhile DoTaskSet::WhileClass::operator[](std::function<bool()>&& _func) const
     {
-        WhileClass::operator=(_other);
-        return *this;
+        if (m_disposable) {
+            return DoWhile(std::move(m_taskset), std::move(_func));
+        }
+        return DoWhile(m_taskset, std::move(_func));
     }
-    DoTaskSet::UntilClass::UntilClass(UntilClass&& _other) noexcept
-        : WhileClass(std::move(_other))
+    DoWhile DoTaskSet::WhileClass::operator()(const std::function<bool()>& _func) const
     {
+        return operator[](_func);
     }
-    DoTaskSet::UntilClass& DoTaskSet::UntilClass::operator=(UntilClass&& _other) & noexcept
+    DoWhile DoTaskSet::WhileClass::operator()(std::function<bool()>&& _func) const
+    {
+        return operator[](std::move(_func));
+    }
+
+
+    DoTaskSet::UntilClass::UntilClass(TaskSet& _task, bool _disposable) noexcept
+        : WhileClass{_task, _disposable}
     {
-        WhileClass::operator=(std::move(_other));
-        return *this;
     }
 
     // clang-format off
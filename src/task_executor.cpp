@@ -0,0 +1,220 @@
+#include "task_executor.hpp"
+#include "task_cycle.hpp"
+#include "task_realtime.hpp"
+
+#include <algorithm>
+
+namespace TaskManager
+{
+
+Executor::Executor(std::size_t _workers, std::vector<int> _cpus)
+{
+    if (_workers == 0) {
+        _workers = 1;
+    }
+    if (_cpus.empty()) {
+        auto hardware = std::max(std::thread::hardware_concurrency(), 1u);
+        for (unsigned int i = 0; i < std::min<std::size_t>(_workers, hardware); ++i) {
+            _cpus.push_back(static_cast<int>(i));
+        }
+    }
+
+    m_shard_list.reserve(_workers);
+    for (std::size_t i = 0; i < _workers; ++i) {
+        m_shard_list.push_back(std::make_unique<Shard>());
+    }
+    m_thread_list.reserve(_workers);
+    for (std::size_t i = 0; i < _workers; ++i) {
+        m_thread_list.emplace_back(&Executor::work, this, i, _cpus[i % _cpus.size()]);
+    }
+}
+
+Executor::~Executor() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_quit = true;
+    }
+    m_start_cv.notify_all();
+    for (auto& thread : m_thread_list) {
+        thread.join();
+    }
+}
+
+
+void Executor::add_root(const std::shared_ptr<Expr::AbstTask>& _task)
+{
+    if (!_task) {
+        return;
+    }
+    _task->start();
+
+    auto shard = std::min_element(m_shard_list.begin(), m_shard_list.end(),
+        [](const auto& _a, const auto& _b) { return _a->roots.size() < _b->roots.size(); });
+    (*shard)->roots.push_back(_task);
+}
+
+
+void Executor::cycle()
+{
+    auto begin = clock::now();
+    Cycle::Scope scope;
+
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto& shard : m_shard_list) {
+            shard->cursor.store(0, std::memory_order_relaxed);
+            shard->stolen_from.store(0, std::memory_order_relaxed);
+        }
+        m_remaining = m_shard_list.size();
+        ++m_generation;
+    }
+    m_start_cv.notify_all();
+
+    {
+        std::unique_lock<std::mutex> lock{m_mutex};
+        m_done_cv.wait(lock, [this] { return m_remaining == 0; });
+    }
+    auto end = clock::now();
+    m_last_cycle = end - begin;
+
+    for (auto& shard : m_shard_list) {
+        shard->report.barrier_wait = end - shard->finish;
+        shard->report.total_barrier_wait += shard->report.barrier_wait;
+    }
+
+    rebalance();
+
+    std::exception_ptr error{nullptr};
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        std::swap(error, m_error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+
+void Executor::work(std::size_t _index, int _cpu)
+{
+    auto pinned = RealTime::pin_current_thread(_cpu);
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_shard_list[_index]->report.cpu = pinned ? _cpu : -1;
+    }
+
+    std::uint64_t seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            m_start_cv.wait(lock, [this, seen] { return m_quit || m_generation != seen; });
+            if (m_quit) {
+                return;
+            }
+            seen = m_generation;
+        }
+
+        run_shard(_index);
+
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_shard_list[_index]->finish = clock::now();
+            if (--m_remaining == 0) {
+                m_done_cv.notify_one();
+            }
+        }
+    }
+}
+
+void Executor::run_shard(std::size_t _index)
+{
+    auto& own = *m_shard_list[_index];
+    auto begin = clock::now();
+    std::size_t executed = 0;
+    std::size_t stolen = 0;
+
+    for (std::size_t k; (k = own.cursor.fetch_add(1, std::memory_order_relaxed)) < own.roots.size();) {
+        resume_root(*own.roots[k]);
+        ++executed;
+    }
+
+    // 自分の担当を終えたら、隣から順に残りを盗む
+    for (std::size_t offset = 1; offset < m_shard_list.size(); ++offset) {
+        auto& other = *m_shard_list[(_index + offset) % m_shard_list.size()];
+        for (std::size_t k; (k = other.cursor.fetch_add(1, std::memory_order_relaxed)) < other.roots.size();) {
+            resume_root(*other.roots[k]);
+            other.stolen_from.fetch_add(1, std::memory_order_relaxed);
+            ++executed;
+            ++stolen;
+        }
+    }
+
+    own.report.roots = own.roots.size();
+    own.report.executed = executed;
+    own.report.stolen = stolen;
+    own.report.busy = clock::now() - begin;
+    own.report.total_busy += own.report.busy;
+}
+
+void Executor::resume_root(Expr::AbstTask& _task)
+{
+    try {
+        _task.resume();
+    } catch (...) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (!m_error) {
+            m_error = std::current_exception();
+        }
+    }
+}
+
+void Executor::rebalance()
+{
+    // 盗まれた担当から、最も暇だったワーカーへ、盗まれた数の半分を付け替える
+    for (auto& shard : m_shard_list) {
+        auto stolen = shard->stolen_from.load(std::memory_order_relaxed);
+        if (stolen < 2) {
+            continue;
+        }
+
+        auto idle = std::min_element(m_shard_list.begin(), m_shard_list.end(),
+            [](const auto& _a, const auto& _b) { return _a->report.busy < _b->report.busy; });
+        if (idle->get() == shard.get()) {
+            continue;
+        }
+
+        auto move_count = std::min(stolen / 2, shard->roots.size());
+        auto first = shard->roots.end() - static_cast<std::ptrdiff_t>(move_count);
+        (*idle)->roots.insert((*idle)->roots.end(), first, shard->roots.end());
+        shard->roots.erase(first, shard->roots.end());
+    }
+    for (auto& shard : m_shard_list) {
+        shard->report.roots = shard->roots.size();
+    }
+}
+
+
+bool Executor::running() const noexcept
+{
+    for (auto& shard : m_shard_list) {
+        for (auto& root : shard->roots) {
+            if (root->running()) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+std::vector<Executor::WorkerReport> Executor::report() const
+{
+    std::vector<WorkerReport> result;
+    result.reserve(m_shard_list.size());
+    for (auto& shard : m_shard_list) {
+        result.push_back(shard->report);
+    }
+    return result;
+}
+
+}  // namespace TaskManager
@@ -0,0 +1,630 @@
+#include "task_fleet.hpp"
+#include "abst_task.hpp"
+#include "task_analysis.hpp"
+#include "task_cycle.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+namespace TaskManager
+{
+
+namespace Fleet
+{
+    namespace
+    {
+        thread_local instance_id s_current{0};
+    }
+
+    instance_id current() noexcept
+    {
+        return s_current;
+    }
+
+    bool Batch::operator()() const
+    {
+        auto id = current();
+        bool result = false;
+        m_function(&id, 1, &result);
+        return result;
+    }
+
+    const char* op_name(Op _op) noexcept
+    {
+        switch (_op) {
+        case Op::Sequence:
+            return "TaskSet";
+        case Op::Leaf:
+            return "Task";
+        case Op::Delay:
+            return "Delay";
+        case Op::While:
+            return "While";
+        case Op::DoWhile:
+            return "DoWhile";
+        case Op::If:
+            return "If";
+        case Op::Switch:
+            return "Switch";
+        case Op::Every:
+            return "Every";
+        default:
+            return "?";
+        }
+    }
+
+
+    std::uint32_t Program::SwitchTable::find(std::int64_t _key) const noexcept
+    {
+        auto found = std::lower_bound(cases.begin(), cases.end(), _key, [](const std::pair<std::int64_t, std::uint32_t>& _case, std::int64_t _value) { return _case.first < _value; });
+        if (found != cases.end() && found->first == _key) {
+            return found->second;
+        }
+        return default_case;
+    }
+
+    std::shared_ptr<const Program> Program::compile(Expr::AbstTask& _root)
+    {
+        auto program = std::make_shared<Program>();
+        Builder builder{*program};
+        builder.add(_root);
+        return program;
+    }
+
+    std::size_t Program::shared_bytes() const noexcept
+    {
+        auto bytes = sizeof(Program)
+                     + m_node_list.capacity() * sizeof(Node)
+                     + m_child_list.capacity() * sizeof(std::uint32_t)
+                     + m_function_list.capacity() * sizeof(std::function<bool()>)
+                     + m_batch_list.capacity() * sizeof(Batch::function_type)
+                     + m_switch_list.capacity() * sizeof(SwitchTable);
+        for (auto& table : m_switch_list) {
+            bytes += table.cases.capacity() * sizeof(table.cases.front());
+        }
+        return bytes;
+    }
+
+    std::vector<std::size_t> Program::op_count() const
+    {
+        std::vector<std::size_t> result(static_cast<std::size_t>(Op::count_), 0);
+        for (auto& node : m_node_list) {
+            ++result[static_cast<std::size_t>(node.op)];
+        }
+        return result;
+    }
+
+
+    std::uint32_t Builder::add(Expr::AbstTask& _task)
+    {
+        return _task.compile(*this);
+    }
+
+    std::uint32_t Builder::open(Op _op, bool _stateful)
+    {
+        Program::Node node;
+        node.op = _op;
+        if (_stateful) {
+            node.slot = m_program.m_slot_count++;
+        }
+        m_program.m_node_list.push_back(node);
+        return static_cast<std::uint32_t>(m_program.m_node_list.size() - 1);
+    }
+
+    void Builder::set_children(std::uint32_t _index, const std::vector<std::uint32_t>& _children)
+    {
+        auto& node = m_program.m_node_list[_index];
+        node.first_child = static_cast<std::uint32_t>(m_program.m_child_list.size());
+        node.child_count = static_cast<std::uint32_t>(_children.size());
+        m_program.m_child_list.insert(m_program.m_child_list.end(), _children.begin(), _children.end());
+    }
+
+    std::uint32_t Builder::function(std::function<bool()> _function)
+    {
+        auto batch = _function.target<Batch>();
+        m_program.m_batch_list.push_back(batch ? Batch::function_type{*batch} : Batch::function_type{});
+        m_program.m_function_list.push_back(std::move(_function));
+        return static_cast<std::uint32_t>(m_program.m_function_list.size() - 1);
+    }
+
+    std::uint32_t Builder::switch_table(Program::SwitchTable _table)
+    {
+        std::sort(_table.cases.begin(), _table.cases.end());
+        m_program.m_switch_list.push_back(std::move(_table));
+        return static_cast<std::uint32_t>(m_program.m_switch_list.size() - 1);
+    }
+
+    void Builder::unsupported(const Expr::AbstTask& _task) const
+    {
+        throw Unsupported{"fleet: " + Analysis::type_name(_task) + " cannot be compiled into a program"};
+    }
+
+
+    Population::Population(std::shared_ptr<const Program> _program, std::size_t _size)
+        : m_program{std::move(_program)},
+          m_size{_size},
+          m_slot_count{m_program->slot_count()},
+          m_state(_size * m_program->slot_count(), 0),
+          m_running(_size, 0)
+    {
+    }
+
+    void Population::start() noexcept
+    {
+        std::fill(m_state.begin(), m_state.end(), 0);
+        std::fill(m_running.begin(), m_running.end(), 1);
+        m_running_count = m_size;
+        m_epoch = Cycle::epoch();
+    }
+
+    void Population::step()
+    {
+        Cycle::advance();
+        ++m_epoch;
+
+        auto previous = s_current;
+        for (std::size_t i = 0; i < m_size; ++i) {
+            if (!m_running[i]) {
+                continue;
+            }
+            s_current = static_cast<instance_id>(i);
+            if (evaluate(0, m_state.data() + i * m_slot_count)) {
+                m_running[i] = 0;
+                --m_running_count;
+            }
+        }
+        s_current = previous;
+    }
+
+    bool Population::evaluate(std::uint32_t _index, std::uint32_t* _state)
+    {
+        auto& node = m_program->node(_index);
+        if (node.slot != Program::npos && _state[node.slot] == 0) {
+            init(node, _state);
+        }
+
+        auto finished = eval(node, _state);
+        if (finished && node.slot != Program::npos) {
+            _state[node.slot] = 0;
+        }
+        return finished;
+    }
+
+    void Population::init(const Program::Node& _node, std::uint32_t* _state)
+    {
+        auto& state = _state[_node.slot];
+        switch (_node.op) {
+        case Op::While: {
+            state = _node.function != Program::npos && m_program->function(_node.function)() ? 2 : 1;  // 2なら本体を実行する
+            break;
+        }
+        case Op::If: {
+            state = _node.child_count + 1;  // 当てはまる節が無い
+            for (std::uint32_t i = 0; i < _node.child_count; ++i) {
+                auto& condition = m_program->function(_node.function + i);
+                if (condition && condition()) {
+                    state = i + 1;
+                    break;
+                }
+            }
+            break;
+        }
+        case Op::Switch: {
+            auto& table = m_program->switch_table(_node.function);
+            auto index = table.key ? table.find(table.key()) : Program::npos;
+            state = (index == Program::npos ? _node.child_count : index) + 1;
+            break;
+        }
+        default:  // TaskSetは0番目から、Delayは0周期から
+            state = 1;
+            break;
+        }
+    }
+
+    bool Population::iterate(const Program::Node& _node, std::uint32_t* _state)
+    {
+        auto begin = _node.policy.timed() ? Expr::IterationPolicy::clock::now() : Expr::IterationPolicy::clock::time_point{};
+        auto body = m_program->child(_node, 0);
+        for (std::size_t count{1};; ++count) {
+            if (!evaluate(body, _state)) {
+                return false;
+            }
+            if (_node.function == Program::npos || !m_program->function(_node.function)()) {
+                return true;
+            }
+            if (!_node.policy.allows(count, begin)) {
+                return false;
+            }
+        }
+    }
+
+    bool Population::eval(const Program::Node& _node, std::uint32_t* _state)
+    {
+        switch (_node.op) {
+        case Op::Sequence: {
+            auto& state = _state[_node.slot];
+            for (auto i = state - 1; i < _node.child_count; ++i) {
+                if (!evaluate(m_program->child(_node, i), _state)) {
+                    state = i + 1;
+                    return false;
+                }
+            }
+            return true;
+        }
+        case Op::Leaf:
+            return _node.function != Program::npos && m_program->function(_node.function)();
+        case Op::Delay:
+            return static_cast<std::int64_t>(_state[_node.slot]++) > _node.parameter;
+        case Op::While:
+            return _state[_node.slot] == 1 || iterate(_node, _state);
+        case Op::DoWhile:
+            return iterate(_node, _state);
+        case Op::If:
+        case Op::Switch: {
+            auto selected = _state[_node.slot] - 1;
+            return selected >= _node.child_count || evaluate(m_program->child(_node, selected), _state);
+        }
+        case Op::Every:
+            if (static_cast<std::int64_t>(m_epoch % static_cast<Cycle::epoch_type>(_node.parameter)) != _node.phase) {
+                return false;
+            }
+            return evaluate(m_program->child(_node, 0), _state);
+        default:
+            return true;
+        }
+    }
+
+
+    Lockstep::Lockstep(std::shared_ptr<const Program> _program, std::size_t _size)
+        : m_program{std::move(_program)},
+          m_size{_size},
+          m_state(_size * m_program->slot_count(), 0),
+          m_running(_size, 0),
+          m_scratch(_size),
+          m_result{new bool[_size]}
+    {
+        std::uint32_t max_children = 0;
+        for (std::uint32_t i = 0; i < m_program->size(); ++i) {
+            max_children = std::max(max_children, m_program->node(i).child_count);
+        }
+        m_bucket.resize(max_children + 2);
+        m_active.reserve(_size);
+    }
+
+    void Lockstep::start()
+    {
+        std::fill(m_state.begin(), m_state.end(), 0);
+        std::fill(m_running.begin(), m_running.end(), 1);
+        m_active.resize(m_size);
+        std::iota(m_active.begin(), m_active.end(), instance_id{0});
+        m_epoch = Cycle::epoch();
+    }
+
+    void Lockstep::step()
+    {
+        Cycle::advance();
+        ++m_epoch;
+
+        auto previous = s_current;
+        auto count = m_active.size();
+        m_reordered = false;
+        auto finished = evaluate(0, m_active.data(), count);
+        s_current = previous;
+
+        // 評価の間に順が入れ替わっていれば、実行中の印から番号の順に並べ直す
+        if (finished == 0 && !m_reordered) {
+            return;
+        }
+        for (auto i = count - finished; i < count; ++i) {
+            m_running[m_active[i]] = 0;
+        }
+        std::size_t running = 0;
+        for (std::size_t i = 0; i < m_size; ++i) {
+            m_scratch[running] = static_cast<instance_id>(i);
+            running += m_running[i];
+        }
+        m_active.assign(m_scratch.begin(), m_scratch.begin() + static_cast<std::ptrdiff_t>(running));
+    }
+
+    std::size_t Lockstep::evaluate(std::uint32_t _index, instance_id* _ids, std::size_t _count)
+    {
+        if (_count == 0) {
+            return 0;
+        }
+
+        auto& node = m_program->node(_index);
+        auto finished = eval(node, _ids, _count);
+        if (finished > 0 && node.slot != Program::npos) {
+            auto words = state(node);
+            for (auto i = _count - finished; i < _count; ++i) {
+                words[_ids[i]] = 0;
+            }
+        }
+        return finished;
+    }
+
+    void Lockstep::init(const Program::Node& _node, instance_id* _ids, std::size_t _count)
+    {
+        auto words = state(_node);
+        switch (_node.op) {
+        case Op::While:
+            if (_node.function == Program::npos) {
+                for (std::size_t i = 0; i < _count; ++i) {
+                    words[_ids[i]] = 1;
+                }
+                break;
+            }
+            call(_node.function, _ids, _count);
+            for (std::size_t i = 0; i < _count; ++i) {
+                words[_ids[i]] = m_result[i] ? 2 : 1;  // 2なら本体を実行する
+            }
+            break;
+        case Op::If: {
+            // 当てはまらなかった実体だけを、並びの前に詰めて次の条件へ回す
+            auto rest = _ids;
+            auto pending = _count;
+            for (std::uint32_t branch = 0; branch < _node.child_count && pending > 0; ++branch) {
+                if (!m_program->function(_node.function + branch)) {
+                    continue;
+                }
+                call(_node.function + branch, rest, pending);
+                std::size_t next = 0;
+                for (std::size_t i = 0; i < pending; ++i) {
+                    if (m_result[i]) {
+                        words[rest[i]] = branch + 1;
+                    } else {
+                        rest[next++] = rest[i];
+                    }
+                }
+                pending = next;
+            }
+            for (std::size_t i = 0; i < pending; ++i) {
+                words[rest[i]] = _node.child_count + 1;  // 当てはまる節が無い
+            }
+            break;
+        }
+        case Op::Switch: {
+            auto& table = m_program->switch_table(_node.function);
+            for (std::size_t i = 0; i < _count; ++i) {
+                s_current = _ids[i];
+                auto index = table.key ? table.find(table.key()) : Program::npos;
+                words[_ids[i]] = (index == Program::npos ? _node.child_count : index) + 1;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    std::size_t Lockstep::eval(const Program::Node& _node, instance_id* _ids, std::size_t _count)
+    {
+        switch (_node.op) {
+        case Op::Sequence: {
+            if (_node.child_count == 0) {
+                return _count;
+            }
+            // initと、揃って同じ位置に居るかの確かめを1度に行う
+            auto words = state(_node);
+            auto first = std::max<std::uint32_t>(words[_ids[0]], 1);
+            bool aligned = true;
+            for (std::size_t i = 0; i < _count; ++i) {
+                auto& word = words[_ids[i]];
+                word += word == 0;
+                aligned &= word == first;
+            }
+            if (!aligned) {
+                group(_ids, _count, words, _node.child_count);
+            }
+
+            // i番目の子には、i番目に居た実体と、手前の子を終えた実体をまとめて渡す
+            std::size_t low = 0, high = 0;
+            for (std::uint32_t i = 0; i < _node.child_count; ++i) {
+                while (high < _count && words[_ids[high]] == i + 1) {
+                    ++high;
+                }
+                if (low == high) {
+                    continue;
+                }
+                auto finished = evaluate(m_program->child(_node, i), _ids + low, high - low);
+                for (auto j = low; j < high - finished; ++j) {
+                    words[_ids[j]] = i + 1;
+                }
+                low = high - finished;
+            }
+            return _count - low;
+        }
+        case Op::Leaf:
+            if (_node.function == Program::npos) {
+                return 0;
+            }
+            call(_node.function, _ids, _count);
+            return partition(_ids, _count, true);
+        case Op::Delay: {
+            // initと数え上げを1度に行う
+            auto words = state(_node);
+            std::size_t finished = 0;
+            for (std::size_t i = 0; i < _count; ++i) {
+                auto& word = words[_ids[i]];
+                word += word == 0;
+                auto done = static_cast<std::int64_t>(word++) > _node.parameter;
+                m_result[i] = done;
+                finished += done;
+            }
+            return finished > 0 ? partition(_ids, _count, true) : 0;
+        }
+        case Op::While: {
+            // initが要る実体を集めながら、始めに条件が偽だった実体(本体を実行せずに終わる)を数える
+            auto words = state(_node);
+            auto pending_ids = m_scratch.data();
+            std::size_t pending = 0, skipped = 0;
+            for (std::size_t i = 0; i < _count; ++i) {
+                auto word = words[_ids[i]];
+                pending_ids[pending] = _ids[i];
+                pending += word == 0;
+                skipped += word == 1;
+            }
+            if (pending > 0) {
+                init(_node, pending_ids, pending);
+                for (std::size_t i = 0; i < pending; ++i) {
+                    skipped += words[pending_ids[i]] == 1;
+                }
+            }
+            if (skipped > 0) {
+                for (std::size_t i = 0; i < _count; ++i) {
+                    m_result[i] = words[_ids[i]] == 1;
+                }
+                partition(_ids, _count, true);
+            }
+            return skipped + iterate(_node, _ids, _count - skipped);
+        }
+        case Op::DoWhile:  // 状態の語は使わないので、initは要らない
+            return iterate(_node, _ids, _count);
+        case Op::If:
+        case Op::Switch:
+            return select(_node, _ids, _count);
+        case Op::Every:
+            if (static_cast<std::int64_t>(m_epoch % static_cast<Cycle::epoch_type>(_node.parameter)) != _node.phase) {
+                return 0;
+            }
+            return evaluate(m_program->child(_node, 0), _ids, _count);
+        default:
+            return _count;
+        }
+    }
+
+    std::size_t Lockstep::iterate(const Program::Node& _node, instance_id* _ids, std::size_t _count)
+    {
+        if (_count == 0) {
+            return 0;
+        }
+
+        // 時間で区切るループは、周回の時間を実体ごとに測る
+        if (_node.policy.timed() && _count > 1) {
+            auto end = _count;
+            for (std::size_t i = 0; i < end;) {
+                if (iterate(_node, _ids + i, 1) > 0) {
+                    std::swap(_ids[i], _ids[--end]);
+                    m_reordered = true;
+                } else {
+                    ++i;
+                }
+            }
+            return _count - end;
+        }
+
+        // [0, low)は終わらなかった実体、[low, high)は周回中の実体、[high, _count)は終わった実体
+        auto begin = _node.policy.timed() ? Expr::IterationPolicy::clock::now() : Expr::IterationPolicy::clock::time_point{};
+        auto body = m_program->child(_node, 0);
+        std::size_t low = 0, high = _count;
+        for (std::size_t count{1};; ++count) {
+            auto finished = evaluate(body, _ids + low, high - low);
+            low = high - finished;
+            if (low == high) {
+                break;
+            }
+            if (_node.function == Program::npos) {
+                high = low;
+                break;
+            }
+            call(_node.function, _ids + low, high - low);
+            high -= partition(_ids + low, high - low, false);
+            if (low == high) {
+                break;
+            }
+            if (!_node.policy.allows(count, begin)) {
+                low = high;
+                break;
+            }
+        }
+        return _count - high;
+    }
+
+    std::size_t Lockstep::select(const Program::Node& _node, instance_id* _ids, std::size_t _count)
+    {
+        // initが要る実体を集めながら、揃って同じ節を選んでいるかを確かめる
+        auto words = state(_node);
+        auto first = words[_ids[0]];
+        bool aligned = true;
+        std::size_t pending = 0;
+        for (std::size_t i = 0; i < _count; ++i) {
+            auto word = words[_ids[i]];
+            m_scratch[pending] = _ids[i];
+            pending += word == 0;
+            aligned &= word == first;
+        }
+        if (pending > 0) {
+            init(_node, m_scratch.data(), pending);
+            aligned = false;
+        }
+        if (!aligned) {
+            group(_ids, _count, words, _node.child_count + 1);
+        }
+
+        // 選んだ節ごとに評価し、終わらなかった実体を前へ寄せていく。当てはまる節が無い実体は末尾に残り、終わる
+        std::size_t unfinished = 0, high = 0;
+        for (std::uint32_t i = 0; i < _node.child_count; ++i) {
+            auto low = high;
+            while (high < _count && words[_ids[high]] == i + 1) {
+                ++high;
+            }
+            if (low == high) {
+                continue;
+            }
+            auto finished = evaluate(m_program->child(_node, i), _ids + low, high - low);
+            if (unfinished != low) {
+                std::rotate(_ids + unfinished, _ids + low, _ids + (high - finished));
+                m_reordered = true;
+            }
+            unfinished += high - finished - low;
+        }
+        return _count - unfinished;
+    }
+
+    void Lockstep::call(std::uint32_t _function, const instance_id* _ids, std::size_t _count)
+    {
+        if (auto& batch = m_program->batch(_function)) {
+            batch(_ids, _count, m_result.get());
+            return;
+        }
+        auto& function = m_program->function(_function);
+        for (std::size_t i = 0; i < _count; ++i) {
+            s_current = _ids[i];
+            m_result[i] = function();
+        }
+    }
+
+    std::size_t Lockstep::partition(instance_id* _ids, std::size_t _count, bool _value)
+    {
+        // 寄せる実体が無ければ並びに触らない
+        auto front = static_cast<std::size_t>(std::find(m_result.get(), m_result.get() + _count, _value) - m_result.get());
+        std::size_t back = 0;
+        for (auto i = front; i < _count; ++i) {
+            if (m_result[i] == _value) {
+                m_scratch[back++] = _ids[i];
+            } else {
+                _ids[front++] = _ids[i];
+            }
+        }
+        std::copy(m_scratch.begin(), m_scratch.begin() + static_cast<std::ptrdiff_t>(back), _ids + front);
+        m_reordered |= back > 0;
+        return back;
+    }
+
+    void Lockstep::group(instance_id* _ids, std::size_t _count, const std::uint32_t* _state, std::uint32_t _key_count)
+    {
+        std::fill(m_bucket.begin(), m_bucket.begin() + _key_count + 1, 0);
+        for (std::size_t i = 0; i < _count; ++i) {
+            ++m_bucket[_state[_ids[i]]];
+        }
+        std::partial_sum(m_bucket.begin(), m_bucket.begin() + _key_count + 1, m_bucket.begin());
+        for (auto i = _count; i-- > 0;) {
+            m_scratch[--m_bucket[_state[_ids[i]]]] = _ids[i];
+        }
+        std::copy(m_scratch.begin(), m_scratch.begin() + static_cast<std::ptrdiff_t>(_count), _ids);
+        m_reordered = true;
+    }
+
+}  // namespace Fleet
+
+}  // namespace TaskManager
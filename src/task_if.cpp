@@ -1,4 +1,7 @@
 #include "task_if.hpp"
+#include "task_analysis.hpp"
+#include "task_fleet.hpp"
+#include "task_replay.hpp"
 
 namespace TaskManager
 {
@@ -6,18 +9,31 @@ namespace TaskManager
 namespace Expr
 {
 
-    IfElse::IfElse(const condition_list_type& _cond_list)
-        : m_condition_list{_cond_list}
+    IfElse::IfElse(const condition_list_type& _cond_list, bool _exclusive)
+        : IfElse{condition_list_type{_cond_list}, _exclusive, true}
     {
     }
-    IfElse::IfElse(condition_list_type&& _cond_list) noexcept
-        : m_condition_list{std::move(_cond_list)}
+    IfElse::IfElse(condition_list_type&& _cond_list, bool _exclusive)
+        : IfElse{std::move(_cond_list), _exclusive, true}
     {
     }
+    IfElse::IfElse(condition_list_type&& _cond_list, bool _exclusive, bool _has_else)
+        : m_condition_list{std::move(_cond_list)},
+          m_exclusive{_exclusive},
+          m_adaptive_order{std::nullopt}
+    {
+        if (m_exclusive) {
+            // Else節は並べ替えない
+            auto size = m_condition_list.size();
+            m_adaptive_order.emplace(_has_else && size > 0 ? size - 1 : size);
+        }
+    }
 
     IfElse::IfElse(const IfElse& _other)
         : AbstTask{_other},
-          m_condition_list{_other.m_condition_list}
+          m_condition_list{_other.m_condition_list},
+          m_exclusive{_other.m_exclusive},
+          m_adaptive_order{_other.m_adaptive_order}
     {
     }
     IfElse& IfElse::operator=(const IfElse& _other) &
@@ -25,11 +41,15 @@ namespace Expr
         AbstTask::operator=(_other);
         m_condition_list = _other.m_condition_list;
         m_selected_task = nullptr;
+        m_exclusive = _other.m_exclusive;
+        m_adaptive_order = _other.m_adaptive_order;
         return *this;
     }
     IfElse::IfElse(IfElse&& _other) noexcept
         : AbstTask{std::move(_other)},
-          m_condition_list{std::move(_other.m_condition_list)}
+          m_condition_list{std::move(_other.m_condition_list)},
+          m_exclusive{_other.m_exclusive},
+          m_adaptive_order{std::move(_other.m_adaptive_order)}
     {
     }
     IfElse& IfElse::operator=(IfElse&& _other) & noexcept
@@ -37,16 +57,40 @@ namespace Expr
         AbstTask::operator=(std::move(_other));
         m_condition_list = std::move(_other.m_condition_list);
         m_selected_task = nullptr;
+        m_exclusive = _other.m_exclusive;
+        m_adaptive_order = std::move(_other.m_adaptive_order);
         return *this;
     }
 
+    std::shared_ptr<ConditionStatistics> IfElse::statistics() const noexcept
+    {
+        if (m_adaptive_order) {
+            return m_adaptive_order->statistics();
+        }
+        return nullptr;
+    }
+
     void IfElse::init()
     {
         m_selected_task = nullptr;
 
+        if (m_adaptive_order) {
+            auto found = m_adaptive_order->find_first([this](std::size_t _index) {
+                auto& cond = m_condition_list[_index].first;
+                return cond && Replay::condition(cond);
+            });
+
+            if (found) {
+                m_selected_task = std::shared_ptr<TaskSet>{std::shared_ptr<TaskSet>{nullptr}, &m_condition_list[found.value()].second};
+            } else if (m_adaptive_order->statistics()->size() < m_condition_list.size()) {  // Else節
+                m_selected_task = std::shared_ptr<TaskSet>{std::shared_ptr<TaskSet>{nullptr}, &m_condition_list.back().second};
+            }
+            return;
+        }
+
         for (auto& cond_pair : m_condition_list) {
             // 条件が真を示したら
-            if (cond_pair.first && cond_pair.first()) {
+            if (cond_pair.first && Replay::condition(cond_pair.first)) {
                 // ポインタを持ちながらも所有権は無い
                 m_selected_task = std::shared_ptr<TaskSet>{std::shared_ptr<TaskSet>{nullptr}, &cond_pair.second};
                 break;
@@ -72,6 +116,68 @@ namespace Expr
         quit();
     }
 
+    void IfElse::for_each_child(const std::function<void(AbstTask&)>& _func)
+    {
+        for (auto& cond_pair : m_condition_list) {
+            _func(cond_pair.second);
+        }
+    }
+    std::uint64_t IfElse::waiting_cycles()
+    {
+        return m_selected_task ? waiting_cycles_of(*m_selected_task) : 0;
+    }
+    void IfElse::skip_waiting(std::uint64_t _cycles)
+    {
+        if (m_selected_task) {
+            skip_waiting_of(*m_selected_task, _cycles);
+        }
+    }
+    std::uint32_t IfElse::compile(Fleet::Builder& _builder)
+    {
+        auto index = _builder.open(Fleet::Op::If, true);
+        // 条件を続けて並べてから、節の中身を写す
+        for (auto& cond_pair : m_condition_list) {
+            auto function = _builder.function(cond_pair.first);
+            if (&cond_pair == &m_condition_list.front()) {
+                _builder.node(index).function = function;
+            }
+        }
+        std::vector<std::uint32_t> children;
+        for (auto& cond_pair : m_condition_list) {
+            children.push_back(_builder.add(cond_pair.second));
+        }
+        _builder.set_children(index, children);
+        return index;
+    }
+    Analysis::WorstCase IfElse::analyze(const Analysis::CostModel& _model)
+    {
+        Analysis::WorstCase result;
+        result.add_node(_model);
+
+        std::optional<Analysis::WorstCase> worst;
+        if (!m_adaptive_order) {  // どの条件も真にならない場合
+            worst.emplace();
+            worst->add_condition(_model, m_condition_list.size());
+        }
+        for (std::size_t i = 0; i < m_condition_list.size(); ++i) {
+            Analysis::WorstCase branch;
+            if (!m_adaptive_order) {
+                branch.add_condition(_model, i + 1);
+            }
+            branch.path.push_back(Analysis::type_name(*this) + ": branch " + std::to_string(i));
+            branch += m_condition_list[i].second.worst_case(_model);
+            worst = worst ? Analysis::WorstCase::larger(std::move(worst.value()), std::move(branch)) : std::move(branch);
+        }
+
+        if (m_adaptive_order) {  // 評価順に依らず、全ての条件(Else節を除く)を評価し得る
+            result.add_condition(_model, m_adaptive_order->statistics()->size());
+        }
+        if (worst) {
+            result += worst.value();
+        }
+        return result;
+    }
+
 
     If& If::operator=(const If& _other) &
     {
@@ -84,65 +190,69 @@ namespace Expr
         return *this;
     }
 
-    std::shared_ptr<If::IfFunction> If::operator->() const&
+    If::IfFunction If::operator->() const&
     {
-        return std::make_shared<IfFunction>(m_condition_list);
+        return IfFunction{m_condition_list, m_exclusive};
     }
-    std::shared_ptr<If::IfFunction> If::operator->() && noexcept
+    If::IfFunction If::operator->() && noexcept
     {
-        return std::make_shared<IfFunction>(std::move(m_condition_list));
+        return IfFunction{std::move(m_condition_list), m_exclusive};
     }
 
 
-    If::IfFunction::IfFunction(const condition_list_type& _cond_list)
-        : m_cond_list_ptr{std::make_shared<condition_list_type>(_cond_list)},
-          ElseIf{m_cond_list_ptr}
+    If::IfFunction::IfFunction(const condition_list_type& _cond_list, bool _exclusive)
+        : m_cond_list{_cond_list},
+          m_exclusive{_exclusive}
     {
     }
-    If::IfFunction::IfFunction(condition_list_type&& _cond_list) noexcept
-        : m_cond_list_ptr{std::make_shared<condition_list_type>(std::move(_cond_list))},
-          ElseIf{m_cond_list_ptr}
+    If::IfFunction::IfFunction(condition_list_type&& _cond_list, bool _exclusive) noexcept
+        : m_cond_list{std::move(_cond_list)},
+          m_exclusive{_exclusive}
     {
     }
 
 
-    If::IfFunction::ElseIfClass::ElseIfCondition If::IfFunction::ElseIfClass::operator[](const std::function<bool()>& _func) const noexcept
+    If::ElseIfCondition If::IfFunction::ElseIfClass::operator[](const std::function<bool()>& _func) const noexcept
     {
-        return ElseIfCondition{*m_cond_list_ptr, _func};
+        return ElseIfCondition{std::move(m_function.m_cond_list), _func, m_function.m_exclusive};
     }
-    If::IfFunction::ElseIfClass::ElseIfCondition If::IfFunction::ElseIfClass::operator[](std::function<bool()>&& _func) const noexcept
+    If::ElseIfCondition If::IfFunction::ElseIfClass::operator[](std::function<bool()>&& _func) const noexcept
     {
-        return ElseIfCondition{*m_cond_list_ptr, std::move(_func)};
+        return ElseIfCondition{std::move(m_function.m_cond_list), std::move(_func), m_function.m_exclusive};
     }
 
-    If::IfFunction::ElseIfClass::ElseIfCondition If::IfFunction::ElseIfClass::operator()(const std::function<bool()>& _func) const noexcept
+    If::ElseIfCondition If::IfFunction::ElseIfClass::operator()(const std::function<bool()>& _func) const noexcept
     {
-        return ElseIfCondition{*m_cond_list_ptr, _func};
+        return ElseIfCondition{std::move(m_function.m_cond_list), _func, m_function.m_exclusive};
     }
-    If::IfFunction::ElseIfClass::ElseIfCondition If::IfFunction::ElseIfClass::operator()(std::function<bool()>&& _func) const noexcept
+    If::ElseIfCondition If::IfFunction::ElseIfClass::operator()(std::function<bool()>&& _func) const noexcept
     {
-        return ElseIfCondition{*m_cond_list_ptr, std::move(_func)};
+        return ElseIfCondition{std::move(m_function.m_cond_list), std::move(_func), m_function.m_exclusive};
     }
 
 
-    If::IfFunction::ElseIfClass::ElseIfCondition::ElseIfCondition(const condition_list_type& _cond_list, const std::function<bool()>& _func) noexcept
-        : m_condition_list{_cond_list},
-          m_condition{_func}
+    If::ElseIfCondition::ElseIfCondition(condition_list_type&& _cond_list, const std::function<bool()>& _func, bool _exclusive) noexcept
+        : m_condition_list{std::move(_cond_list)},
+          m_condition{_func},
+          m_exclusive{_exclusive}
     {
     }
-    If::IfFunction::ElseIfClass::ElseIfCondition::ElseIfCondition(const condition_list_type& _cond_list, std::function<bool()>&& _func) noexcept
-        : m_condition_list{_cond_list},
-          m_condition{std::move(_func)}
+    If::ElseIfCondition::ElseIfCondition(condition_list_type&& _cond_list, std::function<bool()>&& _func, bool _exclusive) noexcept
+        : m_condition_list{std::move(_cond_list)},
+          m_condition{std::move(_func)},
+          m_exclusive{_exclusive}
     {
     }
 
 
-    IfCondition::IfCondition(const std::function<bool()>& _func) noexcept
-        : m_condition{_func}
+    IfCondition::IfCondition(const std::function<bool()>& _func, bool _exclusive) noexcept
+        : m_condition{_func},
+          m_exclusive{_exclusive}
     {
     }
-    IfCondition::IfCondition(std::function<bool()>&& _func) noexcept
-        : m_condition{std::move(_func)}
+    IfCondition::IfCondition(std::function<bool()>&& _func, bool _exclusive) noexcept
+        : m_condition{std::move(_func)},
+          m_exclusive{_exclusive}
     {
     }
 
@@ -164,6 +274,24 @@ namespace Expr
         return IfCondition{std::move(_func)};
     }
 
+
+    IfCondition ExclusiveIfOperator::operator[](const std::function<bool()>& _func) const& noexcept
+    {
+        return IfCondition{_func, true};
+    }
+    IfCondition ExclusiveIfOperator::operator[](std::function<bool()>&& _func) const& noexcept
+    {
+        return IfCondition{std::move(_func), true};
+    }
+    IfCondition ExclusiveIfOperator::operator()(const std::function<bool()>& _func) const& noexcept
+    {
+        return IfCondition{_func, true};
+    }
+    IfCondition ExclusiveIfOperator::operator()(std::function<bool()>&& _func) const& noexcept
+    {
+        return IfCondition{std::move(_func), true};
+    }
+
 }  // namespace Expr
 
 }  // namespace TaskManager
@@ -0,0 +1,118 @@
+#include "task_introspection.hpp"
+#include "task_cycle.hpp"
+
+#include <algorithm>
+
+namespace TaskManager
+{
+
+namespace Introspection
+{
+    namespace
+    {
+        std::atomic<node_id> s_next_id{1};
+
+        thread_local PathTracker* t_tracker{nullptr};
+    }
+
+    node_id issue_node_id() noexcept
+    {
+        return s_next_id.fetch_add(1, std::memory_order_relaxed);
+    }
+
+
+    bool ActivePath::try_read(Snapshot& _snapshot) const noexcept
+    {
+        auto before = m_sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            return false;
+        }
+
+        _snapshot.depth = m_depth.load(std::memory_order_relaxed);
+        auto stored = std::min(_snapshot.depth, max_depth);
+        for (std::size_t i = 0; i < stored; ++i) {
+            _snapshot.path[i] = m_path[i].load(std::memory_order_relaxed);
+        }
+        _snapshot.active_cycles = m_active_cycles.load(std::memory_order_relaxed);
+        _snapshot.epoch = m_epoch.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (m_sequence.load(std::memory_order_relaxed) != before) {
+            return false;
+        }
+        _snapshot.sequence = before / 2;
+        return true;
+    }
+
+    ActivePath::Snapshot ActivePath::read() const noexcept
+    {
+        Snapshot snapshot;
+        while (!try_read(snapshot)) {
+        }
+        return snapshot;
+    }
+
+    void ActivePath::publish(const node_id* _path, std::size_t _depth) noexcept
+    {
+        auto stored = std::min(_depth, max_depth);
+        auto leaf = _depth == 0 ? 0 : _path[stored - 1];
+        m_last_cycles = (_depth != 0 && leaf == m_last_leaf && _depth == m_last_depth) ? m_last_cycles + 1 : (_depth == 0 ? 0 : 1);
+        m_last_leaf = leaf;
+        m_last_depth = _depth;
+
+        auto sequence = m_sequence.load(std::memory_order_relaxed);
+        m_sequence.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        m_depth.store(_depth, std::memory_order_relaxed);
+        for (std::size_t i = 0; i < stored; ++i) {
+            m_path[i].store(_path[i], std::memory_order_relaxed);
+        }
+        m_active_cycles.store(m_last_cycles, std::memory_order_relaxed);
+        m_epoch.store(Cycle::epoch(), std::memory_order_relaxed);
+
+        m_sequence.store(sequence + 2, std::memory_order_release);
+    }
+
+
+    bool LiveStack::try_read(std::array<node_id, max_depth>& _path, std::size_t& _depth) const noexcept
+    {
+        auto before = m_sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            return false;
+        }
+
+        _depth = m_depth.load(std::memory_order_acquire);
+        auto stored = std::min(_depth, max_depth);
+        for (std::size_t i = 0; i < stored; ++i) {
+            _path[i] = m_path[i].load(std::memory_order_relaxed);
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_sequence.load(std::memory_order_relaxed) == before;
+    }
+
+
+    PathTracker::PathTracker(ActivePath* _target, bool _record, LiveStack* _live) noexcept
+        : m_target{_target},
+          m_live{_live},
+          m_previous{t_tracker}
+    {
+        t_tracker = (_target || _record || _live) ? this : nullptr;
+    }
+    PathTracker::~PathTracker() noexcept
+    {
+        if (m_live) {
+            m_live->pop(0);  // 例外で抜けた時も、実行していない状態に戻す
+        }
+        t_tracker = m_previous;
+    }
+
+    PathTracker* PathTracker::current() noexcept
+    {
+        return t_tracker;
+    }
+
+}  // namespace Introspection
+
+}  // namespace TaskManager
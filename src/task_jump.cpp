@@ -1,4 +1,9 @@
 #include "task_jump.hpp"
+#include "task_analysis.hpp"
+#include "task_metrics.hpp"
+#include "task_observer.hpp"
+#include "task_realtime.hpp"
+#include "task_replay.hpp"
 
 
 namespace TaskManager
@@ -66,12 +71,19 @@ namespace Expr
 
             if (static_cast<bool>(jump_target.type)) {  //ReturnBack
                 if (set_jump(jump_target.priority, nullptr) && jump_target.task_ptr) {
+                    Metrics::record_jump(jump_target.priority);
+                    if constexpr (Observer::enabled) {
+                        Observer::Active::on_jump(*this, *jump_target.task_ptr, jump_target.priority, true);
+                    }
                     force_quit(*m_taskset);
                     return {jump_target.task_ptr};
                 }
 
             } else {  //OneWay
                 if (set_jump(jump_target.priority, jump_target.task_ptr) && jump_target.task_ptr) {
+                    if constexpr (Observer::enabled) {
+                        Observer::Active::on_jump(*this, *jump_target.task_ptr, jump_target.priority, false);
+                    }
                     return false;
                 }
             }
@@ -87,26 +99,225 @@ namespace Expr
         quit();
     }
 
-    std::shared_ptr<Jump::JumpManager::JumpManagerOperator> Jump::operator->() const& noexcept
+    void Jump::for_each_child(const std::function<void(AbstTask&)>& _func)
+    {
+        if (m_taskset) {
+            _func(*m_taskset);
+        }
+        if (m_jump_manager) {
+            m_jump_manager->for_each_target(_func);
+        }
+    }
+    void Jump::prepare()
+    {
+        if (m_jump_manager) {
+            m_jump_manager->prepare();
+        }
+    }
+    Analysis::WorstCase Jump::analyze(const Analysis::CostModel& _model)
+    {
+        Analysis::WorstCase result;
+        result.add_node(_model);
+        if (m_taskset) {
+            result += m_taskset->worst_case(_model);
+        }
+        if (!m_jump_manager) {
+            return result;
+        }
+        return m_jump_manager->analyze(std::move(result), m_taskset.get(), _model);
+    }
+
+    Jump::JumpManager::JumpManagerOperator Jump::operator->() const& noexcept
     {
-        return std::make_shared<JumpManager::JumpManagerOperator>(m_jump_manager, m_taskset);
+        return {m_jump_manager, m_taskset};
     }
-    std::shared_ptr<Jump::JumpManager::JumpManagerOperator> Jump::operator->() && noexcept
+    Jump::JumpManager::JumpManagerOperator Jump::operator->() && noexcept
     {
-        return std::make_shared<JumpManager::JumpManagerOperator>(std::move(m_jump_manager), std::move(m_taskset));
+        return {std::move(m_jump_manager), std::move(m_taskset)};
+    }
+
+
+    std::shared_ptr<ConditionStatistics> Jump::statistics(int _priority) const
+    {
+        if (m_jump_manager) {
+            return m_jump_manager->statistics(_priority);
+        }
+        return nullptr;
     }
 
 
     Jump::JumpManager::JumpManager(const JumpManager& _other)
-        : m_jump_list{std::make_shared<jump_cond_list_t>(*_other.m_jump_list)}
+        : m_jump_list{std::make_shared<jump_cond_list_t>(*_other.m_jump_list)},
+          m_exclusive_list{_other.m_exclusive_list}
     {
     }
     Jump::JumpManager& Jump::JumpManager::operator=(const JumpManager& _other) &
     {
         m_jump_list = std::make_shared<jump_cond_list_t>(*_other.m_jump_list);
+        m_exclusive_list = _other.m_exclusive_list;
+        m_spare_list.clear();
         return *this;
     }
 
+    void Jump::JumpManager::set_exclusive(int _priority)
+    {
+        auto size = condition_count(_priority);
+        if (auto order = exclusive_order(_priority)) {  // 宣言し直しても統計は同じものを使い続ける
+            order->resize(size);
+            return;
+        }
+        m_exclusive_list.emplace(_priority, AdaptiveOrder{size});
+    }
+
+    void Jump::JumpManager::add_condition(int _priority, jump_cond_t&& _cond)
+    {
+        if (!m_jump_list) {
+            return;
+        }
+        auto& cond_list = (*m_jump_list)[_priority];
+        cond_list.push_back(std::move(_cond));
+        if (auto order = exclusive_order(_priority)) {
+            order->resize(cond_list.size());
+        }
+    }
+
+    std::shared_ptr<ConditionStatistics> Jump::JumpManager::statistics(int _priority)
+    {
+        if (auto order = exclusive_order(_priority)) {
+            return order->statistics();
+        }
+        return nullptr;
+    }
+
+    std::size_t Jump::JumpManager::condition_count(int _priority) const noexcept
+    {
+        if (!m_jump_list) {
+            return 0;
+        }
+        auto found = m_jump_list->find(_priority);
+        return found == m_jump_list->end() ? 0 : found->second.size();
+    }
+
+    AdaptiveOrder* Jump::JumpManager::exclusive_order(int _priority) noexcept
+    {
+        auto found = m_exclusive_list.find(_priority);
+        return found == m_exclusive_list.end() ? nullptr : &found->second;
+    }
+
+    void Jump::JumpManager::prepare()
+    {
+        if (!m_jump_list) {
+            return;
+        }
+        for (auto& priority_list : *m_jump_list) {
+            for (auto& cond : priority_list.second) {
+                auto& target = std::get<std::shared_ptr<TaskSet>>(cond);
+                if (!target) {
+                    continue;
+                }
+                auto spare = m_spare_list.find(target.get());
+                if (spare == m_spare_list.end()) {
+                    m_spare_list.emplace(std::piecewise_construct, std::forward_as_tuple(target.get()), std::forward_as_tuple(std::make_shared<TaskSet>(*target)));
+                    continue;
+                }
+
+                // 使い終わった予備を作り直す(使っている最中なら次の機会に)
+                auto& entry = spare->second;
+                if (entry.claimed.exchange(true, std::memory_order_acquire)) {
+                    continue;
+                }
+                if (!entry.fresh && entry.task.use_count() == 1) {
+                    entry.task = std::make_shared<TaskSet>(*target);
+                    entry.fresh = true;
+                }
+                entry.claimed.store(false, std::memory_order_release);
+            }
+        }
+    }
+
+    Analysis::WorstCase Jump::JumpManager::analyze(Analysis::WorstCase&& _during, AbstTask* _body, const Analysis::CostModel& _model)
+    {
+        if (!m_jump_list) {
+            return std::move(_during);
+        }
+
+        // 排他と宣言された優先度も、評価順次第で全ての条件を評価し得る
+        std::size_t conditions = 0;
+        auto return_back = false;
+        for (auto& priority_list : *m_jump_list) {
+            for (auto& cond : priority_list.second) {
+                if (std::get<std::function<bool()>>(cond)) {
+                    ++conditions;
+                }
+                if (std::get<JumpType>(cond) == JumpType::ReturnBack) {
+                    return_back = true;
+                } else {
+                    _during.may_switch_scene = true;
+                }
+            }
+        }
+        _during.add_condition(_model, conditions);
+        if (return_back && _body) {
+            _during.add_interrupt(_model, Analysis::interrupt_cascade(*_body));
+        }
+
+        std::size_t index = 0;
+        for_each_target([&](AbstTask& _target) {
+            Analysis::WorstCase target;
+            target.path.push_back("During: jump target " + std::to_string(index++));
+            target += _target.worst_case(_model);
+            _during = Analysis::WorstCase::larger(std::move(_during), std::move(target));
+        });
+        return std::move(_during);
+    }
+
+    void Jump::JumpManager::for_each_target(const std::function<void(AbstTask&)>& _func)
+    {
+        if (!m_jump_list || m_visiting) {
+            return;
+        }
+
+        m_visiting = true;
+        try {
+            for (auto& priority_list : *m_jump_list) {
+                for (auto& cond : priority_list.second) {
+                    if (auto& target = std::get<std::shared_ptr<TaskSet>>(cond)) {
+                        auto spare = m_spare_list.find(target.get());
+                        _func(spare != m_spare_list.end() ? *spare->second.task : *target);
+                    }
+                }
+            }
+        } catch (...) {
+            m_visiting = false;
+            throw;
+        }
+        m_visiting = false;
+    }
+
+    // ジャンプ先は、使える予備が無ければ実行の度にコピーする(nullptrならそのまま)
+    std::shared_ptr<TaskSet> Jump::JumpManager::take_target(const std::shared_ptr<TaskSet>& _target)
+    {
+        if (!_target) {
+            return nullptr;
+        }
+
+        auto spare = m_spare_list.find(_target.get());
+        if (spare != m_spare_list.end() && !spare->second.claimed.exchange(true, std::memory_order_acquire)) {
+            auto& entry = spare->second;
+            std::shared_ptr<TaskSet> result;
+            if (entry.task.use_count() == 1 && (entry.fresh || RealTime::reuse_jump_targets())) {
+                std::atomic_thread_fence(std::memory_order_acquire);  // 前に使っていた根の書き込みを見てから使う
+                entry.fresh = false;
+                result = entry.task;
+            }
+            entry.claimed.store(false, std::memory_order_release);
+            if (result) {
+                return result;
+            }
+        }
+        return std::make_shared<TaskSet>(*_target);
+    }
+
     std::optional<Jump::JumpManager::JumpTarget> Jump::JumpManager::check()
     {
         if (m_jump_list) {
@@ -114,14 +325,31 @@ namespace Expr
             //priorityが高い順に取り出し
             for (auto i = m_jump_list->rbegin(); i != m_jump_list->rend(); ++i) {
 
+                //排他と宣言されていれば、当たりやすく軽い順に取り出し
+                if (auto order = exclusive_order(i->first)) {
+                    auto& cond_list = i->second;
+                    auto found = order->find_first([&cond_list](std::size_t _index) {
+                        auto& func = std::get<std::function<bool()>>(cond_list[_index]);
+                        return func && Replay::condition(func);
+                    });
+
+                    if (found) {  //条件成立
+                        auto& cond = cond_list[found.value()];
+                        return JumpTarget{i->first,
+                            std::get<JumpType>(cond),
+                            take_target(std::get<std::shared_ptr<TaskSet>>(cond))};
+                    }
+                    continue;
+                }
+
                 //同priorityでは先に登録した順に取り出し
                 for (auto&& cond : i->second) {
                     if (auto& func = std::get<std::function<bool()>>(cond)) {
-                        if (func()) {  //条件成立
+                        if (Replay::condition(func)) {  //条件成立
 
                             return JumpTarget{i->first,
                                 std::get<JumpType>(cond),
-                                std::make_shared<TaskSet>(*std::get<std::shared_ptr<TaskSet>>(cond))};
+                                take_target(std::get<std::shared_ptr<TaskSet>>(cond))};
                         }
                     }
                 }
@@ -138,10 +366,18 @@ namespace Expr
     {
     }
     Jump::EmbeddedJump::EmbeddedJump(Jump&& _jump) noexcept
-        : m_taskset{_jump.m_taskset ? *_jump.m_taskset : TaskSet{}},
+        : m_taskset{},
           m_jump_manager{std::move(_jump.m_jump_manager)}
     {
         _jump.m_jump_manager = nullptr;
+
+        // 他のJumpと共有していなければ、コピーせずにムーブする
+        if (_jump.m_taskset.use_count() == 1) {
+            m_taskset = std::move(*_jump.m_taskset);
+        } else if (_jump.m_taskset) {
+            m_taskset = *_jump.m_taskset;
+        }
+        _jump.m_taskset = nullptr;
     }
 
     Jump::EmbeddedJump::EmbeddedJump(const EmbeddedJump& _other)
@@ -186,12 +422,19 @@ namespace Expr
 
             if (static_cast<bool>(jump_target.type)) {  //ReturnBack
                 if (set_jump(jump_target.priority, nullptr) && jump_target.task_ptr) {
+                    Metrics::record_jump(jump_target.priority);
+                    if constexpr (Observer::enabled) {
+                        Observer::Active::on_jump(*this, *jump_target.task_ptr, jump_target.priority, true);
+                    }
                     force_quit(m_taskset);
                     return {jump_target.task_ptr};
                 }
 
             } else {  //OneWay
                 if (set_jump(jump_target.priority, jump_target.task_ptr) && jump_target.task_ptr) {
+                    if constexpr (Observer::enabled) {
+                        Observer::Active::on_jump(*this, *jump_target.task_ptr, jump_target.priority, false);
+                    }
                     return false;
                 }
             }
@@ -205,6 +448,30 @@ namespace Expr
         quit();
     }
 
+    void Jump::EmbeddedJump::for_each_child(const std::function<void(AbstTask&)>& _func)
+    {
+        _func(m_taskset);
+        if (m_jump_manager) {
+            m_jump_manager->for_each_target(_func);
+        }
+    }
+    void Jump::EmbeddedJump::prepare()
+    {
+        if (m_jump_manager) {
+            m_jump_manager->prepare();
+        }
+    }
+    Analysis::WorstCase Jump::EmbeddedJump::analyze(const Analysis::CostModel& _model)
+    {
+        Analysis::WorstCase result;
+        result.add_node(_model);
+        result += m_taskset.worst_case(_model);
+        if (!m_jump_manager) {
+            return result;
+        }
+        return m_jump_manager->analyze(std::move(result), &m_taskset, _model);
+    }
+
 }  //namespace Expr
 
 }  //namespace TaskManager
@@ -7,17 +7,27 @@ namespace TaskManager
 namespace Expr
 {
     Jump::JumpManager::JumpManagerOperator::JumpManagerOperator(const std::shared_ptr<JumpManager>& _jump_manager, const std::shared_ptr<TaskSet>& _taskset) noexcept
-        : JumpIf{_jump_manager, _taskset},
-          JumpBackIf{_jump_manager, _taskset}
+        : m_jump_manager{_jump_manager},
+          m_taskset{_taskset}
     {
     }
     Jump::JumpManager::JumpManagerOperator::JumpManagerOperator(std::shared_ptr<JumpManager>&& _jump_manager, std::shared_ptr<TaskSet>&& _taskset) noexcept
-        : JumpIf{_jump_manager, _taskset},
-          JumpBackIf{std::move(_jump_manager), std::move(_taskset)}
+        : m_jump_manager{std::move(_jump_manager)},
+          m_taskset{std::move(_taskset)}
     {
     }
 
 
+    Jump Jump::JumpManager::JumpManagerOperator::Exclusive(int _priority)
+    {
+        if (m_jump_manager) {
+            m_jump_manager->set_exclusive(_priority);
+        }
+
+        return {std::move(m_taskset), std::move(m_jump_manager)};
+    }
+
+
     Jump::JumpManager::JumpManagerOperator::JumpIfCondition::JumpIfCondition(const std::shared_ptr<JumpManager>& _jump_manager, int _priority, const std::function<bool()>& _func, const std::shared_ptr<TaskSet>& _taskset) noexcept
         : m_jump_manager{_jump_manager},
           m_priority{_priority},
@@ -40,7 +50,7 @@ namespace Expr
     {
     }
     Jump::JumpManager::JumpManagerOperator::JumpIfCondition::JumpIfCondition(std::shared_ptr<JumpManager>&& _jump_manager, int _priority, std::function<bool()>&& _func, std::shared_ptr<TaskSet>&& _taskset) noexcept
-        : m_jump_manager{_jump_manager},
+        : m_jump_manager{std::move(_jump_manager)},
           m_priority{_priority},
           m_func{std::move(_func)},
           m_taskset{std::move(_taskset)}
@@ -50,9 +60,7 @@ namespace Expr
     Jump Jump::JumpManager::JumpManagerOperator::JumpIfCondition::operator()(std::nullptr_t) const& noexcept
     {
         if (m_jump_manager) {
-            if (auto& jump_list = m_jump_manager->m_jump_list) {
-                (*jump_list)[m_priority].emplace_back(m_func, JumpType::OneWay, nullptr);
-            }
+            m_jump_manager->add_condition(m_priority, {m_func, JumpType::OneWay, nullptr});
         }
 
         return {m_taskset, m_jump_manager};
@@ -60,9 +68,7 @@ namespace Expr
     Jump Jump::JumpManager::JumpManagerOperator::JumpIfCondition::operator()(std::nullptr_t) && noexcept
     {
         if (m_jump_manager) {
-            if (auto& jump_list = m_jump_manager->m_jump_list) {
-                (*jump_list)[m_priority].emplace_back(std::move(m_func), JumpType::OneWay, nullptr);
-            }
+            m_jump_manager->add_condition(m_priority, {std::move(m_func), JumpType::OneWay, nullptr});
         }
 
         return {std::move(m_taskset), std::move(m_jump_manager)};
@@ -74,6 +80,11 @@ namespace Expr
           m_taskset{_taskset}
     {
     }
+    Jump::JumpManager::JumpManagerOperator::JumpIfClass::JumpIfClass(std::shared_ptr<JumpManager>&& _jump_manager, std::shared_ptr<TaskSet>&& _taskset) noexcept
+        : m_jump_manager{std::move(_jump_manager)},
+          m_taskset{std::move(_taskset)}
+    {
+    }
 
     Jump::JumpManager::JumpManagerOperator::JumpIfClass Jump::JumpManager::JumpManagerOperator::JumpIfClass::operator[](int _priority) const& noexcept
     {
@@ -155,9 +166,7 @@ namespace Expr
     Jump Jump::JumpManager::JumpManagerOperator::JumpBackIfCondition::operator()(std::nullptr_t) const& noexcept
     {
         if (m_jump_manager) {
-            if (auto& jump_list = m_jump_manager->m_jump_list) {
-                (*jump_list)[m_priority].emplace_back(m_func, JumpType::ReturnBack, nullptr);
-            }
+            m_jump_manager->add_condition(m_priority, {m_func, JumpType::ReturnBack, nullptr});
         }
 
         return {m_taskset, m_jump_manager};
@@ -165,9 +174,7 @@ namespace Expr
     Jump Jump::JumpManager::JumpManagerOperator::JumpBackIfCondition::operator()(std::nullptr_t) && noexcept
     {
         if (m_jump_manager) {
-            if (auto& jump_list = m_jump_manager->m_jump_list) {
-                (*jump_list)[m_priority].emplace_back(std::move(m_func), JumpType::ReturnBack, nullptr);
-            }
+            m_jump_manager->add_condition(m_priority, {std::move(m_func), JumpType::ReturnBack, nullptr});
         }
 
         return {std::move(m_taskset), std::move(m_jump_manager)};
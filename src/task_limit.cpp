@@ -0,0 +1,148 @@
+#include "task_limit.hpp"
+#include "task_replay.hpp"
+
+#include <algorithm>
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+
+    Limited::Limited(std::optional<std::size_t> _max_cycles, std::optional<clock::duration> _max_time, handler_type _handler, TaskSet&& _taskset)
+        : m_taskset{std::move(_taskset)},
+          m_max_cycles{_max_cycles},
+          m_max_time{_max_time},
+          m_handler{std::move(_handler)},
+          m_statistics{std::make_shared<LimitStatistics>()}
+    {
+    }
+
+    Limited::Limited(const Limited& _other)
+        : AbstTask{_other},
+          m_taskset{_other.m_taskset},
+          m_max_cycles{_other.m_max_cycles},
+          m_max_time{_other.m_max_time},
+          m_handler{_other.m_handler},
+          m_statistics{_other.m_statistics}
+    {
+    }
+    Limited& Limited::operator=(const Limited& _other) &
+    {
+        AbstTask::operator=(_other);
+        m_taskset = _other.m_taskset;
+        m_max_cycles = _other.m_max_cycles;
+        m_max_time = _other.m_max_time;
+        m_handler = _other.m_handler;
+        m_statistics = _other.m_statistics;
+        return *this;
+    }
+    Limited::Limited(Limited&& _other) noexcept
+        : AbstTask{std::move(_other)},
+          m_taskset{std::move(_other.m_taskset)},
+          m_max_cycles{_other.m_max_cycles},
+          m_max_time{_other.m_max_time},
+          m_handler{std::move(_other.m_handler)},
+          m_statistics{std::move(_other.m_statistics)}
+    {
+    }
+    Limited& Limited::operator=(Limited&& _other) & noexcept
+    {
+        AbstTask::operator=(std::move(_other));
+        m_taskset = std::move(_other.m_taskset);
+        m_max_cycles = _other.m_max_cycles;
+        m_max_time = _other.m_max_time;
+        m_handler = std::move(_other.m_handler);
+        m_statistics = std::move(_other.m_statistics);
+        return *this;
+    }
+
+
+    void Limited::init()
+    {
+        m_cycles = 0;
+        m_cycle_epoch = Cycle::epoch();
+        if (m_max_time) {
+            m_begin_time = clock::now();
+        }
+        m_notified = false;
+        ++m_statistics->started;
+    }
+
+    NextTask Limited::eval()
+    {
+        auto epoch = Cycle::epoch();
+        if (epoch != m_cycle_epoch) {  // 同じ周期に何度評価されても1つと数える
+            ++m_cycles;
+            m_cycle_epoch = epoch;
+        }
+
+        if (!m_notified) {
+            LimitEvent event;
+            event.node = node_id();
+            event.cycles = m_cycles;
+            if (m_max_time) {
+                event.elapsed = clock::now() - m_begin_time;
+            }
+
+            // 始めた周期を0周期目とし、上限の周期数だけ評価した後に超えたとみなす
+            if (Replay::condition([&] { return (m_max_cycles && event.cycles >= m_max_cycles.value()) || (m_max_time && event.elapsed >= m_max_time.value()); })) {
+                m_notified = true;
+                ++m_statistics->exceeded;
+
+                if (!m_handler || Replay::condition([&] { return m_handler(event) == LimitAction::Quit; })) {
+                    ++m_statistics->quit;
+                    force_quit(m_taskset);
+                    return true;
+                }
+            }
+        }
+
+        return evaluate(m_taskset);
+    }
+
+    void Limited::interrupt()
+    {
+        force_quit(m_taskset);
+        quit();
+    }
+
+    void Limited::for_each_child(const std::function<void(AbstTask&)>& _func)
+    {
+        _func(m_taskset);
+    }
+    std::uint64_t Limited::waiting_cycles()
+    {
+        auto result = waiting_cycles_of(m_taskset);
+        if (m_notified || result == 0) {
+            return result;
+        }
+
+        if (m_max_cycles) {  // m_cycles+iの周期の判定で超えない最大のi
+            if (m_cycles + 1 >= m_max_cycles.value()) {
+                return 0;
+            }
+            result = std::min<std::uint64_t>(result, m_max_cycles.value() - 1 - m_cycles);
+        }
+        if (m_max_time) {
+            if (!Clock::is_virtual()) {
+                return 0;
+            }
+            auto period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>{1.0 / Cycle::frequency()});
+            auto remaining = m_max_time.value() - (clock::now() - m_begin_time);
+            if (period <= clock::duration::zero() || remaining <= period) {
+                return 0;
+            }
+            result = std::min<std::uint64_t>(result, static_cast<std::uint64_t>((remaining - clock::duration{1}) / period));
+        }
+        return result;
+    }
+    void Limited::skip_waiting(std::uint64_t _cycles)
+    {
+        skip_waiting_of(m_taskset, _cycles);
+        m_cycles += static_cast<std::size_t>(_cycles);
+    }
+
+}  // namespace Expr
+
+}  // namespace TaskManager
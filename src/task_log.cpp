@@ -0,0 +1,205 @@
+#include "task_log.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace TaskManager
+{
+
+namespace Log
+{
+    namespace
+    {
+        std::atomic<Sink*> s_sink{nullptr};
+
+        std::int64_t now_ns() noexcept
+        {
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        std::size_t round_up(std::size_t _value) noexcept
+        {
+            std::size_t result = 2;
+            while (result < _value) {
+                result <<= 1;
+            }
+            return result;
+        }
+    }
+
+    const char* level_name(Level _level) noexcept
+    {
+        switch (_level) {
+        case Level::Info:
+            return "info";
+        case Level::Warning:
+            return "warning";
+        default:
+            return "error";
+        }
+    }
+
+    void write(std::ostream& _os, const Record& _record)
+    {
+        _os << "[task-manager " << level_name(_record.level) << "] " << _record.message;
+        if (_record.detail[0] != '\0') {
+            _os << ": " << _record.detail;
+        }
+        if (_record.suppressed > 0) {
+            _os << " (" << _record.suppressed << " more suppressed)";
+        }
+        _os << '\n';
+    }
+
+
+    Ring::Ring(std::size_t _capacity)
+        : m_slot{new Slot[round_up(_capacity)]},
+          m_mask{round_up(_capacity) - 1}
+    {
+        for (std::size_t i = 0; i <= m_mask; ++i) {
+            m_slot[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    Ring::~Ring() noexcept
+    {
+        stop();
+    }
+
+    void Ring::post(const Record& _record) noexcept
+    {
+        // Vyukovの有界キュー。席を取れたら写して、sequenceで取り出す側に渡す
+        auto position = m_enqueue.load(std::memory_order_relaxed);
+        while (true) {
+            auto& slot = m_slot[position & m_mask];
+            auto sequence = slot.sequence.load(std::memory_order_acquire);
+            auto difference = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (difference == 0) {
+                if (m_enqueue.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.record = _record;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return;
+                }
+            } else if (difference < 0) {  // 満杯
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            } else {
+                position = m_enqueue.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::size_t Ring::drain(const std::function<void(const Record&)>& _func)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        std::size_t count = 0;
+        auto position = m_dequeue.load(std::memory_order_relaxed);
+        while (true) {
+            auto& slot = m_slot[position & m_mask];
+            if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+                break;
+            }
+            auto record = slot.record;
+            slot.sequence.store(position + m_mask + 1, std::memory_order_release);
+            m_dequeue.store(++position, std::memory_order_relaxed);
+
+            _func(record);
+            ++count;
+        }
+        return count;
+    }
+
+    std::size_t Ring::flush(std::ostream& _os)
+    {
+        auto count = drain([&_os](const Record& _record) { write(_os, _record); });
+        if (count > 0) {
+            _os.flush();
+        }
+        return count;
+    }
+
+    void Ring::start(std::ostream& _os, std::chrono::milliseconds _period)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_thread.joinable()) {
+            return;
+        }
+        m_quit = false;
+        m_thread = std::thread{[this, &_os, _period] {
+            std::unique_lock<std::mutex> lock{m_mutex};
+            while (!m_cv.wait_for(lock, _period, [this] { return m_quit; })) {
+                lock.unlock();
+                flush(_os);
+                lock.lock();
+            }
+            lock.unlock();
+            flush(_os);
+        }};
+    }
+
+    void Ring::stop() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_quit = true;
+        }
+        m_cv.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+
+    Ring& default_ring()
+    {
+        struct DefaultRing : Ring {
+            ~DefaultRing() noexcept
+            {
+                stop();
+                try {
+                    flush(std::cerr);
+                } catch (...) {
+                }
+            }
+        };
+        static DefaultRing ring;
+        return ring;
+    }
+
+    namespace
+    {
+        // 制御スレッドが初めてpost()する時に作ることにならないよう、始めに作っておく
+        [[maybe_unused]] Ring& s_default_ring = default_ring();
+    }
+
+    void set_sink(Sink* _sink) noexcept
+    {
+        s_sink.store(_sink, std::memory_order_release);
+    }
+
+    void post(Site& _site, const char* _detail) noexcept
+    {
+        auto now = now_ns();
+        auto last = _site.last_ns.load(std::memory_order_relaxed);
+        if ((last != 0 && now - last < _site.interval.count()) || !_site.last_ns.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+            _site.suppressed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        Record record;
+        record.level = _site.level;
+        record.message = _site.message;
+        if (_detail) {
+            std::strncpy(record.detail, _detail, Record::detail_size - 1);
+        }
+        record.suppressed = _site.suppressed.exchange(0, std::memory_order_relaxed);
+        record.time_ns = now;
+
+        auto sink = s_sink.load(std::memory_order_acquire);
+        (sink ? *sink : default_ring()).post(record);
+    }
+
+}  // namespace Log
+
+}  // namespace TaskManager
@@ -0,0 +1,228 @@
+#include "task_metrics.hpp"
+#include "abst_task.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TaskManager
+{
+
+namespace Metrics
+{
+    namespace
+    {
+        constexpr char magic[8] = {'T', 'A', 'S', 'K', 'M', 'E', 'T', 'R'};
+
+        thread_local RootMetrics* t_current{nullptr};
+
+        //! @brief "/name"の形ならPOSIX共有メモリ、それ以外はファイル
+        bool is_shm_name(const std::string& _name) noexcept
+        {
+            return _name.size() > 1 && _name[0] == '/' && _name.find('/', 1) == std::string::npos;
+        }
+
+        int open_fd(const std::string& _name, int _flags, mode_t _mode)
+        {
+            auto fd = is_shm_name(_name) ? shm_open(_name.c_str(), _flags, _mode) : ::open(_name.c_str(), _flags, _mode);
+            if (fd < 0) {
+                throw std::system_error{errno, std::generic_category(), "metrics: cannot open " + _name};
+            }
+            return fd;
+        }
+
+        std::size_t layout_length(std::size_t _root_capacity) noexcept
+        {
+            auto header = (sizeof(Header) + alignof(RootMetrics) - 1) / alignof(RootMetrics) * alignof(RootMetrics);
+            return header + sizeof(RootMetrics) * _root_capacity;
+        }
+    }
+
+
+    void RootMetrics::record(std::uint64_t _latency_ns, std::uint64_t _evaluations, Introspection::node_id _leaf, std::size_t _depth) noexcept
+    {
+        // 書くのは制御スレッドだけなので、読み出してから書いてよい
+        auto depth = static_cast<std::uint32_t>(_depth);
+        auto same = depth != 0 && active_leaf.load(std::memory_order_relaxed) == _leaf && active_depth.load(std::memory_order_relaxed) == depth;
+        active_cycles.store(same ? active_cycles.load(std::memory_order_relaxed) + 1 : (depth != 0 ? 1 : 0), std::memory_order_relaxed);
+        active_leaf.store(_leaf, std::memory_order_relaxed);
+        active_depth.store(depth, std::memory_order_relaxed);
+
+        cycles.fetch_add(1, std::memory_order_relaxed);
+        evaluations.fetch_add(_evaluations, std::memory_order_relaxed);
+        last_latency_ns.store(_latency_ns, std::memory_order_relaxed);
+        latency_sum_ns.fetch_add(_latency_ns, std::memory_order_relaxed);
+        if (_latency_ns > max_latency_ns.load(std::memory_order_relaxed)) {
+            max_latency_ns.store(_latency_ns, std::memory_order_relaxed);
+        }
+        if (budget_ns != 0 && _latency_ns > budget_ns) {
+            overruns.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::size_t bucket = 0;
+        for (auto latency = _latency_ns; latency > 1 && bucket + 1 < histogram_buckets; latency >>= 1) {
+            ++bucket;
+        }
+        latency_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void RootMetrics::record_jump(int _priority) noexcept
+    {
+        auto index = static_cast<std::size_t>(std::clamp(_priority, 0, static_cast<int>(jump_priorities) - 1));
+        jump_fires[index].fetch_add(1, std::memory_order_relaxed);
+    }
+
+
+    Segment::Segment(const std::string& _name, std::size_t _root_capacity)
+        : m_length{layout_length(_root_capacity)},
+          m_writable{true}
+    {
+        auto fd = open_fd(_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (ftruncate(fd, static_cast<off_t>(m_length)) != 0) {
+            auto error = errno;
+            ::close(fd);
+            throw std::system_error{error, std::generic_category(), "metrics: cannot resize " + _name};
+        }
+        m_base = mmap(nullptr, m_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        auto error = errno;
+        ::close(fd);
+        if (m_base == MAP_FAILED) {
+            m_base = nullptr;
+            throw std::system_error{error, std::generic_category(), "metrics: cannot map " + _name};
+        }
+
+        // ftruncateで0埋めされているので、atomicは0のまま使える
+        auto header = new (m_base) Header{};
+        header->version = layout_version;
+        header->root_capacity = static_cast<std::uint32_t>(_root_capacity);
+        header->root_stride = static_cast<std::uint32_t>(sizeof(RootMetrics));
+        header->pid = static_cast<std::uint64_t>(getpid());
+        for (std::size_t i = 0; i < _root_capacity; ++i) {
+            new (&root_at(i)) RootMetrics{};
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+        std::memcpy(header->magic, magic, sizeof(magic));
+    }
+
+    Segment Segment::open(const std::string& _name)
+    {
+        auto fd = open_fd(_name, O_RDONLY, 0);
+        struct stat status;
+        if (fstat(fd, &status) != 0 || static_cast<std::size_t>(status.st_size) < sizeof(Header)) {
+            ::close(fd);
+            throw std::system_error{EINVAL, std::generic_category(), "metrics: not a metrics segment " + _name};
+        }
+
+        Segment segment;
+        segment.m_length = static_cast<std::size_t>(status.st_size);
+        segment.m_base = mmap(nullptr, segment.m_length, PROT_READ, MAP_SHARED, fd, 0);
+        auto error = errno;
+        ::close(fd);
+        if (segment.m_base == MAP_FAILED) {
+            segment.m_base = nullptr;
+            throw std::system_error{error, std::generic_category(), "metrics: cannot map " + _name};
+        }
+
+        auto& header = segment.header();
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0 || header.version != layout_version
+            || header.root_stride != sizeof(RootMetrics) || layout_length(header.root_capacity) > segment.m_length) {
+            throw std::system_error{EINVAL, std::generic_category(), "metrics: incompatible layout " + _name};
+        }
+        return segment;
+    }
+
+    void Segment::remove(const std::string& _name) noexcept
+    {
+        if (is_shm_name(_name)) {
+            shm_unlink(_name.c_str());
+        } else {
+            ::unlink(_name.c_str());
+        }
+    }
+
+    Segment::~Segment() noexcept
+    {
+        if (m_base) {
+            munmap(m_base, m_length);
+        }
+    }
+
+    Segment::Segment(Segment&& _other) noexcept
+        : m_base{_other.m_base},
+          m_length{_other.m_length},
+          m_writable{_other.m_writable}
+    {
+        _other.m_base = nullptr;
+    }
+    Segment& Segment::operator=(Segment&& _other) & noexcept
+    {
+        if (this != &_other) {
+            if (m_base) {
+                munmap(m_base, m_length);
+            }
+            m_base = _other.m_base;
+            m_length = _other.m_length;
+            m_writable = _other.m_writable;
+            _other.m_base = nullptr;
+        }
+        return *this;
+    }
+
+    RootMetrics& Segment::root_at(std::size_t _index) noexcept
+    {
+        auto offset = layout_length(0) + sizeof(RootMetrics) * _index;
+        return *reinterpret_cast<RootMetrics*>(static_cast<char*>(m_base) + offset);
+    }
+    const RootMetrics& Segment::root(std::size_t _index) const noexcept
+    {
+        return const_cast<Segment*>(this)->root_at(_index);
+    }
+
+    RootMetrics* Segment::attach(Expr::AbstTask& _root, const std::string& _name, std::chrono::nanoseconds _budget)
+    {
+        if (!m_writable) {
+            return nullptr;
+        }
+        auto& header = *static_cast<Header*>(m_base);
+        auto index = header.root_count.load(std::memory_order_relaxed);
+        if (index >= header.root_capacity) {
+            return nullptr;
+        }
+
+        auto& metrics = root_at(index);
+        std::strncpy(metrics.name, _name.c_str(), RootMetrics::name_size - 1);
+        metrics.budget_ns = static_cast<std::uint64_t>(std::max<std::chrono::nanoseconds::rep>(_budget.count(), 0));
+        header.root_count.store(index + 1, std::memory_order_release);
+
+        _root.publish_metrics(&metrics);
+        return &metrics;
+    }
+
+
+    Scope::Scope(RootMetrics* _metrics) noexcept
+        : m_previous{t_current}
+    {
+        t_current = _metrics;
+    }
+    Scope::~Scope() noexcept
+    {
+        t_current = m_previous;
+    }
+
+    void record_jump(int _priority) noexcept
+    {
+        if (auto metrics = t_current) {
+            metrics->record_jump(_priority);
+        }
+    }
+
+}  // namespace Metrics
+
+}  // namespace TaskManager
@@ -0,0 +1,333 @@
+#include "task_profiler.hpp"
+#include "abst_task.hpp"
+#include "task_analysis.hpp"
+#include "task_log.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iterator>
+#include <ostream>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace TaskManager
+{
+
+namespace Profiling
+{
+    namespace
+    {
+        thread_local Profiler* t_current{nullptr};
+
+        constexpr const char* event_name[] = {"cycles", "instructions", "cache-misses", "branch-misses"};
+
+        std::uint64_t& counter_at(Counters& _counters, std::size_t _event) noexcept
+        {
+            switch (_event) {
+            case 0:
+                return _counters.cycles;
+            case 1:
+                return _counters.instructions;
+            case 2:
+                return _counters.cache_misses;
+            default:
+                return _counters.branch_misses;
+            }
+        }
+
+        std::uint64_t now_ns() noexcept
+        {
+            return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+#if defined(__linux__)
+        int open_event(std::uint64_t _config, int _group) noexcept
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = _config;
+            attr.read_format = PERF_FORMAT_GROUP;
+            if (_group < 0) {
+                attr.disabled = 1;  // 代表が有効になった時に揃って数え始める
+            }
+            attr.exclude_kernel = 1;  // perf_event_paranoidが2でも開けるように
+            attr.exclude_hv = 1;
+            return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, _group, 0));
+        }
+#endif
+    }
+
+
+    Counters& Counters::operator+=(const Counters& _other) noexcept
+    {
+        cycles += _other.cycles;
+        instructions += _other.instructions;
+        cache_misses += _other.cache_misses;
+        branch_misses += _other.branch_misses;
+        nanoseconds += _other.nanoseconds;
+        return *this;
+    }
+    Counters& Counters::operator-=(const Counters& _other) noexcept
+    {
+        cycles -= _other.cycles;
+        instructions -= _other.instructions;
+        cache_misses -= _other.cache_misses;
+        branch_misses -= _other.branch_misses;
+        nanoseconds -= _other.nanoseconds;
+        return *this;
+    }
+    Counters Counters::larger(const Counters& _a, const Counters& _b) noexcept
+    {
+        return {std::max(_a.cycles, _b.cycles), std::max(_a.instructions, _b.instructions),
+            std::max(_a.cache_misses, _b.cache_misses), std::max(_a.branch_misses, _b.branch_misses),
+            std::max(_a.nanoseconds, _b.nanoseconds)};
+    }
+
+
+    Profiler::Profiler()
+    {
+        m_fd.fill(-1);
+        open_events();
+    }
+
+    Profiler::~Profiler() noexcept
+    {
+        if (t_current == this) {
+            t_current = nullptr;
+        }
+#if defined(__linux__)
+        for (auto fd : m_fd) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    void Profiler::open_events()
+    {
+#if defined(__linux__)
+        constexpr std::uint64_t config[event_count] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+        m_fd[0] = open_event(config[0], -1);
+        if (m_fd[0] < 0) {
+            m_fallback_reason = std::string{"perf_event_open: "} + std::strerror(errno);
+            return;
+        }
+        m_order[m_opened++] = 0;
+
+        // サイクル数以外は、開けなかった物だけ諦める
+        for (std::size_t event = 1; event < event_count; ++event) {
+            m_fd[event] = open_event(config[event], m_fd[0]);
+            if (m_fd[event] >= 0) {
+                m_order[m_opened++] = event;
+            }
+        }
+
+        ioctl(m_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(m_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+        m_fallback_reason = "perf_event_open is not available on this platform";
+#endif
+    }
+
+    Counters Profiler::read() const noexcept
+    {
+        Counters result;
+#if defined(__linux__)
+        if (m_opened > 0) {
+            std::uint64_t buffer[1 + event_count];
+            auto length = ::read(m_fd[0], buffer, sizeof(buffer));
+            if (length >= static_cast<ssize_t>(sizeof(std::uint64_t))) {
+                auto count = std::min<std::uint64_t>(buffer[0], m_opened);
+                for (std::size_t i = 0; i < count; ++i) {
+                    counter_at(result, m_order[i]) = buffer[1 + i];
+                }
+            }
+        }
+#endif
+        result.nanoseconds = now_ns();
+        return result;
+    }
+
+    std::vector<std::string> Profiler::events() const
+    {
+        std::vector<std::string> result;
+        for (std::size_t i = 0; i < m_opened; ++i) {
+            result.emplace_back(event_name[m_order[i]]);
+        }
+        return result;
+    }
+
+
+    bool Profiler::add(Expr::AbstTask& _node)
+    {
+        auto id = _node.node_id();
+        auto position = std::lower_bound(m_selected.begin(), m_selected.end(), std::make_pair(id, std::size_t{0}));
+        if (position != m_selected.end() && position->first == id) {
+            return false;
+        }
+
+        NodeProfile slot;
+        slot.node = id;
+        slot.type = Analysis::type_name(_node);
+        m_selected.insert(position, {id, m_slot.size()});
+        m_slot.push_back(std::move(slot));
+        return true;
+    }
+
+    std::size_t Profiler::select(Expr::AbstTask& _node, bool _subtree)
+    {
+        if (!_subtree) {
+            return add(_node) ? 1 : 0;
+        }
+        std::size_t added = 0;
+        _node.visit([&](Expr::AbstTask& _task) { added += add(_task) ? 1 : 0; });
+        return added;
+    }
+
+    std::size_t Profiler::select_if(Expr::AbstTask& _root, const std::function<bool(const Expr::AbstTask&)>& _predicate)
+    {
+        std::size_t matched = 0;
+        _root.visit([&](Expr::AbstTask& _task) {
+            if (_predicate(_task)) {
+                add(_task);
+                ++matched;
+            }
+        });
+        if (matched == 0) {
+            static Log::Site site{Log::Level::Warning, "Profiler::select_if() matched no node"};
+            Log::post(site);
+        }
+        return matched;
+    }
+
+    void Profiler::clear() noexcept
+    {
+        for (auto& slot : m_slot) {
+            slot.calls = 0;
+            slot.total = slot.self = slot.max = Counters{};
+        }
+    }
+
+    std::vector<NodeProfile> Profiler::report() const
+    {
+        std::vector<NodeProfile> result;
+        std::copy_if(m_slot.begin(), m_slot.end(), std::back_inserter(result), [](const NodeProfile& _slot) { return _slot.calls > 0; });
+
+        auto hardware = this->hardware();
+        std::stable_sort(result.begin(), result.end(), [hardware](const NodeProfile& _a, const NodeProfile& _b) {
+            return hardware ? _a.total.cycles > _b.total.cycles : _a.total.nanoseconds > _b.total.nanoseconds;
+        });
+        return result;
+    }
+
+    std::size_t Profiler::unevaluated() const noexcept
+    {
+        return static_cast<std::size_t>(std::count_if(m_slot.begin(), m_slot.end(), [](const NodeProfile& _slot) { return _slot.calls == 0; }));
+    }
+
+    void Profiler::print(std::ostream& _os) const
+    {
+        auto per_call = [](std::uint64_t _value, std::uint64_t _calls) { return static_cast<double>(_value) / static_cast<double>(_calls); };
+
+        if (hardware()) {
+            _os << "# events:";
+            for (auto& event : events()) {
+                _os << ' ' << event;
+            }
+            _os << '\n';
+        } else {
+            _os << "# wall clock only (" << m_fallback_reason << ")\n";
+        }
+        _os << std::setw(8) << "node" << std::setw(10) << "calls" << std::setw(12) << "ns/call" << std::setw(12) << "self ns"
+            << std::setw(12) << "cyc/call" << std::setw(8) << "ipc" << std::setw(12) << "cmiss/call" << std::setw(12) << "bmiss/call"
+            << "  type\n";
+
+        auto flags = _os.flags();
+        _os << std::fixed << std::setprecision(1);
+        for (auto& slot : report()) {
+            _os << std::setw(8) << slot.node << std::setw(10) << slot.calls
+                << std::setw(12) << per_call(slot.total.nanoseconds, slot.calls)
+                << std::setw(12) << per_call(slot.self.nanoseconds, slot.calls)
+                << std::setw(12) << per_call(slot.total.cycles, slot.calls)
+                << std::setw(8) << std::setprecision(2) << slot.total.ipc() << std::setprecision(1)
+                << std::setw(12) << per_call(slot.total.cache_misses, slot.calls)
+                << std::setw(12) << per_call(slot.total.branch_misses, slot.calls)
+                << "  " << slot.type << '\n';
+        }
+        _os.flags(flags);
+
+        if (auto count = unevaluated()) {
+            _os << "# " << count << " of " << m_slot.size() << " selected nodes were never evaluated"
+                << " (a variable copied into a TaskSet is not the node in the tree: select nodes reached from the root)\n";
+        }
+    }
+
+
+    Profiler* Profiler::current() noexcept
+    {
+        return t_current;
+    }
+
+    std::size_t Profiler::enter(Introspection::node_id _id) noexcept
+    {
+        auto position = std::lower_bound(m_selected.begin(), m_selected.end(), std::make_pair(_id, std::size_t{0}));
+        if (position == m_selected.end() || position->first != _id || m_depth >= max_depth) {
+            return npos;
+        }
+
+        auto frame = m_depth++;
+        m_stack[frame].slot = position->second;
+        m_stack[frame].children = Counters{};
+        m_stack[frame].begin = read();  // 読むのは最後にして、探索の手間を含めない
+        return frame;
+    }
+
+    void Profiler::leave(std::size_t _frame) noexcept
+    {
+        if (_frame == npos) {
+            return;
+        }
+        auto delta = read() - m_stack[_frame].begin;
+
+        // 途中のeval()が例外で抜けていても、ここで積み直す
+        m_depth = _frame;
+        auto& slot = m_slot[m_stack[_frame].slot];
+        ++slot.calls;
+        slot.total += delta;
+        slot.self += delta - m_stack[_frame].children;
+        slot.max = Counters::larger(slot.max, delta);
+        if (_frame > 0) {
+            m_stack[_frame - 1].children += delta;
+        }
+    }
+
+
+    Profiler::Scope::Scope(Profiler& _profiler) noexcept
+        : m_previous{t_current}
+    {
+        t_current = &_profiler;
+    }
+    Profiler::Scope::~Scope() noexcept
+    {
+        if (t_current) {
+            t_current->m_depth = 0;
+        }
+        t_current = m_previous;
+    }
+
+}  // namespace Profiling
+
+}  // namespace TaskManager
@@ -0,0 +1,260 @@
+#include "task_rate.hpp"
+#include "task_fleet.hpp"
+#include "task_replay.hpp"
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <vector>
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+
+    namespace
+    {
+        /*!
+         * @brief 多重レートのブロックが、どの周期にどれだけ集まっているかの表
+         * @detail 登録された全ての周期数の最小公倍数(上限有り)を1巡とし、1巡の中の各周期に何個のブロックが当たるかを数える。
+         */
+        class PhaseTable
+        {
+        private:
+            static constexpr std::size_t max_horizon = 1 << 16;
+
+            std::mutex m_mutex;
+            std::map<std::pair<std::size_t, std::size_t>, std::size_t> m_user_map;  //!< (周期数, 位相)ごとの数
+            std::size_t m_horizon{1};
+            std::vector<std::size_t> m_load{0};
+
+            template <typename Func>
+            void for_each_slot(std::size_t _period, std::size_t _phase, Func&& _func)
+            {
+                for (auto slot = _phase % m_horizon; slot < m_horizon; slot += _period) {
+                    _func(m_load[slot]);
+                }
+            }
+
+            void extend(std::size_t _period)
+            {
+                auto horizon = std::lcm(m_horizon, _period);
+                if (horizon == m_horizon || horizon > max_horizon) {
+                    return;  // 上限を超える時は今の1巡のまま近似する
+                }
+
+                m_horizon = horizon;
+                m_load.assign(m_horizon, 0);
+                for (auto& user : m_user_map) {
+                    for_each_slot(user.first.first, user.first.second, [&](std::size_t& _load) { _load += user.second; });
+                }
+            }
+
+        public:
+            std::size_t acquire(std::size_t _period)
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                extend(_period);
+
+                // 当たる周期の中で最も混んでいる所が一番空いている位相を選ぶ。同じなら合計の少ない方
+                std::size_t best_phase = 0;
+                std::pair<std::size_t, std::size_t> best_cost{static_cast<std::size_t>(-1), 0};
+                for (std::size_t phase = 0; phase < _period && phase < m_horizon; ++phase) {
+                    std::pair<std::size_t, std::size_t> cost{0, 0};
+                    for_each_slot(_period, phase, [&](std::size_t& _load) {
+                        cost.first = std::max(cost.first, _load);
+                        cost.second += _load;
+                    });
+                    if (cost < best_cost) {
+                        best_cost = cost;
+                        best_phase = phase;
+                    }
+                }
+
+                ++m_user_map[{_period, best_phase}];
+                for_each_slot(_period, best_phase, [](std::size_t& _load) { ++_load; });
+                return best_phase;
+            }
+
+            void release(std::size_t _period, std::size_t _phase) noexcept
+            {
+                std::lock_guard<std::mutex> lock{m_mutex};
+                auto user = m_user_map.find({_period, _phase});
+                if (user == m_user_map.end()) {
+                    return;
+                }
+                if (--user->second == 0) {
+                    m_user_map.erase(user);
+                }
+                for_each_slot(_period, _phase, [](std::size_t& _load) {
+                    if (_load > 0) {
+                        --_load;
+                    }
+                });
+            }
+        };
+
+        PhaseTable& phase_table()
+        {
+            static PhaseTable table;
+            return table;
+        }
+    }
+
+    std::size_t acquire_rate_phase(std::size_t _period)
+    {
+        return phase_table().acquire(_period);
+    }
+    void release_rate_phase(std::size_t _period, std::size_t _phase) noexcept
+    {
+        phase_table().release(_period, _phase);
+    }
+
+
+    MultiRate::MultiRate(std::size_t _period, double _hz, std::optional<std::size_t> _phase, TaskSet&& _taskset)
+        : m_taskset{std::move(_taskset)},
+          m_period{_period},
+          m_hz{_hz},
+          m_fixed_phase{_phase}
+    {
+    }
+
+    MultiRate::~MultiRate() noexcept
+    {
+        release_phase();
+    }
+
+    MultiRate::MultiRate(const MultiRate& _other)
+        : AbstTask{_other},
+          m_taskset{_other.m_taskset},
+          m_period{_other.m_period},
+          m_hz{_other.m_hz},
+          m_fixed_phase{_other.m_fixed_phase}
+    {
+    }
+    MultiRate& MultiRate::operator=(const MultiRate& _other) &
+    {
+        AbstTask::operator=(_other);
+        release_phase();
+        m_taskset = _other.m_taskset;
+        m_period = _other.m_period;
+        m_hz = _other.m_hz;
+        m_fixed_phase = _other.m_fixed_phase;
+        return *this;
+    }
+    MultiRate::MultiRate(MultiRate&& _other) noexcept
+        : AbstTask{std::move(_other)},
+          m_taskset{std::move(_other.m_taskset)},
+          m_period{_other.m_period},
+          m_hz{_other.m_hz},
+          m_fixed_phase{_other.m_fixed_phase}
+    {
+    }
+    MultiRate& MultiRate::operator=(MultiRate&& _other) & noexcept
+    {
+        AbstTask::operator=(std::move(_other));
+        release_phase();
+        m_taskset = std::move(_other.m_taskset);
+        m_period = _other.m_period;
+        m_hz = _other.m_hz;
+        m_fixed_phase = _other.m_fixed_phase;
+        return *this;
+    }
+
+
+    void MultiRate::release_phase() noexcept
+    {
+        if (m_owns_phase) {
+            release_rate_phase(m_active_period, m_phase.value());
+            m_owns_phase = false;
+        }
+        m_phase = std::nullopt;
+    }
+
+    void MultiRate::init()
+    {
+        assign_phase();
+    }
+
+    void MultiRate::assign_phase()
+    {
+        auto period = m_period;
+        if (period == 0) {
+            auto ratio = m_hz > 0.0 ? std::round(Cycle::frequency() / m_hz) : 1.0;
+            period = ratio < 1.0 ? 1 : static_cast<std::size_t>(ratio);
+        }
+
+        if (m_phase && period == m_active_period) {  // 2度目以降は同じ位相を使い続ける
+            return;
+        }
+
+        release_phase();
+        m_active_period = period;
+        if (m_fixed_phase) {
+            m_phase = m_fixed_phase.value() % period;
+        } else {
+            m_phase = acquire_rate_phase(period);
+            m_owns_phase = true;
+        }
+    }
+
+    void MultiRate::advance_turn() noexcept
+    {
+        auto epoch = Cycle::epoch();
+        if (m_turn_epoch == 0) {  // 初めての評価。他のブロックと位相を揃えるため周期の番号から始める
+            m_turn = epoch;
+        } else if (epoch != m_turn_epoch) {
+            ++m_turn;
+        }
+        m_turn_epoch = epoch;
+    }
+
+    NextTask MultiRate::eval()
+    {
+        advance_turn();
+        if (!Replay::condition([this] { return m_turn % m_active_period == m_phase.value(); })) {  // 自分の番ではない
+            return false;
+        }
+        return evaluate(m_taskset);
+    }
+
+    void MultiRate::interrupt()
+    {
+        force_quit(m_taskset);
+        quit();
+    }
+
+    void MultiRate::for_each_child(const std::function<void(AbstTask&)>& _func)
+    {
+        _func(m_taskset);
+    }
+    void MultiRate::prepare()
+    {
+        assign_phase();
+    }
+    std::uint64_t MultiRate::waiting_cycles()
+    {
+        // 次に評価される周期m_turn+1から数えて、自分の番の手前までの周期数
+        auto next = (m_turn + 1) % m_active_period;
+        return (m_phase.value() + m_active_period - next) % m_active_period;
+    }
+    void MultiRate::skip_waiting(std::uint64_t _cycles)
+    {
+        m_turn += _cycles;
+    }
+    std::uint32_t MultiRate::compile(Fleet::Builder& _builder)
+    {
+        assign_phase();
+
+        auto index = _builder.open(Fleet::Op::Every, false);
+        _builder.node(index).parameter = static_cast<std::int64_t>(m_active_period);
+        _builder.node(index).phase = static_cast<std::int64_t>(m_phase.value());
+        _builder.set_children(index, {_builder.add(m_taskset)});
+        return index;
+    }
+
+}  // namespace Expr
+
+}  // namespace TaskManager
@@ -0,0 +1,233 @@
+#include "task_realtime.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#endif
+
+#ifdef TASK_MANAGER_RT_CHECK
+#include <new>
+#endif
+
+namespace TaskManager
+{
+
+namespace RealTime
+{
+    namespace
+    {
+        std::atomic<Check> s_check{Check::Off};
+        std::atomic<std::size_t> s_allocations{0};
+        std::atomic<bool> s_reuse_jump_targets{false};
+
+        thread_local int t_resume_depth{0};
+    }
+
+    void set_check(Check _check) noexcept
+    {
+        s_check.store(_check, std::memory_order_relaxed);
+    }
+    Check check() noexcept
+    {
+        return s_check.load(std::memory_order_relaxed);
+    }
+
+    std::size_t allocations() noexcept
+    {
+        return s_allocations.load(std::memory_order_relaxed);
+    }
+    void reset_allocations() noexcept
+    {
+        s_allocations.store(0, std::memory_order_relaxed);
+    }
+
+    void note_allocation() noexcept
+    {
+        if (t_resume_depth == 0) {
+            return;
+        }
+        switch (check()) {
+        case Check::Off:
+            break;
+        case Check::Count:
+            s_allocations.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case Check::Abort:
+            std::abort();
+        default:
+            break;
+        }
+    }
+
+    bool in_resume() noexcept
+    {
+        return t_resume_depth > 0;
+    }
+
+    void set_reuse_jump_targets(bool _reuse) noexcept
+    {
+        s_reuse_jump_targets.store(_reuse, std::memory_order_relaxed);
+    }
+    bool reuse_jump_targets() noexcept
+    {
+        return s_reuse_jump_targets.load(std::memory_order_relaxed);
+    }
+
+    ResumeScope::ResumeScope() noexcept
+    {
+        ++t_resume_depth;
+    }
+    ResumeScope::~ResumeScope() noexcept
+    {
+        --t_resume_depth;
+    }
+
+
+    namespace
+    {
+        constexpr std::size_t page_size = 4096;
+
+        // 1ページずつ再帰してスタックを伸ばし、触っておく
+        __attribute__((noinline)) void touch_stack(std::size_t _remaining) noexcept
+        {
+            volatile char page[page_size];
+            page[0] = 0;
+            if (_remaining > page_size) {
+                touch_stack(_remaining - page_size);
+            }
+            page[page_size - 1] = page[0];
+        }
+
+        std::string failure(const char* _what, int _error)
+        {
+            return std::string{_what} + ": " + std::strerror(_error);
+        }
+    }
+
+    ThreadReport setup_thread(const ThreadConfig& _config)
+    {
+        ThreadReport report;
+
+#ifdef __linux__
+        if (_config.priority > 0) {
+            sched_param param{};
+            param.sched_priority = _config.priority;
+            if (auto error = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)) {
+                report.failures.push_back(failure("SCHED_FIFO", error));
+            } else {
+                report.scheduling = true;
+            }
+        }
+
+        if (_config.cpu >= 0) {
+            if (pin_current_thread(_config.cpu)) {
+                report.pinned = true;
+            } else {
+                report.failures.push_back("affinity: cannot pin to cpu " + std::to_string(_config.cpu));
+            }
+        }
+
+        if (_config.lock_memory) {
+            if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+                report.failures.push_back(failure("mlockall", errno));
+            } else {
+                report.memory_locked = true;
+            }
+        }
+#else
+        if (_config.priority > 0) {
+            report.failures.push_back("SCHED_FIFO: not supported on this platform");
+        }
+        if (_config.cpu >= 0) {
+            report.failures.push_back("affinity: not supported on this platform");
+        }
+        if (_config.lock_memory) {
+            report.failures.push_back("mlockall: not supported on this platform");
+        }
+#endif
+
+        if (_config.stack_prefault > 0) {
+            touch_stack(_config.stack_prefault);
+            report.stack_prefaulted = true;
+        }
+
+        return report;
+    }
+
+    bool pin_current_thread(int _cpu) noexcept
+    {
+#ifdef __linux__
+        if (_cpu < 0 || _cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(static_cast<std::size_t>(_cpu), &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+        (void)_cpu;
+        return false;
+#endif
+    }
+
+    void pre_touch(Expr::AbstTask& _root)
+    {
+        _root.warm_up();
+        _root.visit([](Expr::AbstTask& _task) {
+            // 節点の先頭を読むだけで、その節点の載っているページを触れる
+            volatile const char* head = reinterpret_cast<const char*>(&_task);
+            (void)*head;
+        });
+    }
+
+}  // namespace RealTime
+
+}  // namespace TaskManager
+
+
+#ifdef TASK_MANAGER_RT_CHECK
+
+// 全ての確保をnote_allocation()に通す
+namespace
+{
+    void* allocate(std::size_t _size)
+    {
+        TaskManager::RealTime::note_allocation();
+        if (auto ptr = std::malloc(_size ? _size : 1)) {
+            return ptr;
+        }
+        throw std::bad_alloc{};
+    }
+    void* allocate(std::size_t _size, std::align_val_t _align)
+    {
+        TaskManager::RealTime::note_allocation();
+        auto align = static_cast<std::size_t>(_align);
+        auto size = (_size + align - 1) / align * align;
+        if (auto ptr = std::aligned_alloc(align, size ? size : align)) {
+            return ptr;
+        }
+        throw std::bad_alloc{};
+    }
+}
+
+void* operator new(std::size_t _size) { return allocate(_size); }
+void* operator new[](std::size_t _size) { return allocate(_size); }
+void* operator new(std::size_t _size, std::align_val_t _align) { return allocate(_size, _align); }
+void* operator new[](std::size_t _size, std::align_val_t _align) { return allocate(_size, _align); }
+
+void operator delete(void* _ptr) noexcept { std::free(_ptr); }
+void operator delete[](void* _ptr) noexcept { std::free(_ptr); }
+void operator delete(void* _ptr, std::size_t) noexcept { std::free(_ptr); }
+void operator delete[](void* _ptr, std::size_t) noexcept { std::free(_ptr); }
+void operator delete(void* _ptr, std::align_val_t) noexcept { std::free(_ptr); }
+void operator delete[](void* _ptr, std::align_val_t) noexcept { std::free(_ptr); }
+void operator delete(void* _ptr, std::size_t, std::align_val_t) noexcept { std::free(_ptr); }
+void operator delete[](void* _ptr, std::size_t, std::align_val_t) noexcept { std::free(_ptr); }
+
+#endif
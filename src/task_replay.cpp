@@ -0,0 +1,247 @@
+#include "task_replay.hpp"
+#include "abst_task.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <istream>
+#include <iterator>
+#include <ostream>
+
+namespace TaskManager
+{
+
+namespace Replay
+{
+    thread_local Session* Session::s_current{nullptr};
+
+    namespace
+    {
+        constexpr char magic[8] = {'T', 'A', 'S', 'K', 'R', 'P', 'L', 'Y'};
+        constexpr std::uint8_t format_version = 1;
+        constexpr std::size_t header_size = sizeof(magic) + 1;
+
+        // 周期1つの形: ビット数(varint), ビット列(1byteに8個), キーの数(varint), キー(zigzag varint)...
+        void put_varint(std::vector<std::uint8_t>& _log, std::uint64_t _value)
+        {
+            while (_value >= 0x80) {
+                _log.push_back(static_cast<std::uint8_t>(_value | 0x80));
+                _value >>= 7;
+            }
+            _log.push_back(static_cast<std::uint8_t>(_value));
+        }
+
+        std::uint64_t get_varint(const std::vector<std::uint8_t>& _log, std::size_t& _position)
+        {
+            std::uint64_t value = 0;
+            for (unsigned int shift = 0; shift < 64; shift += 7) {
+                if (_position >= _log.size()) {
+                    throw std::runtime_error{"replay: truncated log"};
+                }
+                auto byte = _log[_position++];
+                value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) {
+                    return value;
+                }
+            }
+            throw std::runtime_error{"replay: broken varint"};
+        }
+
+        std::uint64_t zigzag(std::int64_t _value) noexcept
+        {
+            return (static_cast<std::uint64_t>(_value) << 1) ^ static_cast<std::uint64_t>(_value >> 63);
+        }
+        std::int64_t unzigzag(std::uint64_t _value) noexcept
+        {
+            return static_cast<std::int64_t>(_value >> 1) ^ -static_cast<std::int64_t>(_value & 1);
+        }
+
+        //! @brief _positionの周期を読み飛ばす
+        void skip_cycle(const std::vector<std::uint8_t>& _log, std::size_t& _position)
+        {
+            auto bits = get_varint(_log, _position);
+            _position += static_cast<std::size_t>((bits + 7) / 8);
+            if (_position > _log.size()) {
+                throw std::runtime_error{"replay: truncated log"};
+            }
+            auto keys = get_varint(_log, _position);
+            for (std::uint64_t i = 0; i < keys; ++i) {
+                get_varint(_log, _position);
+            }
+        }
+    }
+
+
+    void Session::enter() noexcept
+    {
+        m_previous = s_current;
+        s_current = this;
+    }
+    void Session::leave() noexcept
+    {
+        s_current = m_previous;
+    }
+
+    void Session::put_boolean(bool _value)
+    {
+        auto word = m_bit_count / 64;
+        if (word >= m_bits.size()) {
+            m_bits.push_back(0);
+        }
+        if (_value) {
+            m_bits[word] |= std::uint64_t{1} << (m_bit_count % 64);
+        }
+        ++m_bit_count;
+    }
+    bool Session::next_boolean()
+    {
+        if (m_bit_index >= m_bit_count) {
+            throw Divergence{"replay: the tree evaluated more conditions than recorded"};
+        }
+        auto index = m_bit_index++;
+        return (m_bits[index / 64] >> (index % 64)) & 1;
+    }
+    void Session::put_key(std::int64_t _value)
+    {
+        m_keys.push_back(_value);
+    }
+    std::int64_t Session::next_key()
+    {
+        if (m_key_index >= m_keys.size()) {
+            throw Divergence{"replay: the tree evaluated more Switch keys than recorded"};
+        }
+        return m_keys[m_key_index++];
+    }
+
+
+    Recorder::Recorder(std::size_t _reserve)
+        : Session{false}
+    {
+        m_log.reserve(_reserve);
+        m_bits.reserve(64);
+        m_keys.reserve(64);
+    }
+
+    void Recorder::begin() noexcept
+    {
+        std::fill(m_bits.begin(), m_bits.end(), 0);
+        m_bit_count = 0;
+        m_keys.clear();
+        enter();
+    }
+
+    void Recorder::commit()
+    {
+        leave();
+
+        put_varint(m_log, m_bit_count);
+        for (std::size_t i = 0; i < (m_bit_count + 7) / 8; ++i) {
+            m_log.push_back(static_cast<std::uint8_t>(m_bits[i / 8] >> (i % 8 * 8)));
+        }
+        put_varint(m_log, m_keys.size());
+        for (auto key : m_keys) {
+            put_varint(m_log, zigzag(key));
+        }
+        ++m_cycles;
+    }
+
+    void Recorder::resume(Expr::AbstTask& _root)
+    {
+        record([&_root] { _root.resume(); });
+    }
+
+    std::vector<std::uint8_t> Recorder::data() const
+    {
+        std::vector<std::uint8_t> result{std::begin(magic), std::end(magic)};
+        result.push_back(format_version);
+        result.insert(result.end(), m_log.begin(), m_log.end());
+        return result;
+    }
+
+    void Recorder::save(std::ostream& _os) const
+    {
+        _os.write(magic, sizeof(magic));
+        _os.put(static_cast<char>(format_version));
+        _os.write(reinterpret_cast<const char*>(m_log.data()), static_cast<std::streamsize>(m_log.size()));
+    }
+    void Recorder::save(const std::string& _path) const
+    {
+        std::ofstream file{_path, std::ios::binary};
+        save(file);
+        if (!file) {
+            throw std::runtime_error{"replay: cannot write " + _path};
+        }
+    }
+
+
+    Player::Player(std::vector<std::uint8_t> _data)
+        : Session{true},
+          m_log{std::move(_data)},
+          m_position{header_size}
+    {
+        if (m_log.size() < header_size || !std::equal(std::begin(magic), std::end(magic), m_log.begin()) || m_log[sizeof(magic)] != format_version) {
+            throw std::runtime_error{"replay: not a replay log"};
+        }
+
+        // 周期の数を数えておく(壊れていればここで分かる)
+        for (auto position = header_size; position < m_log.size(); ++m_cycles) {
+            skip_cycle(m_log, position);
+        }
+    }
+
+    Player Player::load(std::istream& _is)
+    {
+        return Player{std::vector<std::uint8_t>{std::istreambuf_iterator<char>{_is}, std::istreambuf_iterator<char>{}}};
+    }
+    Player Player::load(const std::string& _path)
+    {
+        std::ifstream file{_path, std::ios::binary};
+        if (!file) {
+            throw std::runtime_error{"replay: cannot read " + _path};
+        }
+        return load(file);
+    }
+
+    bool Player::begin()
+    {
+        if (m_played >= m_cycles) {
+            return false;
+        }
+
+        m_bit_count = static_cast<std::size_t>(get_varint(m_log, m_position));
+        m_bits.assign((m_bit_count + 63) / 64, 0);
+        for (std::size_t i = 0; i < (m_bit_count + 7) / 8; ++i) {
+            m_bits[i / 8] |= static_cast<std::uint64_t>(m_log[m_position++]) << (i % 8 * 8);
+        }
+        m_bit_index = 0;
+
+        m_keys.resize(static_cast<std::size_t>(get_varint(m_log, m_position)));
+        for (auto& key : m_keys) {
+            key = unzigzag(get_varint(m_log, m_position));
+        }
+        m_key_index = 0;
+
+        ++m_played;
+        return true;
+    }
+
+    void Player::finish() const
+    {
+        if (m_bit_index != m_bit_count || m_key_index != m_keys.size()) {
+            throw Divergence{"replay: the tree evaluated fewer conditions than recorded in cycle " + std::to_string(m_played)};
+        }
+    }
+
+    bool Player::resume(Expr::AbstTask& _root)
+    {
+        return replay([&_root] { _root.resume(); });
+    }
+
+    void Player::rewind() noexcept
+    {
+        m_position = header_size;
+        m_played = 0;
+    }
+
+}  // namespace Replay
+
+}  // namespace TaskManager
@@ -0,0 +1,203 @@
+#include "task_sampler.hpp"
+#include "abst_task.hpp"
+#include "task_analysis.hpp"
+
+#include <algorithm>
+#include <array>
+#include <ostream>
+
+namespace TaskManager
+{
+
+namespace Profiling
+{
+    namespace
+    {
+        //! @brief folded stack形式で区切りになる文字を避ける
+        std::string sanitize(std::string _name)
+        {
+            std::replace(_name.begin(), _name.end(), ';', ':');
+            std::replace(_name.begin(), _name.end(), '\n', ' ');
+            return _name;
+        }
+    }
+
+
+    Sampler::Sampler(std::chrono::nanoseconds _period) noexcept
+        : m_period{_period > std::chrono::nanoseconds::zero() ? _period : std::chrono::milliseconds{1}}
+    {
+    }
+
+    Sampler::~Sampler() noexcept
+    {
+        stop();
+
+        // 根が先に破棄されていれば、根の持っていた分は既に手放されている
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto& root : m_root_list) {
+            if (root.task && root.stack.use_count() > 1) {
+                root.task->publish_live_stack(nullptr);
+            }
+            root.task = nullptr;
+        }
+    }
+
+
+    void Sampler::attach(Expr::AbstTask& _root, const std::string& _name)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        _root.visit([this](Expr::AbstTask& _task) {
+            m_label.emplace(_task.node_id(), sanitize(Analysis::type_name(_task)) + "#" + std::to_string(_task.node_id()));
+        });
+
+        auto found = std::find_if(m_root_list.begin(), m_root_list.end(), [&](const Root& _other) { return _other.task == &_root; });
+        if (found != m_root_list.end()) {
+            found->name = sanitize(_name);
+            return;
+        }
+
+        m_root_list.push_back({sanitize(_name), &_root, std::make_shared<Introspection::LiveStack>(), 0});
+        _root.publish_live_stack(m_root_list.back().stack);
+    }
+
+    void Sampler::detach(Expr::AbstTask& _root) noexcept
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto& root : m_root_list) {
+            if (root.task == &_root) {
+                _root.publish_live_stack(nullptr);
+                root.task = nullptr;  // 集めた数の添字を保つため、要素は残す
+            }
+        }
+    }
+
+    void Sampler::label(const Expr::AbstTask& _node, const std::string& _label)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_label[_node.node_id()] = sanitize(_label);
+    }
+
+
+    void Sampler::start()
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        if (m_thread.joinable()) {
+            return;
+        }
+        m_quit = false;
+        m_thread = std::thread{&Sampler::run, this};
+    }
+
+    void Sampler::stop() noexcept
+    {
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            m_quit = true;
+        }
+        m_cv.notify_all();
+        if (m_thread.joinable()) {
+            m_thread.join();
+        }
+    }
+
+    void Sampler::run()
+    {
+        auto next = std::chrono::steady_clock::now();
+        std::unique_lock<std::mutex> lock{m_mutex};
+        while (!m_quit) {
+            sample_locked();
+
+            // 遅れたら追い付こうとせず、今から数え直す
+            next += m_period;
+            auto now = std::chrono::steady_clock::now();
+            if (next < now) {
+                next = now + m_period;
+            }
+            m_cv.wait_until(lock, next, [this] { return m_quit; });
+        }
+    }
+
+    void Sampler::sample()
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        sample_locked();
+    }
+
+    void Sampler::sample_locked()
+    {
+        std::array<Introspection::node_id, Introspection::LiveStack::max_depth> path;
+        for (std::size_t index = 0; index < m_root_list.size(); ++index) {
+            auto& root = m_root_list[index];
+            if (!root.task) {
+                continue;
+            }
+
+            std::size_t depth = 0;
+            ++m_statistics.samples;
+            if (!root.stack->try_read(path, depth)) {
+                ++m_statistics.discarded;
+                continue;
+            }
+            if (depth == 0) {
+                ++m_statistics.idle;
+                ++root.idle;
+                continue;
+            }
+
+            std::vector<Introspection::node_id> key{path.begin(), path.begin() + static_cast<std::ptrdiff_t>(std::min(depth, path.size()))};
+            if (depth > path.size()) {
+                key.push_back(0);  // 深すぎて記録できなかった部分
+            }
+            ++m_count[{index, std::move(key)}];
+        }
+    }
+
+
+    Sampler::Statistics Sampler::statistics() const
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return m_statistics;
+    }
+
+    void Sampler::clear()
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_count.clear();
+        m_statistics = Statistics{};
+        for (auto& root : m_root_list) {
+            root.idle = 0;
+        }
+    }
+
+    std::string Sampler::frame(Introspection::node_id _id) const
+    {
+        if (_id == 0) {
+            return "[truncated]";
+        }
+        auto found = m_label.find(_id);
+        return found != m_label.end() ? found->second : "#" + std::to_string(_id);
+    }
+
+    void Sampler::write_folded(std::ostream& _os, bool _idle) const
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto& count : m_count) {
+            _os << m_root_list[count.first.first].name;
+            for (auto id : count.first.second) {
+                _os << ';' << frame(id);
+            }
+            _os << ' ' << count.second << '\n';
+        }
+        if (_idle) {
+            for (auto& root : m_root_list) {
+                if (root.idle > 0) {
+                    _os << root.name << ";[idle] " << root.idle << '\n';
+                }
+            }
+        }
+    }
+
+}  // namespace Profiling
+
+}  // namespace TaskManager
@@ -0,0 +1,145 @@
+#include "task_scheduler.hpp"
+#include "task_cycle.hpp"
+#include "task_replay.hpp"
+
+#include <algorithm>
+
+namespace TaskManager
+{
+
+thread_local Scheduler* Scheduler::s_active{nullptr};
+
+namespace
+{
+    //! @brief 実行時間の移動平均(1/8ずつ寄せる)
+    Scheduler::clock::duration smooth(Scheduler::clock::duration _estimate, Scheduler::clock::duration _sample) noexcept
+    {
+        return _estimate == Scheduler::clock::duration::zero() ? _sample : (_estimate * 7 + _sample) / 8;
+    }
+}
+
+
+Scheduler::Scheduler(clock::duration _budget, std::size_t _max_defer) noexcept
+    : m_budget{_budget},
+      m_max_defer{_max_defer}
+{
+}
+
+
+void Scheduler::add_root(const std::shared_ptr<Expr::AbstTask>& _task, int _priority, Criticality _criticality)
+{
+    if (!_task) {
+        return;
+    }
+    _task->start();
+
+    Root root{_task, {}};
+    root.report.priority = _priority;
+    root.report.criticality = _criticality;
+
+    // 区分の順、同じ区分の中では優先度の高い順。同じなら加えた順
+    auto position = std::upper_bound(m_root_list.begin(), m_root_list.end(), root, [](const Root& _a, const Root& _b) {
+        if (_a.report.criticality != _b.report.criticality) {
+            return _a.report.criticality < _b.report.criticality;
+        }
+        return _a.report.priority > _b.report.priority;
+    });
+    m_root_list.insert(position, std::move(root));
+}
+
+
+void Scheduler::cycle()
+{
+    Cycle::Scope scope;
+
+    auto begin = clock::now();
+    m_deadline = begin + m_budget;
+
+    auto previous = s_active;
+    s_active = this;
+
+    for (m_current = 0; m_current < m_root_list.size(); ++m_current) {
+        auto& root = m_root_list[m_current];
+        if (!root.task->running()) {
+            continue;
+        }
+
+        if (root.report.criticality != Criticality::Critical) {
+            if (Replay::condition([&root] { return should_defer(root.report.priority, root.report.estimate, root.report.streak); })) {
+                ++root.report.deferred;
+                ++root.report.streak;
+                ++m_report.deferred_roots;
+                continue;
+            }
+            if (root.report.streak >= m_max_defer) {
+                ++root.report.forced;
+                ++m_report.forced;
+            }
+        }
+        root.report.streak = 0;
+
+        auto start = clock::now();
+        try {
+            root.task->resume();
+        } catch (...) {
+            s_active = previous;
+            throw;
+        }
+        root.report.estimate = smooth(root.report.estimate, clock::now() - start);
+    }
+
+    s_active = previous;
+
+    m_report.last_cycle = clock::now() - begin;
+    ++m_report.cycles;
+    if (m_report.last_cycle > m_budget) {
+        ++m_report.over_budget;
+    }
+}
+
+
+bool Scheduler::running() const noexcept
+{
+    return std::any_of(m_root_list.begin(), m_root_list.end(), [](const Root& _root) { return _root.task->running(); });
+}
+
+std::vector<Scheduler::RootReport> Scheduler::root_report() const
+{
+    std::vector<RootReport> result;
+    result.reserve(m_root_list.size());
+    for (auto& root : m_root_list) {
+        result.push_back(root.report);
+    }
+    return result;
+}
+
+
+Scheduler::clock::duration Scheduler::reserve(int _priority) const noexcept
+{
+    clock::duration sum{};
+    for (auto i = m_current + 1; i < m_root_list.size(); ++i) {
+        auto& report = m_root_list[i].report;
+        if (report.criticality == Criticality::Critical || report.priority > _priority) {
+            sum += report.estimate;
+        }
+    }
+    return sum;
+}
+
+bool Scheduler::should_defer(int _priority, clock::duration _estimate, std::size_t _streak) noexcept
+{
+    auto self = s_active;
+    if (!self || _streak >= self->m_max_defer) {
+        return false;
+    }
+    return clock::now() + _estimate + self->reserve(_priority) > self->m_deadline;
+}
+
+void Scheduler::count_subtree(bool _deferred) noexcept
+{
+    if (auto self = s_active) {
+        ++(_deferred ? self->m_report.deferred_subtrees : self->m_report.forced);
+    }
+}
+
+}  // namespace TaskManager
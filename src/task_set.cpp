@@ -1,4 +1,5 @@
 #include "task_set.hpp"
+#include "task_fleet.hpp"
 
 namespace TaskManager
 {
@@ -10,28 +11,32 @@ TaskSet::TaskSet() noexcept
 {
 }
 
-void TaskSet::reconstruct()
+void TaskSet::reconstruct(const TaskSet& _other)
 {
-    for (unsigned int i{0}; i < m_rector_list.size(); ++i) {
-        m_task_list.at(i) = m_rector_list.at(i)(m_task_list.at(i));
+    // ポインタを一旦コピーしてから差し替えると、参照カウントの増減が無駄になる
+    //     自己代入に備え、別のリストに作ってから入れ替える
+    decltype(m_task_list) task_list;
+    task_list.reserve(_other.m_task_list.size());
+    for (decltype(m_task_list)::size_type i{0}; i < _other.m_task_list.size(); ++i) {
+        task_list.push_back(_other.m_rector_list[i](_other.m_task_list[i]));
     }
+    m_task_list = std::move(task_list);
 }
 
 TaskSet::TaskSet(const TaskSet& _other)
     : AbstTask{_other},
-      m_task_list{_other.m_task_list},
+      m_task_list{},
       m_index{0},
       m_rector_list{_other.m_rector_list}
 {
-    reconstruct();
+    reconstruct(_other);
 }
 TaskSet& TaskSet::operator=(const TaskSet& _other) &
 {
     AbstTask::operator=(_other);
-    m_task_list = _other.m_task_list;
     m_index = 0;
     m_rector_list = _other.m_rector_list;
-    reconstruct();
+    reconstruct(_other);
     return *this;
 }
 TaskSet::TaskSet(TaskSet&& _other) noexcept
@@ -80,4 +85,33 @@ void TaskSet::interrupt()
     quit();
 }
 
+void TaskSet::for_each_child(const std::function<void(AbstTask&)>& _func)
+{
+    for (auto& task : m_task_list) {
+        _func(*task);
+    }
+}
+
+std::uint64_t TaskSet::waiting_cycles()
+{
+    return m_index < m_task_list.size() ? waiting_cycles_of(*m_task_list[m_index]) : 0;
+}
+void TaskSet::skip_waiting(std::uint64_t _cycles)
+{
+    if (m_index < m_task_list.size()) {
+        skip_waiting_of(*m_task_list[m_index], _cycles);
+    }
+}
+
+std::uint32_t TaskSet::compile(Fleet::Builder& _builder)
+{
+    auto index = _builder.open(Fleet::Op::Sequence, true);
+    std::vector<std::uint32_t> children;
+    for (auto& task : m_task_list) {
+        children.push_back(_builder.add(*task));
+    }
+    _builder.set_children(index, children);
+    return index;
+}
+
 }  // namespace TaskManager
@@ -0,0 +1,109 @@
+#include "task_simulation.hpp"
+#include "task_cycle.hpp"
+#include "task_replay.hpp"
+
+#include <algorithm>
+
+namespace TaskManager
+{
+
+namespace Simulation
+{
+    Runner::Runner(Clock::duration _period)
+        : m_period{_period > Clock::duration::zero() ? _period : Clock::duration{1}},
+          m_previous_frequency{Cycle::frequency()}
+    {
+        Cycle::set_frequency(1.0 / std::chrono::duration<double>{m_period}.count());
+    }
+
+    Runner::~Runner() noexcept
+    {
+        Cycle::set_frequency(m_previous_frequency);
+    }
+
+    void Runner::add_root(const std::shared_ptr<Expr::AbstTask>& _task)
+    {
+        _task->start();
+        m_root_list.push_back(_task);
+    }
+
+    bool Runner::running() const noexcept
+    {
+        return std::any_of(m_root_list.begin(), m_root_list.end(), [](const std::shared_ptr<Expr::AbstTask>& _task) { return _task->running(); });
+    }
+
+    void Runner::skip(std::uint64_t _cycles)
+    {
+        for (auto& task : m_root_list) {
+            task->skip_cycles(_cycles);
+        }
+        Cycle::advance(_cycles);
+        Clock::advance(m_period * static_cast<Clock::rep>(_cycles));
+        m_pending += m_period * static_cast<Clock::rep>(_cycles);
+
+        m_statistics.skipped += _cycles;
+        ++m_statistics.skips;
+    }
+
+    void Runner::execute()
+    {
+        Clock::advance(m_period);
+        m_pending += m_period;
+        if (m_environment) {
+            m_environment(m_pending);
+        }
+        m_pending = Clock::duration::zero();
+
+        Cycle::Scope scope;
+        for (auto& task : m_root_list) {
+            task->resume();
+        }
+        ++m_statistics.executed;
+    }
+
+    std::uint64_t Runner::step(std::uint64_t _max_cycles)
+    {
+        if (_max_cycles == 0 || !running()) {
+            return 0;
+        }
+
+        // 記録・再生中は、飛ばした周期が記録とずれるので飛ばさない
+        std::uint64_t idle = 0;
+        if (m_skip_idle && !Replay::active()) {
+            idle = std::numeric_limits<std::uint64_t>::max();
+            for (auto& task : m_root_list) {
+                if (task->running()) {
+                    idle = std::min(idle, task->idle_cycles());
+                }
+            }
+            idle = std::min(idle, _max_cycles - 1);
+            if (idle > 0) {
+                skip(idle);
+            }
+        }
+
+        execute();
+        return idle + 1;
+    }
+
+    bool Runner::run_for(Clock::duration _duration)
+    {
+        auto cycles = static_cast<std::uint64_t>(std::max<Clock::rep>(_duration / m_period, 0));
+        while (cycles > 0) {
+            auto advanced = step(cycles);
+            if (advanced == 0) {
+                break;
+            }
+            cycles -= advanced;
+        }
+        return running();
+    }
+
+    bool Runner::run_until_done(Clock::duration _limit)
+    {
+        return !run_for(_limit);
+    }
+
+}  // namespace Simulation
+
+}  // namespace TaskManager
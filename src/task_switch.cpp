@@ -0,0 +1,233 @@
+#include "task_switch.hpp"
+#include "task_analysis.hpp"
+#include "task_fleet.hpp"
+#include "task_replay.hpp"
+
+#include <algorithm>
+
+namespace TaskManager
+{
+
+namespace Expr
+{
+
+    std::size_t Switch::DispatchTable::find(key_type _key) const noexcept
+    {
+        if (!dense.empty()) {
+            // 符号なしで比べれば、min_keyより小さいキーも範囲外として弾ける
+            auto offset = static_cast<std::uint64_t>(_key) - static_cast<std::uint64_t>(min_key);
+            if (offset < dense.size() && dense[offset] != npos) {
+                return dense[offset];
+            }
+            return default_index;
+        }
+
+        auto found = sparse.find(_key);
+        return found != sparse.end() ? found->second : default_index;
+    }
+
+
+    Switch::Switch(std::function<key_type()>&& _key, std::vector<CaseBlock>&& _case_list)
+        : m_key{std::move(_key)},
+          m_prototype_list{},
+          m_table{nullptr},
+          m_body_list(_case_list.size())
+    {
+        auto table = std::make_shared<DispatchTable>();
+        std::vector<std::pair<key_type, std::size_t>> key_list;
+
+        m_prototype_list.reserve(_case_list.size());
+        for (auto& case_block : _case_list) {
+            auto index = m_prototype_list.size();
+            m_prototype_list.push_back(std::make_shared<const TaskSet>(std::move(case_block.body)));
+
+            if (case_block.key) {
+                key_list.emplace_back(case_block.key.value(), index);
+            } else if (table->default_index == DispatchTable::npos) {
+                table->default_index = index;
+            }
+        }
+
+        if (!key_list.empty()) {
+            auto minmax = std::minmax_element(key_list.begin(), key_list.end());
+            auto range = static_cast<std::uint64_t>(minmax.second->first) - static_cast<std::uint64_t>(minmax.first->first);
+
+            // 表の大きさがcase数の数倍に収まるなら配列で引く
+            if (range < 4 * key_list.size() + 16) {
+                table->min_key = minmax.first->first;
+                table->dense.assign(static_cast<std::size_t>(range) + 1, DispatchTable::npos);
+                for (auto& key_index : key_list) {
+                    auto& slot = table->dense[static_cast<std::uint64_t>(key_index.first) - static_cast<std::uint64_t>(table->min_key)];
+                    if (slot == DispatchTable::npos) {  // 先に登録したcaseを優先
+                        slot = key_index.second;
+                    }
+                }
+            } else {
+                table->sparse.reserve(key_list.size());
+                for (auto& key_index : key_list) {
+                    table->sparse.emplace(key_index.first, key_index.second);
+                }
+            }
+        }
+
+        m_table = std::move(table);
+    }
+
+    Switch::Switch(const Switch& _other)
+        : AbstTask{_other},
+          m_key{_other.m_key},
+          m_prototype_list{_other.m_prototype_list},
+          m_table{_other.m_table},
+          m_body_list(_other.m_body_list.size())
+    {
+    }
+    Switch& Switch::operator=(const Switch& _other) &
+    {
+        AbstTask::operator=(_other);
+        m_key = _other.m_key;
+        m_prototype_list = _other.m_prototype_list;
+        m_table = _other.m_table;
+        m_body_list.assign(_other.m_body_list.size(), nullptr);
+        m_selected_task = nullptr;
+        return *this;
+    }
+    Switch::Switch(Switch&& _other) noexcept
+        : AbstTask{std::move(_other)},
+          m_key{std::move(_other.m_key)},
+          m_prototype_list{std::move(_other.m_prototype_list)},
+          m_table{std::move(_other.m_table)},
+          m_body_list{std::move(_other.m_body_list)}
+    {
+        _other.m_key = nullptr;
+    }
+    Switch& Switch::operator=(Switch&& _other) & noexcept
+    {
+        AbstTask::operator=(std::move(_other));
+        m_key = std::move(_other.m_key);
+        _other.m_key = nullptr;
+        m_prototype_list = std::move(_other.m_prototype_list);
+        m_table = std::move(_other.m_table);
+        m_body_list = std::move(_other.m_body_list);
+        m_selected_task = nullptr;
+        return *this;
+    }
+
+    void Switch::init()
+    {
+        m_selected_task = nullptr;
+
+        if (!m_key || !m_table) {
+            return;
+        }
+
+        auto index = m_table->find(Replay::key(m_key));
+        if (index == DispatchTable::npos) {
+            return;
+        }
+
+        // 初めて分岐したcaseなら、雛形からコピーして作る
+        auto& body = m_body_list.at(index);
+        if (!body) {
+            body = std::make_shared<TaskSet>(*m_prototype_list.at(index));
+        }
+        m_selected_task = body;
+    }
+
+    NextTask Switch::eval()
+    {
+        if (m_selected_task) {
+            return evaluate(*m_selected_task);
+        }
+
+        return true;
+    }
+
+    void Switch::interrupt()
+    {
+        if (m_selected_task) {
+            force_quit(*m_selected_task);
+        }
+        quit();
+    }
+
+    void Switch::for_each_child(const std::function<void(AbstTask&)>& _func)
+    {
+        for (std::size_t i = 0; i < m_body_list.size(); ++i) {
+            // 雛形は書き換えない約束なので、constを外して渡す
+            _func(m_body_list[i] ? *m_body_list[i] : const_cast<TaskSet&>(*m_prototype_list[i]));
+        }
+    }
+    std::uint64_t Switch::waiting_cycles()
+    {
+        return m_selected_task ? waiting_cycles_of(*m_selected_task) : 0;
+    }
+    void Switch::skip_waiting(std::uint64_t _cycles)
+    {
+        if (m_selected_task) {
+            skip_waiting_of(*m_selected_task, _cycles);
+        }
+    }
+    std::uint32_t Switch::compile(Fleet::Builder& _builder)
+    {
+        auto index = _builder.open(Fleet::Op::Switch, true);
+
+        Fleet::Program::SwitchTable table;
+        if (m_key && m_table) {
+            table.key = m_key;
+            for (std::size_t i = 0; i < m_table->dense.size(); ++i) {
+                if (m_table->dense[i] != DispatchTable::npos) {
+                    table.cases.emplace_back(m_table->min_key + static_cast<key_type>(i), static_cast<std::uint32_t>(m_table->dense[i]));
+                }
+            }
+            for (auto& entry : m_table->sparse) {
+                table.cases.emplace_back(entry.first, static_cast<std::uint32_t>(entry.second));
+            }
+            if (m_table->default_index != DispatchTable::npos) {
+                table.default_case = static_cast<std::uint32_t>(m_table->default_index);
+            }
+        }
+        _builder.node(index).function = _builder.switch_table(std::move(table));
+
+        std::vector<std::uint32_t> children;
+        for (auto& prototype : m_prototype_list) {
+            // 雛形は書き換えない約束なので、constを外して渡す
+            children.push_back(_builder.add(const_cast<TaskSet&>(*prototype)));
+        }
+        _builder.set_children(index, children);
+        return index;
+    }
+    void Switch::prepare()
+    {
+        for (std::size_t i = 0; i < m_body_list.size(); ++i) {
+            if (!m_body_list[i]) {
+                m_body_list[i] = std::make_shared<TaskSet>(*m_prototype_list[i]);
+            }
+        }
+    }
+    Analysis::WorstCase Switch::analyze(const Analysis::CostModel& _model)
+    {
+        Analysis::WorstCase result;
+        result.add_node(_model);
+        result.add_condition(_model);
+
+        Analysis::WorstCase worst;  // 該当するcaseが無ければ何もしない
+        std::size_t index = 0;
+        for_each_child([&](AbstTask& _body) {
+            Analysis::WorstCase branch;
+            branch.path.push_back("Switch: case " + std::to_string(index++));
+            branch += _body.worst_case(_model);
+            worst = Analysis::WorstCase::larger(std::move(worst), std::move(branch));
+        });
+        result += worst;
+        return result;
+    }
+
+
+    SwitchCondition::SwitchCondition(std::function<Switch::key_type()>&& _key) noexcept
+        : m_key{std::move(_key)}
+    {
+    }
+
+}  // namespace Expr
+
+}  // namespace TaskManager
@@ -1,4 +1,7 @@
 #include "task_while.hpp"
+#include "task_analysis.hpp"
+#include "task_fleet.hpp"
+#include "task_replay.hpp"
 
 namespace TaskManager
 {
@@ -6,6 +9,39 @@ namespace TaskManager
 namespace Expr
 {
 
+    void IterationPolicy::set_count(std::size_t _count) noexcept
+    {
+        m_max_count = _count == 0 ? 1 : _count;
+    }
+    void IterationPolicy::set_budget(clock::duration _budget) noexcept
+    {
+        m_budget = _budget;
+    }
+
+    bool IterationPolicy::allows(std::size_t _count, clock::time_point _begin) const noexcept
+    {
+        if (!m_max_count && !m_budget) {  // 指定なしなら1周
+            return _count < 1;
+        }
+
+        if (m_max_count && _count >= m_max_count.value()) {
+            return false;
+        }
+        if (m_budget && clock::now() - _begin >= m_budget.value()) {
+            return false;
+        }
+        return true;
+    }
+
+    std::optional<std::size_t> IterationPolicy::max_iterations() const noexcept
+    {
+        if (!m_max_count && !m_budget) {
+            return 1;
+        }
+        return m_max_count;
+    }
+
+
     While::While(const std::function<bool()>& _func, const TaskSet& _task)
         : m_condition{_func},
           m_taskset{_task},
@@ -35,6 +71,7 @@ namespace Expr
         : AbstTask{_other},
           m_condition{_other.m_condition},
           m_taskset{_other.m_taskset},
+          m_policy{_other.m_policy},
           m_should_eval{false}
     {
     }
@@ -43,6 +80,7 @@ namespace Expr
         AbstTask::operator=(_other);
         m_condition = _other.m_condition;
         m_taskset = _other.m_taskset;
+        m_policy = _other.m_policy;
         m_should_eval = false;
         return *this;
     }
@@ -50,6 +88,7 @@ namespace Expr
         : AbstTask{std::move(_other)},
           m_condition{std::move(_other.m_condition)},
           m_taskset{std::move(_other.m_taskset)},
+          m_policy{_other.m_policy},
           m_should_eval{false}
     {
         _other.m_condition = nullptr;
@@ -60,6 +99,7 @@ namespace Expr
         m_condition = std::move(_other.m_condition);
         _other.m_condition = nullptr;
         m_taskset = std::move(_other.m_taskset);
+        m_policy = _other.m_policy;
         m_should_eval = false;
         return *this;
     }
@@ -67,7 +107,7 @@ namespace Expr
     void While::init()
     {
         // 実行するべきか
-        m_should_eval = m_condition && m_condition();
+        m_should_eval = m_condition && Replay::condition(m_condition);
         // なお、条件式が生きていれば一度は実行されることが保証される
     }
 
@@ -86,7 +126,34 @@ namespace Expr
         */
 
         // 上と同値
-        return !m_should_eval || (evaluate(m_taskset) && !m_condition());
+        //     ただし、周回数の属性が有れば1サイクルの中で何周もする
+        return !m_should_eval || iterate();
+    }
+
+    bool While::iterate()
+    {
+        auto begin = m_policy.timed() ? IterationPolicy::clock::now() : IterationPolicy::clock::time_point{};
+
+        for (std::size_t count{1};; ++count) {
+            if (!evaluate(m_taskset)) {  // タスクが未完了
+                return false;
+            }
+            if (!(m_condition && Replay::condition(m_condition))) {  // ループ終了
+                return true;
+            }
+            if (!Replay::condition([&] { return m_policy.allows(count, begin); })) {  // 残りは次のサイクルで
+                return false;
+            }
+        }
+    }
+
+    IterationAttribute<While> While::operator->() const&
+    {
+        return IterationAttribute<While>{*this};
+    }
+    IterationAttribute<While> While::operator->() && noexcept(std::is_nothrow_move_constructible<TaskSet>::value)
+    {
+        return IterationAttribute<While>{std::move(*this)};
     }
 
     void While::interrupt()
@@ -95,6 +162,58 @@ namespace Expr
         quit();
     }
 
+    void While::for_each_child(const std::function<void(AbstTask&)>& _func)
+    {
+        _func(m_taskset);
+    }
+    std::uint64_t While::waiting_cycles()
+    {
+        return m_should_eval ? waiting_cycles_of(m_taskset) : 0;
+    }
+    void While::skip_waiting(std::uint64_t _cycles)
+    {
+        skip_waiting_of(m_taskset, _cycles);
+    }
+    std::uint32_t While::compile(Fleet::Builder& _builder)
+    {
+        return compile_loop(_builder, true);
+    }
+    std::uint32_t While::compile_loop(Fleet::Builder& _builder, bool _checks_first)
+    {
+        auto index = _builder.open(_checks_first ? Fleet::Op::While : Fleet::Op::DoWhile, true);
+        if (m_condition) {
+            _builder.node(index).function = _builder.function(m_condition);
+        }
+        _builder.node(index).policy = m_policy;
+        _builder.set_children(index, {_builder.add(m_taskset)});
+        return index;
+    }
+    Analysis::WorstCase While::analyze(const Analysis::CostModel& _model)
+    {
+        return analyze_loop(_model, true);
+    }
+    Analysis::WorstCase While::analyze_loop(const Analysis::CostModel& _model, bool _checks_first)
+    {
+        Analysis::WorstCase result;
+        result.add_node(_model);
+        if (_checks_first) {
+            result.add_condition(_model);
+        }
+
+        auto iterations = m_policy.max_iterations();
+        if (!iterations) {  // 回数は時間次第なので、1周分だけ数えて上界が無いことを示す
+            result.bounded = false;
+            result.path.push_back(Analysis::type_name(*this) + ": unbounded (time budget only)");
+        } else if (iterations.value() > 1) {
+            result.path.push_back(Analysis::type_name(*this) + ": " + std::to_string(iterations.value()) + " iterations");
+        }
+
+        auto lap = m_taskset.worst_case(_model);
+        lap.add_condition(_model);
+        result += lap.repeated(iterations.value_or(1));
+        return result;
+    }
+
 
     WhileCondition::WhileCondition(const std::function<bool()>& _func) noexcept
         : m_condition{_func}
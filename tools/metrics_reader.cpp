@@ -0,0 +1,133 @@
+/*!
+ * @file    metrics_reader.cpp
+ * @brief   共有メモリ上の統計(Metrics::Segment)を別プロセスから読んで表示する
+ * @detail  metrics_reader <name> [--prometheus] [--watch <ms>]
+ *          --prometheusでPrometheusのテキスト形式、--watchで指定した間隔で表示し続ける。
+ *          制御プロセスには一切触れず、共有メモリを読むだけ。
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include "task_metrics.hpp"
+
+namespace
+{
+using TaskManager::Metrics::RootMetrics;
+
+std::uint64_t get(const std::atomic<std::uint64_t>& _value) { return _value.load(std::memory_order_relaxed); }
+std::uint32_t get(const std::atomic<std::uint32_t>& _value) { return _value.load(std::memory_order_relaxed); }
+
+void print_text(const TaskManager::Metrics::Segment& _segment)
+{
+    for (std::size_t i = 0; i < _segment.size(); ++i) {
+        auto& root = _segment.root(i);
+        std::printf("[%s]\n", root.name);
+        std::printf("  cycles        : %llu\n", static_cast<unsigned long long>(get(root.cycles)));
+        std::printf("  evaluations   : %llu\n", static_cast<unsigned long long>(get(root.evaluations)));
+        std::printf("  overruns      : %llu (budget %llu ns)\n", static_cast<unsigned long long>(get(root.overruns)), static_cast<unsigned long long>(root.budget_ns));
+        std::printf("  latency [ns]  : last %llu, max %llu\n", static_cast<unsigned long long>(get(root.last_latency_ns)), static_cast<unsigned long long>(get(root.max_latency_ns)));
+        std::printf("  active        : node %u, depth %u, for %llu cycles\n", get(root.active_leaf), get(root.active_depth), static_cast<unsigned long long>(get(root.active_cycles)));
+
+        std::printf("  jumps         :");
+        for (std::size_t p = 0; p < RootMetrics::jump_priorities; ++p) {
+            std::printf(" %llu", static_cast<unsigned long long>(get(root.jump_fires[p])));
+        }
+        std::printf("\n  histogram     :");
+        for (std::size_t b = 0; b < RootMetrics::histogram_buckets; ++b) {
+            if (auto count = get(root.latency_histogram[b])) {
+                if (b + 1 < RootMetrics::histogram_buckets) {
+                    std::printf(" <%lluns:%llu", 2ull << b, static_cast<unsigned long long>(count));
+                } else {
+                    std::printf(" >=%lluns:%llu", 1ull << b, static_cast<unsigned long long>(count));
+                }
+            }
+        }
+        std::printf("\n");
+    }
+}
+
+// Prometheusのテキスト形式では、同じ名前の値を# HELP・# TYPEの後にまとめて並べる
+void family(const char* _name, const char* _type, const char* _help)
+{
+    std::printf("# HELP %s %s\n# TYPE %s %s\n", _name, _help, _name, _type);
+}
+
+void print_prometheus(const TaskManager::Metrics::Segment& _segment)
+{
+    auto each = [&_segment](const char* _name, const char* _type, const char* _help, auto&& _value) {
+        family(_name, _type, _help);
+        for (std::size_t i = 0; i < _segment.size(); ++i) {
+            auto& root = _segment.root(i);
+            std::printf("%s{root=\"%s\"} %llu\n", _name, root.name, static_cast<unsigned long long>(_value(root)));
+        }
+    };
+    each("task_cycles_total", "counter", "Number of resume() calls.", [](const RootMetrics& _root) { return get(_root.cycles); });
+    each("task_evaluations_total", "counter", "Number of node evaluations.", [](const RootMetrics& _root) { return get(_root.evaluations); });
+    each("task_overruns_total", "counter", "Number of resume() calls over budget.", [](const RootMetrics& _root) { return get(_root.overruns); });
+    each("task_latency_max_ns", "gauge", "Longest resume() in nanoseconds.", [](const RootMetrics& _root) { return get(_root.max_latency_ns); });
+    each("task_active_node", "gauge", "Node id of the active leaf.", [](const RootMetrics& _root) { return std::uint64_t{get(_root.active_leaf)}; });
+    each("task_active_cycles", "gauge", "Cycles the active leaf has been running.", [](const RootMetrics& _root) { return get(_root.active_cycles); });
+
+    family("task_jumps_total", "counter", "Number of jumps taken, by priority.");
+    for (std::size_t i = 0; i < _segment.size(); ++i) {
+        auto& root = _segment.root(i);
+        for (std::size_t p = 0; p < RootMetrics::jump_priorities; ++p) {
+            std::printf("task_jumps_total{root=\"%s\",priority=\"%zu\"} %llu\n", root.name, p, static_cast<unsigned long long>(get(root.jump_fires[p])));
+        }
+    }
+
+    // i番目の区間は[2^i, 2^(i+1))nsなので、上端を含むleは2^(i+1)-1。最後の区間は上限が無いので+Infにだけ入る
+    family("task_latency_ns", "histogram", "Duration of resume() in nanoseconds.");
+    for (std::size_t i = 0; i < _segment.size(); ++i) {
+        auto& root = _segment.root(i);
+        std::uint64_t cumulative = 0;
+        for (std::size_t b = 0; b + 1 < RootMetrics::histogram_buckets; ++b) {
+            cumulative += get(root.latency_histogram[b]);
+            std::printf("task_latency_ns_bucket{root=\"%s\",le=\"%llu\"} %llu\n", root.name, (2ull << b) - 1, static_cast<unsigned long long>(cumulative));
+        }
+        cumulative += get(root.latency_histogram[RootMetrics::histogram_buckets - 1]);
+        std::printf("task_latency_ns_bucket{root=\"%s\",le=\"+Inf\"} %llu\n", root.name, static_cast<unsigned long long>(cumulative));
+        std::printf("task_latency_ns_sum{root=\"%s\"} %llu\n", root.name, static_cast<unsigned long long>(get(root.latency_sum_ns)));
+        std::printf("task_latency_ns_count{root=\"%s\"} %llu\n", root.name, static_cast<unsigned long long>(cumulative));
+    }
+}
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <name> [--prometheus] [--watch <ms>]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    auto prometheus = false;
+    long watch_ms = 0;
+    for (int i = 2; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--prometheus") == 0) {
+            prometheus = true;
+        } else if (std::strcmp(argv[i], "--watch") == 0 && i + 1 < argc) {
+            watch_ms = std::strtol(argv[++i], nullptr, 10);
+        }
+    }
+
+    try {
+        auto segment = TaskManager::Metrics::Segment::open(argv[1]);
+        do {
+            prometheus ? print_prometheus(segment) : print_text(segment);
+            std::fflush(stdout);
+            if (watch_ms > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds{watch_ms});
+            }
+        } while (watch_ms > 0);
+    } catch (const std::system_error& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}